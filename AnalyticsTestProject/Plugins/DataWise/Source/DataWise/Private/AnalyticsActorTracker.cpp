@@ -0,0 +1,266 @@
+#include "AnalyticsActorTracker.h"
+#include "DataWise.h"
+#include "AnalyticsSession.h"
+#include "AnalyticsPacket.h"
+#include "AnalyticsSettings.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+// Samples between two checks of the frame budget
+#define budget_check_interval 16
+
+// One tracker per world, kept alive until the world is cleaned up. Game thread only.
+static TMap<TWeakObjectPtr<UWorld>, UAnalyticsActorTracker*> world_trackers;
+
+UAnalyticsActorTracker* UAnalyticsActorTracker::GetActorTracker(UObject* WorldContextObject)
+{
+	UWorld* context_world = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+	if (context_world == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Actor tracking needs a world"));
+		return nullptr;
+	}
+
+	UAnalyticsActorTracker** existing = world_trackers.Find(context_world);
+	if (existing != nullptr) return *existing;
+
+	static bool cleanup_bound = false;
+	if (!cleanup_bound)
+	{
+		FWorldDelegates::OnWorldCleanup.AddStatic(&UAnalyticsActorTracker::OnWorldCleanup);
+		cleanup_bound = true;
+	}
+
+	// The tracker only holds a weak reference to its world, so it does not keep the world from being collected
+	UAnalyticsActorTracker* tracker = NewObject<UAnalyticsActorTracker>(GetTransientPackage());
+	tracker->AddToRoot();
+	tracker->world = context_world;
+
+	const UAnalyticsSettings* settings = UAnalyticsSettings::Get();
+	tracker->interval = FMath::Max(settings->ActorTrackingInterval, 0.01f);
+	tracker->budget = FMath::Max(settings->ActorTrackingBudget, 0.01f) / 1000.0;
+	tracker->precision = FMath::Max(settings->ActorTrackingPrecision, 0.01f);
+
+	world_trackers.Add(context_world, tracker);
+	return tracker;
+}
+
+void UAnalyticsActorTracker::OnWorldCleanup(UWorld* cleaned_world, bool session_ended, bool cleanup_resources)
+{
+	UAnalyticsActorTracker* tracker = nullptr;
+	if (!world_trackers.RemoveAndCopyValue(cleaned_world, tracker)) return;
+
+	tracker->world.Reset();
+	tracker->actors.Empty();
+	tracker->ids.Empty();
+	tracker->track_view.Empty();
+	tracker->locations.Empty();
+	tracker->views.Empty();
+	tracker->introduced.Empty();
+	tracker->RemoveFromRoot();
+}
+
+void UAnalyticsActorTracker::TrackActor(AActor* Actor, bool bTrackView)
+{
+	if (Actor == nullptr) return;
+
+	int32 index = actors.Find(Actor);
+	if (index != INDEX_NONE)
+	{
+		track_view[index] = bTrackView;
+		return;
+	}
+
+	// New actors are added at the end, so a pass in progress samples them before it reports
+	actors.Add(Actor);
+	ids.Add(next_id++);
+	track_view.Add(bTrackView);
+	locations.Add(FVector::ZeroVector);
+	views.Add(FRotator::ZeroRotator);
+}
+
+void UAnalyticsActorTracker::UntrackActor(AActor* Actor)
+{
+	// Removed by the next pass, which is the only place the arrays shrink
+	int32 index = actors.Find(Actor);
+	if (index != INDEX_NONE) actors[index].Reset();
+}
+
+void UAnalyticsActorTracker::Remove(int32 index)
+{
+	actors.RemoveAtSwap(index, 1, false);
+	ids.RemoveAtSwap(index, 1, false);
+	track_view.RemoveAtSwap(index, 1, false);
+	locations.RemoveAtSwap(index, 1, false);
+	views.RemoveAtSwap(index, 1, false);
+}
+
+void UAnalyticsActorTracker::Tick(float delta_time)
+{
+	double now = FPlatformTime::Seconds();
+
+	if (cursor == INDEX_NONE)
+	{
+		if (now - pass_time < interval) return;
+
+		pass_time = now;
+		cursor = 0;
+	}
+
+	double deadline = now + budget;
+	int32 sampled = 0;
+
+	while (cursor < actors.Num())
+	{
+		// The last actor is swapped into the cursor, it has not been sampled in this pass yet
+		if (!actors[cursor].IsValid())
+		{
+			Remove(cursor);
+			continue;
+		}
+
+		Sample(cursor);
+		cursor++;
+
+		sampled++;
+		if (sampled % budget_check_interval == 0 && FPlatformTime::Seconds() > deadline) return;
+	}
+
+	Report();
+	cursor = INDEX_NONE;
+}
+
+void UAnalyticsActorTracker::Sample(int32 index)
+{
+	AActor* actor = actors[index].Get();
+	locations[index] = actor->GetActorLocation();
+
+	if (track_view[index])
+	{
+		// Pawns look along the rotation of their controller
+		FVector eyes;
+		actor->GetActorEyesViewPoint(eyes, views[index]);
+	}
+}
+
+void UAnalyticsActorTracker::Report()
+{
+	UWorld* tracked_world = world.Get();
+	if (tracked_world == nullptr) return;
+
+	TArray<UAnalyticsSession*> sessions;
+	for (UAnalyticsSession* session : UAnalyticsSession::GetActiveSessions())
+	{
+		if (session->GetTypedOuter<UWorld>() == tracked_world) sessions.Add(session);
+	}
+
+	for (auto it = introduced.CreateIterator(); it; ++it)
+	{
+		if (!it.Key().IsValid()) it.RemoveCurrent();
+	}
+
+	if (sessions.Num() == 0) return;
+
+	FAnalyticsActorBatch batch;
+	batch.Precision = precision;
+	batch.Actors.Reserve(actors.Num());
+	batch.Locations.Reserve(actors.Num() * 3);
+
+	int32 highest_id = 0;
+	for (int32 index = 0; index < actors.Num(); index++)
+	{
+		// Untracked during this pass
+		if (!actors[index].IsValid()) continue;
+
+		batch.Actors.Add(ids[index]);
+		batch.Locations.Add(FMath::RoundToInt(locations[index].X / precision));
+		batch.Locations.Add(FMath::RoundToInt(locations[index].Y / precision));
+		batch.Locations.Add(FMath::RoundToInt(locations[index].Z / precision));
+		highest_id = FMath::Max(highest_id, ids[index]);
+
+		if (track_view[index])
+		{
+			batch.ViewActors.Add(ids[index]);
+			batch.Views.Add(FMath::RoundToInt(FRotator::NormalizeAxis(views[index].Yaw) * 10.0f));
+			batch.Views.Add(FMath::RoundToInt(FRotator::NormalizeAxis(views[index].Pitch) * 10.0f));
+		}
+	}
+
+	if (batch.Actors.Num() == 0) return;
+
+	for (UAnalyticsSession* session : sessions)
+	{
+		// Actors are introduced once per session, the first time they appear in one of its batches
+		int32& session_introduced = introduced.FindOrAdd(session);
+		if (session_introduced < highest_id)
+		{
+			for (int32 index = 0; index < actors.Num(); index++)
+			{
+				AActor* actor = actors[index].Get();
+				if (actor == nullptr || ids[index] <= session_introduced) continue;
+
+				FAnalyticsTrackedActor info;
+				info.Id = ids[index];
+				info.Name = actor->GetName();
+				info.ClassName = actor->GetClass()->GetName();
+				session->Report(info);
+			}
+
+			session_introduced = highest_id;
+		}
+
+		session->Report(batch);
+	}
+}
+
+bool UAnalyticsActorTracker::IsTickable() const
+{
+	return world.IsValid() && !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UAnalyticsActorTracker::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAnalyticsActorTracker, STATGROUP_Tickables);
+}
+
+bool UAnalyticsActorTracker::GetBatchLocations(UAnalyticsPacket* Packet, TArray<int32>& Actors, TArray<FVector>& Locations)
+{
+	UAnalyticsStructPacket* struct_packet = Cast<UAnalyticsStructPacket>(Packet);
+	const FAnalyticsActorBatch* batch = struct_packet != nullptr ? struct_packet->Get<FAnalyticsActorBatch>() : nullptr;
+	if (batch == nullptr) return false;
+
+	int32 count = FMath::Min(batch->Actors.Num(), batch->Locations.Num() / 3);
+	Actors = batch->Actors;
+	Actors.SetNum(count);
+	Locations.SetNum(count);
+
+	for (int32 index = 0; index < count; index++)
+	{
+		const int32* location = &batch->Locations[index * 3];
+		Locations[index] = FVector(location[0], location[1], location[2]) * batch->Precision;
+	}
+
+	return true;
+}
+
+bool UAnalyticsActorTracker::GetBatchViews(UAnalyticsPacket* Packet, TArray<int32>& Actors, TArray<FVector>& Directions)
+{
+	UAnalyticsStructPacket* struct_packet = Cast<UAnalyticsStructPacket>(Packet);
+	const FAnalyticsActorBatch* batch = struct_packet != nullptr ? struct_packet->Get<FAnalyticsActorBatch>() : nullptr;
+	if (batch == nullptr) return false;
+
+	int32 count = FMath::Min(batch->ViewActors.Num(), batch->Views.Num() / 2);
+	Actors = batch->ViewActors;
+	Actors.SetNum(count);
+	Directions.SetNum(count);
+
+	for (int32 index = 0; index < count; index++)
+	{
+		float yaw = batch->Views[index * 2] / 10.0f;
+		float pitch = batch->Views[index * 2 + 1] / 10.0f;
+		Directions[index] = FRotator(pitch, yaw, 0.0f).Vector();
+	}
+
+	return true;
+}
@@ -0,0 +1,323 @@
+#include "AnalyticsAggregators.h"
+#include "DataWise.h"
+#include "AnalyticsSession.h"
+#include "AnalyticsPacket.h"
+#include "Misc/ScopeLock.h"
+
+#define histogram_linear 0
+#define histogram_logarithmic 1
+
+void UAnalyticsAggregator::Initialize(UAnalyticsSession* session_, const FString& name_, float interval_)
+{
+	session = session_;
+	name = name_;
+	interval = FMath::Max(interval_, 0.1f);
+	interval_start = FPlatformTime::Seconds();
+}
+
+void UAnalyticsAggregator::Emit(double now, bool force)
+{
+	UAnalyticsSession* target = session.Get();
+	if (target == nullptr) return;
+
+	FScopeLock lock(&mutex);
+	if (!force && now - interval_start < interval) return;
+
+	float covered = (float)(now - interval_start);
+	interval_start = now;
+
+	Report(target, covered);
+}
+
+
+
+void UAnalyticsCounter::Add(int32 Amount)
+{
+	FScopeLock lock(&mutex);
+	count += Amount;
+}
+
+bool UAnalyticsCounter::Report(UAnalyticsSession* target, float covered)
+{
+	// An interval without a summary counted nothing
+	if (count == 0) return false;
+
+	FAnalyticsCounterSummary summary;
+	summary.Name = name;
+	summary.Interval = covered;
+	summary.Count = count;
+	target->Report(summary);
+
+	count = 0;
+	return true;
+}
+
+
+
+void UAnalyticsGauge::Set(float Value)
+{
+	FScopeLock lock(&mutex);
+
+	min = samples == 0 ? Value : FMath::Min(min, Value);
+	max = samples == 0 ? Value : FMath::Max(max, Value);
+	sum += Value;
+	last = Value;
+	samples++;
+}
+
+bool UAnalyticsGauge::Report(UAnalyticsSession* target, float covered)
+{
+	if (samples == 0) return false;
+
+	FAnalyticsGaugeSummary summary;
+	summary.Name = name;
+	summary.Interval = covered;
+	summary.Samples = samples;
+	summary.Min = min;
+	summary.Max = max;
+	summary.Mean = (float)(sum / samples);
+	summary.Last = last;
+	target->Report(summary);
+
+	samples = 0;
+	sum = 0.0;
+	return true;
+}
+
+
+
+void UAnalyticsHistogram::SetLinear(float range_min_, float range_max_, int32 bucket_count)
+{
+	FScopeLock lock(&mutex);
+
+	layout = histogram_linear;
+	range_min = range_min_;
+	range_max = FMath::Max(range_max_, range_min_ + KINDA_SMALL_NUMBER);
+	buckets.Init(0, FMath::Max(bucket_count, 1));
+}
+
+void UAnalyticsHistogram::SetLogarithmic(float resolution, int32 bits_)
+{
+	FScopeLock lock(&mutex);
+
+	layout = histogram_logarithmic;
+	range_min = FMath::Max(resolution, KINDA_SMALL_NUMBER);
+	bits = FMath::Clamp(bits_, 1, 10);
+	buckets.Reset();
+}
+
+int32 UAnalyticsHistogram::GetBucket(float value) const
+{
+	if (layout == histogram_linear)
+	{
+		int32 bucket = FMath::FloorToInt((value - range_min) / (range_max - range_min) * buckets.Num());
+		return FMath::Clamp(bucket, 0, buckets.Num() - 1);
+	}
+
+	// Values below zero count towards the first bucket
+	double steps = FMath::Clamp((double)value / range_min, 0.0, (double)MAX_uint32);
+	uint32 step = (uint32)steps;
+
+	int32 exact_buckets = 1 << bits;
+	if (step < (uint32)exact_buckets) return step;
+
+	int32 half = exact_buckets / 2;
+	int32 shift = FMath::FloorLog2(step) - (bits - 1);
+	return shift * half + (int32)(step >> shift);
+}
+
+void UAnalyticsHistogram::GetBucketRange(const FAnalyticsHistogramSummary& summary, int32 bucket, float& lower, float& upper)
+{
+	if (summary.Layout == histogram_linear)
+	{
+		float bucket_size = summary.Buckets.Num() > 0 ? (summary.RangeMax - summary.RangeMin) / summary.Buckets.Num() : 0.0f;
+		lower = summary.RangeMin + bucket * bucket_size;
+		upper = lower + bucket_size;
+		return;
+	}
+
+	int32 summary_bits = FMath::Clamp((int32)summary.RangeMax, 1, 10);
+	int32 exact_buckets = 1 << summary_bits;
+	if (bucket < exact_buckets)
+	{
+		lower = bucket * summary.RangeMin;
+		upper = (bucket + 1) * summary.RangeMin;
+		return;
+	}
+
+	int32 half = exact_buckets / 2;
+	int32 shift = bucket / half - 1;
+	uint64 mantissa = bucket % half + half;
+	lower = (float)((mantissa << shift) * (double)summary.RangeMin);
+	upper = (float)(((mantissa + 1) << shift) * (double)summary.RangeMin);
+}
+
+void UAnalyticsHistogram::Add(float Value)
+{
+	FScopeLock lock(&mutex);
+
+	if (layout == histogram_linear && buckets.Num() == 0) buckets.Init(0, 1);
+
+	int32 bucket = GetBucket(Value);
+	if (bucket >= buckets.Num()) buckets.SetNumZeroed(bucket + 1);
+	buckets[bucket]++;
+
+	min = samples == 0 ? Value : FMath::Min(min, Value);
+	max = samples == 0 ? Value : FMath::Max(max, Value);
+	sum += Value;
+	samples++;
+}
+
+bool UAnalyticsHistogram::Report(UAnalyticsSession* target, float covered)
+{
+	if (samples == 0) return false;
+
+	FAnalyticsHistogramSummary summary;
+	summary.Name = name;
+	summary.Interval = covered;
+	summary.Layout = layout;
+	summary.RangeMin = range_min;
+	summary.RangeMax = layout == histogram_linear ? range_max : (float)bits;
+	summary.Samples = samples;
+	summary.Sum = (float)sum;
+	summary.Min = min;
+	summary.Max = max;
+
+	// Linear summaries keep every bucket, so the size of a bucket follows from the range
+	int32 used = buckets.Num();
+	if (layout == histogram_logarithmic)
+	{
+		while (used > 0 && buckets[used - 1] == 0) used--;
+	}
+	summary.Buckets.Append(buckets.GetData(), used);
+
+	target->Report(summary);
+
+	FMemory::Memzero(buckets.GetData(), buckets.Num() * sizeof(int32));
+	samples = 0;
+	sum = 0.0;
+	return true;
+}
+
+
+
+void UAnalyticsGrid::Add(FVector Location, float Value)
+{
+	FIntPoint cell(FMath::FloorToInt(Location.X / cell_size), FMath::FloorToInt(Location.Y / cell_size));
+
+	FScopeLock lock(&mutex);
+	FCell& data = cells.FindOrAdd(cell);
+	data.Count++;
+	data.Value += Value;
+}
+
+bool UAnalyticsGrid::Report(UAnalyticsSession* target, float covered)
+{
+	if (cells.Num() == 0) return false;
+
+	FAnalyticsGridSummary summary;
+	summary.Name = name;
+	summary.Interval = covered;
+	summary.CellSize = cell_size;
+	summary.CellX.Reserve(cells.Num());
+	summary.CellY.Reserve(cells.Num());
+	summary.Counts.Reserve(cells.Num());
+	summary.Values.Reserve(cells.Num());
+
+	for (const TPair<FIntPoint, FCell>& cell : cells)
+	{
+		summary.CellX.Add(cell.Key.X);
+		summary.CellY.Add(cell.Key.Y);
+		summary.Counts.Add(cell.Value.Count);
+		summary.Values.Add(cell.Value.Value);
+	}
+
+	target->Report(summary);
+
+	cells.Reset();
+	return true;
+}
+
+
+
+template<typename T>
+static T* CreateAggregator(UAnalyticsSession* session, const FString& name, float interval)
+{
+	if (session == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Aggregator %s needs a session to report to"), *name);
+		return nullptr;
+	}
+
+	T* aggregator = NewObject<T>(session);
+	aggregator->Initialize(session, name, interval);
+	session->AddAggregator(aggregator);
+	return aggregator;
+}
+
+UAnalyticsCounter* UAnalyticsAggregatorTools::CreateCounter(UAnalyticsSession* Session, FString Name, float Interval)
+{
+	return CreateAggregator<UAnalyticsCounter>(Session, Name, Interval);
+}
+
+UAnalyticsGauge* UAnalyticsAggregatorTools::CreateGauge(UAnalyticsSession* Session, FString Name, float Interval)
+{
+	return CreateAggregator<UAnalyticsGauge>(Session, Name, Interval);
+}
+
+UAnalyticsHistogram* UAnalyticsAggregatorTools::CreateHistogram(UAnalyticsSession* Session, FString Name, float Min, float Max, int32 Buckets, float Interval)
+{
+	UAnalyticsHistogram* histogram = CreateAggregator<UAnalyticsHistogram>(Session, Name, Interval);
+	if (histogram != nullptr) histogram->SetLinear(Min, Max, Buckets);
+	return histogram;
+}
+
+UAnalyticsHistogram* UAnalyticsAggregatorTools::CreateLogHistogram(UAnalyticsSession* Session, FString Name, float Resolution, int32 Bits, float Interval)
+{
+	UAnalyticsHistogram* histogram = CreateAggregator<UAnalyticsHistogram>(Session, Name, Interval);
+	if (histogram != nullptr) histogram->SetLogarithmic(Resolution, Bits);
+	return histogram;
+}
+
+UAnalyticsGrid* UAnalyticsAggregatorTools::CreateGrid(UAnalyticsSession* Session, FString Name, float CellSize, float Interval)
+{
+	UAnalyticsGrid* grid = CreateAggregator<UAnalyticsGrid>(Session, Name, Interval);
+	if (grid != nullptr) grid->SetCellSize(CellSize);
+	return grid;
+}
+
+template<typename T>
+static bool GetSummary(UAnalyticsPacket* packet, T& summary)
+{
+	UAnalyticsStructPacket* struct_packet = Cast<UAnalyticsStructPacket>(packet);
+	const T* data = struct_packet != nullptr ? struct_packet->Get<T>() : nullptr;
+	if (data == nullptr) return false;
+
+	summary = *data;
+	return true;
+}
+
+bool UAnalyticsAggregatorTools::GetCounterSummary(UAnalyticsPacket* Packet, FAnalyticsCounterSummary& Summary)
+{
+	return GetSummary(Packet, Summary);
+}
+
+bool UAnalyticsAggregatorTools::GetGaugeSummary(UAnalyticsPacket* Packet, FAnalyticsGaugeSummary& Summary)
+{
+	return GetSummary(Packet, Summary);
+}
+
+bool UAnalyticsAggregatorTools::GetHistogramSummary(UAnalyticsPacket* Packet, FAnalyticsHistogramSummary& Summary)
+{
+	return GetSummary(Packet, Summary);
+}
+
+bool UAnalyticsAggregatorTools::GetGridSummary(UAnalyticsPacket* Packet, FAnalyticsGridSummary& Summary)
+{
+	return GetSummary(Packet, Summary);
+}
+
+void UAnalyticsAggregatorTools::GetHistogramBucketRange(const FAnalyticsHistogramSummary& Summary, int32 Bucket, float& Lower, float& Upper)
+{
+	UAnalyticsHistogram::GetBucketRange(Summary, Bucket, Lower, Upper);
+}
@@ -1,2 +1,48 @@
 #include "AnalyticsCapture.h"
 #include "DataWise.h"
+#include "AnalyticsPacketTable.h"
+
+const FAnalyticsPacketTable* UAnalyticsCapture::GetTable(UStruct* type) const
+{
+	FAnalyticsPacketTable* const* table = Tables.Find(type);
+	return table != nullptr ? *table : nullptr;
+}
+
+FAnalyticsPacketTable& UAnalyticsCapture::FindOrAddTable(UStruct* type)
+{
+	FAnalyticsPacketTable*& table = Tables.FindOrAdd(type);
+	if (table == nullptr) table = new FAnalyticsPacketTable(type);
+	return *table;
+}
+
+void UAnalyticsCapture::BuildTables()
+{
+	for (UAnalyticsPacket* packet : packets)
+	{
+		UAnalyticsStructPacket* struct_packet = Cast<UAnalyticsStructPacket>(packet);
+		if (struct_packet != nullptr)
+		{
+			if (struct_packet->Struct != nullptr) FindOrAddTable(struct_packet->Struct).Add(packet->PreciseTime, struct_packet->GetData());
+		}
+		else
+		{
+			FindOrAddTable(packet->GetClass()).Add(packet->PreciseTime, packet);
+		}
+	}
+
+	for (TPair<UStruct*, FAnalyticsPacketTable*>& table : Tables)
+	{
+		table.Value->SortByTime();
+	}
+}
+
+void UAnalyticsCapture::BeginDestroy()
+{
+	for (TPair<UStruct*, FAnalyticsPacketTable*>& table : Tables)
+	{
+		delete table.Value;
+	}
+	Tables.Empty();
+
+	Super::BeginDestroy();
+}
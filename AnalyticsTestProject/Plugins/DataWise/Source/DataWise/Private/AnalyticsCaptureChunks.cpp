@@ -0,0 +1,335 @@
+#include "AnalyticsCaptureChunks.h"
+#include "DataWise.h"
+#include "AnalyticsCaptureFormat.h"
+#include "AnalyticsSettings.h"
+#include "Misc/Compression.h"
+#include "Misc/Crc.h"
+#include "Serialization/BufferReader.h"
+
+#define compression_flags ((ECompressionFlags)(COMPRESS_ZLIB | COMPRESS_BiasMemory))
+
+bool FAnalyticsFrameHeader::Serialize(FArchive& archive)
+{
+	uint32 magic = capture_frame_magic;
+	archive << magic;
+	if (magic != capture_frame_magic) return false;
+
+	uint8 compression = (uint8)Compression;
+	archive << StoredSize;
+	archive << RawSize;
+	archive << compression;
+	archive << RecordCount;
+	archive << FirstTimestamp;
+	archive << LastTimestamp;
+	archive << Crc;
+	Compression = (EAnalyticsChunkCompression)compression;
+
+	return !archive.IsError();
+}
+
+FArchive& operator<<(FArchive& archive, FAnalyticsChunkInfo& chunk)
+{
+	archive << chunk.Offset;
+	archive << chunk.FirstTimestamp;
+	archive << chunk.LastTimestamp;
+	archive << chunk.RecordCount;
+	archive << chunk.TypeCounts;
+	return archive;
+}
+
+
+
+
+
+FAnalyticsChunkWriter::FAnalyticsChunkWriter(FArchive* archive_) : archive(archive_)
+{
+	const UAnalyticsSettings* settings = UAnalyticsSettings::Get();
+	chunk_size = settings->ChunkSize;
+	compress = settings->bCompressChunks;
+
+	FAnalyticsCaptureFormat::WriteHeader(*archive);
+	written_size = archive->Tell();
+}
+
+void FAnalyticsChunkWriter::WriteControl(const uint8* record, int32 size)
+{
+	if (finished) return;
+
+	for (FLane& lane : lanes)
+	{
+		lane.Archive.Serialize(const_cast<uint8*>(record), size);
+	}
+
+	registrations.Append(record, size);
+	ReadRegistrations(record, size);
+}
+
+void FAnalyticsChunkWriter::ReadRegistrations(const uint8* record, int32 size)
+{
+	FBufferReader reader(const_cast<uint8*>(record), size, false);
+
+	while (reader.Tell() < size && !reader.IsError())
+	{
+		uint32 control_type;
+		uint32 register_id;
+		FAnalyticsCaptureFormat::SerializeVarInt(reader, control_type);
+		FAnalyticsCaptureFormat::SerializeVarInt(reader, register_id);
+		if (control_type != 0) return;
+
+		// String definition, see FAnalyticsStringTable
+		if (register_id == 0)
+		{
+			uint32 index;
+			FString value;
+			FAnalyticsCaptureFormat::SerializeVarInt(reader, index);
+			FAnalyticsCaptureFormat::SerializeString(reader, value);
+			continue;
+		}
+
+		uint32 schema_hash;
+		uint32 schema_size;
+		reader << schema_hash;
+		FAnalyticsCaptureFormat::SerializeVarInt(reader, schema_size);
+		if (reader.IsError() || schema_size > size - reader.Tell()) return;
+
+		int64 schema_end = reader.Tell() + schema_size;
+
+		FString name;
+		uint32 property_count;
+		FAnalyticsCaptureFormat::SerializeString(reader, name);
+		FAnalyticsCaptureFormat::SerializeVarInt(reader, property_count);
+
+		int32 coordinates = 0;
+		for (uint32 i = 0; i < property_count && !reader.IsError(); i++)
+		{
+			FString property_name;
+			FString property_type;
+			float quantization;
+			uint8 flags;
+			FAnalyticsCaptureFormat::SerializeString(reader, property_name);
+			FAnalyticsCaptureFormat::SerializeString(reader, property_type);
+			reader << quantization;
+			reader << flags;
+
+			if (flags & property_flag_predicted) coordinates += 3;
+		}
+
+		if (coordinates != 0 && !reader.IsError()) predicted_types.Add(register_id, coordinates);
+
+		reader.Seek(schema_end);
+	}
+}
+
+void FAnalyticsChunkWriter::WriteRecord(uint32 type, int64 timestamp, const uint8* payload, int32 size, EAnalyticsLane lane_type)
+{
+	if (finished) return;
+
+	FLane& lane = lanes[(int32)lane_type];
+	FAnalyticsChunkInfo& chunk = lane.Chunk;
+
+	const int32* coordinates = predicted_types.Find(type);
+	int32 prefix_size = coordinates != nullptr ? sizeof(uint32) + *coordinates * sizeof(int32) : 0;
+
+	if (size < prefix_size)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Record of type %u is too short for its predicted vectors and is dropped"), type);
+		return;
+	}
+
+	if (chunk.RecordCount == 0)
+	{
+		chunk.FirstTimestamp = timestamp;
+		chunk.LastTimestamp = timestamp;
+	}
+
+	FAnalyticsCaptureFormat::WriteRecordHeader(lane.Archive, type, timestamp - lane.LastTimestamp);
+
+	// The payload starts with the key and the absolute steps of the predicted vectors, the key stays in the properties that follow
+	if (coordinates != nullptr)
+	{
+		uint32 key;
+		FMemory::Memcpy(&key, payload, sizeof(uint32));
+
+		TArray<int64, TInlineAllocator<6>> values;
+		for (int32 i = 0; i < *coordinates; i++)
+		{
+			int32 steps;
+			FMemory::Memcpy(&steps, payload + sizeof(uint32) + i * sizeof(int32), sizeof(int32));
+			values.Add(steps);
+		}
+
+		lane.Predictor.Encode(type, key, values.GetData(), values.Num());
+
+		for (int64& value : values)
+		{
+			FAnalyticsCaptureFormat::SerializeZigZag(lane.Archive, value);
+		}
+	}
+
+	lane.Archive.Serialize(const_cast<uint8*>(payload + prefix_size), size - prefix_size);
+	lane.LastTimestamp = timestamp;
+
+	chunk.FirstTimestamp = FMath::Min(chunk.FirstTimestamp, timestamp);
+	chunk.LastTimestamp = FMath::Max(chunk.LastTimestamp, timestamp);
+	chunk.RecordCount++;
+	chunk.TypeCounts.FindOrAdd(type)++;
+
+	if (lane.Data.Num() >= chunk_size) FlushChunk(lane_type);
+}
+
+void FAnalyticsChunkWriter::FlushChunk()
+{
+	for (int32 lane = 0; lane < lane_count; lane++)
+	{
+		FlushChunk((EAnalyticsLane)lane);
+	}
+}
+
+void FAnalyticsChunkWriter::FlushChunk(EAnalyticsLane lane_type)
+{
+	FLane& lane = lanes[(int32)lane_type];
+	FAnalyticsChunkInfo& chunk = lane.Chunk;
+	TArray<uint8>& chunk_data = lane.Data;
+
+	// Registrations stay pending until the lane has records, every chunk in the index holds at least one record
+	if (finished || chunk.RecordCount == 0) return;
+
+	FAnalyticsFrameHeader header;
+	header.RawSize = chunk_data.Num();
+	header.RecordCount = chunk.RecordCount;
+	header.FirstTimestamp = chunk.FirstTimestamp;
+	header.LastTimestamp = chunk.LastTimestamp;
+
+	const uint8* stored = chunk_data.GetData();
+	header.StoredSize = chunk_data.Num();
+
+	// Critical chunks are small and flushed often, compressing them would only add latency
+	if (compress && lane_type == EAnalyticsLane::Bulk)
+	{
+		int32 compressed_size = FCompression::CompressMemoryBound(compression_flags, chunk_data.Num());
+		compressed.SetNumUninitialized(compressed_size, false);
+
+		// Chunks that do not shrink are stored as is
+		if (FCompression::CompressMemory(compression_flags, compressed.GetData(), compressed_size, chunk_data.GetData(), chunk_data.Num()) && compressed_size < chunk_data.Num())
+		{
+			header.Compression = EAnalyticsChunkCompression::Zlib;
+			header.StoredSize = compressed_size;
+			stored = compressed.GetData();
+		}
+	}
+
+	header.Crc = FCrc::MemCrc32(stored, header.StoredSize);
+
+	chunk.Offset = archive->Tell();
+	header.Serialize(*archive);
+	archive->Serialize(const_cast<uint8*>(stored), header.StoredSize);
+	written_size = archive->Tell();
+
+	chunks.Add(chunk);
+
+	chunk = FAnalyticsChunkInfo();
+	chunk_data.Reset();
+	lane.Archive.Seek(0);
+	lane.LastTimestamp = 0;
+	lane.Predictor.Reset();
+}
+
+void FAnalyticsChunkWriter::Finish()
+{
+	if (finished) return;
+
+	FlushChunk();
+	finished = true;
+
+	int64 index_offset = archive->Tell();
+	*archive << chunks;
+	*archive << registrations;
+
+	uint32 magic = capture_index_magic;
+	*archive << index_offset;
+	*archive << magic;
+
+	written_size = archive->Tell();
+}
+
+
+
+
+
+bool FAnalyticsChunkIndex::Load(FArchive& archive)
+{
+	const int64 footer_size = sizeof(int64) + sizeof(uint32);
+	int64 start = archive.Tell();
+	if (archive.TotalSize() - start < footer_size) return false;
+
+	int64 index_offset;
+	uint32 magic;
+	archive.Seek(archive.TotalSize() - footer_size);
+	archive << index_offset;
+	archive << magic;
+
+	if (magic != capture_index_magic || index_offset < start || index_offset > archive.TotalSize() - footer_size)
+	{
+		archive.Seek(start);
+		return false;
+	}
+
+	archive.Seek(index_offset);
+	archive << Chunks;
+	archive << Registrations;
+
+	bool valid = !archive.IsError();
+	archive.Seek(start);
+	return valid;
+}
+
+void FAnalyticsChunkIndex::Scan(FArchive& archive)
+{
+	Chunks.Empty();
+	Registrations.Empty();
+
+	while (archive.TotalSize() - archive.Tell() > 0)
+	{
+		FAnalyticsChunkInfo chunk;
+		chunk.Offset = archive.Tell();
+
+		FAnalyticsFrameHeader header;
+		if (!header.Serialize(archive) || header.StoredSize > archive.TotalSize() - archive.Tell()) break;
+
+		chunk.FirstTimestamp = header.FirstTimestamp;
+		chunk.LastTimestamp = header.LastTimestamp;
+		chunk.RecordCount = header.RecordCount;
+		Chunks.Add(chunk);
+
+		archive.Seek(archive.Tell() + header.StoredSize);
+	}
+}
+
+bool FAnalyticsChunkIndex::ReadChunk(FArchive& archive, const FAnalyticsChunkInfo& chunk, FAnalyticsFrameHeader& header, TArray<uint8>& stored)
+{
+	archive.Seek(chunk.Offset);
+
+	if (!header.Serialize(archive) || header.StoredSize > archive.TotalSize() - archive.Tell())
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Invalid chunk at %lld"), chunk.Offset);
+		return false;
+	}
+
+	stored.SetNumUninitialized(header.StoredSize, false);
+	archive.Serialize(stored.GetData(), header.StoredSize);
+	return !archive.IsError();
+}
+
+bool FAnalyticsChunkIndex::Decompress(const FAnalyticsFrameHeader& header, const TArray<uint8>& stored, TArray<uint8>& raw)
+{
+	if (FCrc::MemCrc32(stored.GetData(), stored.Num()) != header.Crc) return false;
+
+	if (header.Compression == EAnalyticsChunkCompression::None)
+	{
+		raw = stored;
+		return true;
+	}
+
+	raw.SetNumUninitialized(header.RawSize, false);
+	return FCompression::UncompressMemory(compression_flags, raw.GetData(), header.RawSize, stored.GetData(), stored.Num());
+}
@@ -0,0 +1,128 @@
+#include "AnalyticsCaptureFormat.h"
+#include "DataWise.h"
+
+void FAnalyticsCaptureFormat::WriteHeader(FArchive& archive)
+{
+	uint32 magic = capture_format_magic;
+	uint32 version = capture_format_version;
+	archive << magic;
+	archive << version;
+}
+
+uint32 FAnalyticsCaptureFormat::ReadHeader(FArchive& archive)
+{
+	int64 start = archive.Tell();
+	if (archive.TotalSize() - start < (int64)sizeof(uint32)) return 1;
+
+	uint32 magic;
+	archive << magic;
+
+	if (magic != capture_format_magic)
+	{
+		archive.Seek(start);
+		return 1;
+	}
+
+	uint32 version;
+	archive << version;
+
+	if (version > capture_format_version)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Capture format version %u is newer than the supported version %u"), version, capture_format_version);
+		return 0;
+	}
+
+	return version;
+}
+
+void FAnalyticsCaptureFormat::SerializeVarInt(FArchive& archive, uint64& value)
+{
+	if (archive.IsLoading())
+	{
+		value = 0;
+		uint8 byte;
+		for (int32 shift = 0; shift < 64; shift += 7)
+		{
+			archive << byte;
+			value |= (uint64)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) return;
+		}
+
+		archive.SetError();
+		return;
+	}
+
+	uint8 bytes[10];
+	int32 count = 0;
+	uint64 remaining = value;
+	do
+	{
+		bytes[count] = remaining & 0x7F;
+		remaining >>= 7;
+		if (remaining != 0) bytes[count] |= 0x80;
+		count++;
+	} while (remaining != 0);
+
+	archive.Serialize(bytes, count);
+}
+
+void FAnalyticsCaptureFormat::SerializeVarInt(FArchive& archive, uint32& value)
+{
+	uint64 wide = value;
+	SerializeVarInt(archive, wide);
+	value = (uint32)wide;
+}
+
+void FAnalyticsCaptureFormat::SerializeZigZag(FArchive& archive, int64& value)
+{
+	uint64 encoded = ((uint64)value << 1) ^ (uint64)(value >> 63);
+	SerializeVarInt(archive, encoded);
+	value = (int64)(encoded >> 1) ^ -(int64)(encoded & 1);
+}
+
+void FAnalyticsCaptureFormat::SerializeZigZag(FArchive& archive, int32& value)
+{
+	int64 wide = value;
+	SerializeZigZag(archive, wide);
+	value = (int32)wide;
+}
+
+void FAnalyticsCaptureFormat::SerializeString(FArchive& archive, FString& value)
+{
+	if (archive.IsLoading())
+	{
+		uint32 length;
+		SerializeVarInt(archive, length);
+
+		if ((int64)length > archive.TotalSize() - archive.Tell())
+		{
+			archive.SetError();
+			value.Empty();
+			return;
+		}
+
+		TArray<ANSICHAR> utf8;
+		utf8.SetNumUninitialized(length + 1);
+		archive.Serialize(utf8.GetData(), length);
+		utf8[length] = 0;
+		value = UTF8_TO_TCHAR(utf8.GetData());
+		return;
+	}
+
+	FTCHARToUTF8 utf8(*value);
+	uint32 length = utf8.Length();
+	SerializeVarInt(archive, length);
+	archive.Serialize(const_cast<ANSICHAR*>(utf8.Get()), length);
+}
+
+void FAnalyticsCaptureFormat::WriteRecordHeader(FArchive& archive, uint32 type, int64 time_delta)
+{
+	SerializeVarInt(archive, type);
+	SerializeZigZag(archive, time_delta);
+}
+
+FString FAnalyticsCaptureFormat::GetSegmentPath(const FString& capture_path, int32 segment)
+{
+	if (segment == 0) return capture_path;
+	return capture_path + FString::Printf(TEXT(".%03i"), segment);
+}
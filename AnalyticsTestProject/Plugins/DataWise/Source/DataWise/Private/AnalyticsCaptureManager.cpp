@@ -1,14 +1,56 @@
 #include "AnalyticsCaptureManager.h"
 #include "DataWise.h"
 #include "AnalyticsLocalCaptureManager.h"
+#include "AnalyticsCaptureUploader.h"
 #include "Engine/Engine.h"
 #include "ASync/Async.h"
 #include "HAL/FileManager.h"
 #include "Misc/Paths.h"
 #include "ClassFinder.h"
 #include "HAL/PlatformFilemanager.h"
+#include "AnalyticsPacketCursor.h"
+#include "AnalyticsPacketTable.h"
 
 
+UAnalyticsCapture* UAnalyticsCaptureManager::DeserializeCaptureTables(FAnalyticsCaptureInfo info, double start_time, double end_time, bool root)
+{
+	FAnalyticsPacketCursor* cursor = OpenCursor(info, start_time, end_time);
+	if (cursor == nullptr) return nullptr;
+
+	UAnalyticsCapture* capture = NewObject<UAnalyticsCapture>(this);
+	if (root) capture->AddToRoot();
+	capture->Name = info.Name;
+	capture->Meta = info.Meta;
+
+	// The table of the previous packet is looked up again only when the type changes, which records of the same chunk rarely do
+	UStruct* table_type = nullptr;
+	FAnalyticsPacketTable* table = nullptr;
+
+	while (cursor->Next())
+	{
+		UAnalyticsPacket* packet = cursor->GetPacket();
+		UAnalyticsStructPacket* struct_packet = Cast<UAnalyticsStructPacket>(packet);
+		UStruct* type = struct_packet != nullptr ? static_cast<UStruct*>(struct_packet->Struct) : static_cast<UStruct*>(packet->GetClass());
+
+		if (type != table_type)
+		{
+			table_type = type;
+			table = &capture->FindOrAddTable(type);
+		}
+
+		table->Add(packet->PreciseTime, struct_packet != nullptr ? struct_packet->GetData() : static_cast<void*>(packet));
+	}
+
+	delete cursor;
+
+	for (TPair<UStruct*, FAnalyticsPacketTable*>& capture_table : capture->Tables)
+	{
+		capture_table.Value->SortByTime();
+	}
+
+	return capture;
+}
+
 UAnalyticsCaptureManagementTools::FOnSelectionChanged UAnalyticsCaptureManagementTools::OnSelectionChanged;
 UAnalyticsCaptureManagementTools::FOnConnectionsChanged UAnalyticsCaptureManagementTools::OnConnectionsChanged;
 
@@ -115,6 +157,24 @@ void UAnalyticsCaptureManagementTools::CacheCapture(FAnalyticsCaptureInfo info,
 
 
 
+void UAnalyticsCaptureManagementTools::StartCaptureUploads()
+{
+	FAnalyticsCaptureUploader::Start();
+}
+
+void UAnalyticsCaptureManagementTools::SetCaptureUploadsPaused(bool Paused)
+{
+	FAnalyticsCaptureUploader::SetPaused(Paused);
+}
+
+int32 UAnalyticsCaptureManagementTools::GetPendingCaptureUploads()
+{
+	return FAnalyticsCaptureUploader::GetPendingFiles();
+}
+
+
+
+
 TArray<UAnalyticsCaptureManagerConnection*> registered_capture_manager_connections;
 TMap<FString, UClass*> registered_capture_manager_connection_tags;
 
@@ -0,0 +1,367 @@
+#include "AnalyticsCaptureMultiplexer.h"
+#include "DataWise.h"
+#include "AnalyticsLocalCaptureManager.h"
+#include "AnalyticsCaptureUploader.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/Paths.h"
+#include "Algo/BinarySearch.h"
+
+#define stream_block_size (64 * 1024)
+
+// Guards the container shared by all sessions, blocks of different streams are written one at a time
+static FCriticalSection multiplexer_mutex;
+static FAnalyticsCaptureMultiplexer* multiplexer_instance = nullptr;
+
+FArchive& operator<<(FArchive& archive, FAnalyticsStreamInfo& stream)
+{
+	archive << stream.Id;
+	archive << stream.Name;
+	archive << stream.Meta;
+	archive << stream.Blocks;
+	return archive;
+}
+
+FArchive* FAnalyticsCaptureMultiplexer::CreateStreamWriter(const FString& name, FString& container, uint32& stream)
+{
+	FScopeLock lock(&multiplexer_mutex);
+
+	if (multiplexer_instance == nullptr)
+	{
+		FString directory = FPaths::ProjectDir() + local_capture_path;
+		FString path = directory + "Server_" + FDateTime::Now().ToString(TEXT("%d%m_%H%M%S")) + multiplex_extension;
+
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		PlatformFile.CreateDirectoryTree(*directory);
+
+		FArchive* archive = IFileManager::Get().CreateFileWriter(*path);
+		if (archive == nullptr || archive->GetError())
+		{
+			UE_LOG(AnalyticsLog, Error, TEXT("Could not create multiplexed capture %s"), *path);
+			delete archive;
+			return nullptr;
+		}
+
+		multiplexer_instance = new FAnalyticsCaptureMultiplexer(archive, path);
+	}
+
+	container = multiplexer_instance->path;
+	stream = multiplexer_instance->next_stream_id++;
+	FAnalyticsStreamInfo& info = multiplexer_instance->streams.Add(stream);
+	info.Id = stream;
+	info.Name = name;
+	multiplexer_instance->open_streams++;
+
+	FString stream_name = name;
+	TArray<uint8> data;
+	FMemoryWriter data_archive(data);
+	data_archive << stream_name;
+	multiplexer_instance->WriteBlock(stream, EAnalyticsStreamBlock::Open, data.GetData(), data.Num());
+
+	return new FAnalyticsStreamWriter(multiplexer_instance, stream);
+}
+
+void FAnalyticsCaptureMultiplexer::SetStreamMeta(const FString& container, uint32 stream, const TMap<FString, FString>& meta)
+{
+	FScopeLock lock(&multiplexer_mutex);
+	if (multiplexer_instance == nullptr || multiplexer_instance->path != container) return;
+
+	FAnalyticsStreamInfo* info = multiplexer_instance->streams.Find(stream);
+	if (info == nullptr) return;
+
+	info->Meta = meta;
+
+	TMap<FString, FString> stream_meta = meta;
+	TArray<uint8> data;
+	FMemoryWriter data_archive(data);
+	data_archive << stream_meta;
+	multiplexer_instance->WriteBlock(stream, EAnalyticsStreamBlock::Meta, data.GetData(), data.Num());
+}
+
+FAnalyticsCaptureMultiplexer::FAnalyticsCaptureMultiplexer(FArchive* archive_, const FString& path_) : archive(archive_), path(path_)
+{
+	uint32 magic = multiplex_magic;
+	uint32 version = multiplex_version;
+	*archive << magic;
+	*archive << version;
+}
+
+void FAnalyticsCaptureMultiplexer::WriteBlock(uint32 stream, EAnalyticsStreamBlock type, const uint8* data, int32 size)
+{
+	FScopeLock lock(&multiplexer_mutex);
+
+	if (type == EAnalyticsStreamBlock::Data) streams.FindOrAdd(stream).Blocks.Add(archive->Tell());
+
+	uint32 magic = multiplex_block_magic;
+	uint8 block_type = (uint8)type;
+	uint32 block_size = size;
+	*archive << magic;
+	*archive << stream;
+	*archive << block_type;
+	*archive << block_size;
+	archive->Serialize(const_cast<uint8*>(data), size);
+
+	// Blocks are only written when a stream flushes, so they reach the disk right away
+	archive->Flush();
+}
+
+void FAnalyticsCaptureMultiplexer::CloseStream(uint32 stream)
+{
+	FScopeLock lock(&multiplexer_mutex);
+
+	WriteBlock(stream, EAnalyticsStreamBlock::Close, nullptr, 0);
+
+	if (--open_streams > 0) return;
+
+	Finish();
+	if (multiplexer_instance == this) multiplexer_instance = nullptr;
+
+	FAnalyticsCaptureUploader::QueueFile(path);
+	delete this;
+}
+
+void FAnalyticsCaptureMultiplexer::Finish()
+{
+	TArray<FAnalyticsStreamInfo> stream_list;
+	streams.GenerateValueArray(stream_list);
+
+	int64 index_offset = archive->Tell();
+	*archive << stream_list;
+
+	uint32 magic = multiplex_index_magic;
+	*archive << index_offset;
+	*archive << magic;
+
+	archive->Flush();
+	archive->Close();
+	delete archive;
+	archive = nullptr;
+}
+
+bool FAnalyticsCaptureMultiplexer::IsWriting(const FString& path)
+{
+	FScopeLock lock(&multiplexer_mutex);
+	return multiplexer_instance != nullptr && FPaths::IsSamePath(multiplexer_instance->path, path);
+}
+
+bool FAnalyticsCaptureMultiplexer::ReadBlockHeader(FArchive& archive, uint32& stream, EAnalyticsStreamBlock& type, uint32& size)
+{
+	const int64 header_size = sizeof(uint32) * 3 + sizeof(uint8);
+	if (archive.TotalSize() - archive.Tell() < header_size) return false;
+
+	uint32 magic;
+	uint8 block_type;
+	archive << magic;
+	if (magic != multiplex_block_magic) return false;
+
+	archive << stream;
+	archive << block_type;
+	archive << size;
+	type = (EAnalyticsStreamBlock)block_type;
+
+	return !archive.IsError() && size <= archive.TotalSize() - archive.Tell();
+}
+
+bool FAnalyticsCaptureMultiplexer::LoadStreams(FArchive& archive, TArray<FAnalyticsStreamInfo>& stream_list)
+{
+	stream_list.Reset();
+
+	uint32 magic = 0;
+	uint32 version = 0;
+	if (archive.TotalSize() < (int64)sizeof(uint32) * 2) return false;
+
+	archive.Seek(0);
+	archive << magic;
+	archive << version;
+	if (magic != multiplex_magic || version > multiplex_version) return false;
+
+	int64 data_start = archive.Tell();
+
+	// Finished containers end with the stream list
+	const int64 footer_size = sizeof(int64) + sizeof(uint32);
+	if (archive.TotalSize() - data_start >= footer_size)
+	{
+		int64 index_offset;
+		uint32 index_magic;
+		archive.Seek(archive.TotalSize() - footer_size);
+		archive << index_offset;
+		archive << index_magic;
+
+		if (index_magic == multiplex_index_magic && index_offset >= data_start && index_offset < archive.TotalSize() - footer_size)
+		{
+			archive.Seek(index_offset);
+			archive << stream_list;
+			if (!archive.IsError()) return true;
+
+			archive.ClearError();
+			stream_list.Reset();
+		}
+	}
+
+	// Containers that were not closed are recovered up to the first torn block
+	TMap<uint32, FAnalyticsStreamInfo> found;
+	archive.Seek(data_start);
+
+	uint32 stream;
+	EAnalyticsStreamBlock type;
+	uint32 size;
+	TArray<uint8> data;
+
+	while (true)
+	{
+		int64 offset = archive.Tell();
+		if (!ReadBlockHeader(archive, stream, type, size)) break;
+
+		FAnalyticsStreamInfo& info = found.FindOrAdd(stream);
+		info.Id = stream;
+
+		if (type == EAnalyticsStreamBlock::Data)
+		{
+			info.Blocks.Add(offset);
+			archive.Seek(archive.Tell() + size);
+			continue;
+		}
+
+		data.SetNumUninitialized(size);
+		archive.Serialize(data.GetData(), size);
+		FMemoryReader data_archive(data);
+
+		if (type == EAnalyticsStreamBlock::Open) data_archive << info.Name;
+		if (type == EAnalyticsStreamBlock::Meta) data_archive << info.Meta;
+	}
+
+	archive.ClearError();
+	found.GenerateValueArray(stream_list);
+	return true;
+}
+
+
+
+
+
+FAnalyticsStreamWriter::FAnalyticsStreamWriter(FAnalyticsCaptureMultiplexer* multiplexer_, uint32 stream_) : multiplexer(multiplexer_), stream(stream_)
+{
+	ArIsSaving = true;
+	ArIsPersistent = true;
+}
+
+FAnalyticsStreamWriter::~FAnalyticsStreamWriter()
+{
+	Close();
+}
+
+void FAnalyticsStreamWriter::Serialize(void* data, int64 size)
+{
+	if (closed) return;
+
+	buffer.Append(static_cast<uint8*>(data), size);
+	position += size;
+
+	if (buffer.Num() >= stream_block_size) Flush();
+}
+
+void FAnalyticsStreamWriter::Seek(int64 new_position)
+{
+	// Blocks are handed to the container as they fill up, the capture writer only ever appends
+	check(new_position == position);
+}
+
+void FAnalyticsStreamWriter::Flush()
+{
+	if (closed || buffer.Num() == 0) return;
+
+	multiplexer->WriteBlock(stream, EAnalyticsStreamBlock::Data, buffer.GetData(), buffer.Num());
+	buffer.Reset();
+}
+
+bool FAnalyticsStreamWriter::Close()
+{
+	if (closed) return true;
+
+	Flush();
+	closed = true;
+	multiplexer->CloseStream(stream);
+	multiplexer = nullptr;
+
+	return true;
+}
+
+
+
+
+
+FAnalyticsStreamReader::FAnalyticsStreamReader(FArchive* container_, const FAnalyticsStreamInfo& stream) : container(container_)
+{
+	ArIsLoading = true;
+	ArIsPersistent = true;
+
+	for (int64 offset : stream.Blocks)
+	{
+		container->Seek(offset);
+
+		uint32 block_stream;
+		EAnalyticsStreamBlock type;
+		uint32 block_size;
+		if (!FAnalyticsCaptureMultiplexer::ReadBlockHeader(*container, block_stream, type, block_size) || block_stream != stream.Id || type != EAnalyticsStreamBlock::Data)
+		{
+			UE_LOG(AnalyticsLog, Error, TEXT("Block at %lld of stream %s is corrupted"), offset, *stream.Name);
+			break;
+		}
+
+		FBlock block;
+		block.Offset = container->Tell();
+		block.Position = size;
+		block.Size = block_size;
+		blocks.Add(block);
+
+		size += block_size;
+	}
+
+	container->ClearError();
+}
+
+FAnalyticsStreamReader::~FAnalyticsStreamReader()
+{
+	delete container;
+}
+
+void FAnalyticsStreamReader::Serialize(void* data, int64 length)
+{
+	uint8* output = static_cast<uint8*>(data);
+
+	while (length > 0)
+	{
+		if (position < 0 || position >= size)
+		{
+			ArIsError = true;
+			FMemory::Memzero(output, length);
+			return;
+		}
+
+		// Reads go forward through the blocks nearly always, the block of the last read is tried first
+		if (!blocks.IsValidIndex(current_block) || position < blocks[current_block].Position || position >= blocks[current_block].Position + blocks[current_block].Size)
+		{
+			current_block = Algo::UpperBoundBy(blocks, position, [](const FBlock& block) { return block.Position; }) - 1;
+		}
+
+		const FBlock& block = blocks[current_block];
+		int64 block_position = position - block.Position;
+		int64 count = FMath::Min(length, block.Size - block_position);
+
+		if (container->Tell() != block.Offset + block_position) container->Seek(block.Offset + block_position);
+		container->Serialize(output, count);
+
+		if (container->IsError())
+		{
+			ArIsError = true;
+			return;
+		}
+
+		output += count;
+		length -= count;
+		position += count;
+	}
+}
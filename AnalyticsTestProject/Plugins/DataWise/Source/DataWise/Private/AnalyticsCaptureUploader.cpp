@@ -0,0 +1,373 @@
+#include "AnalyticsCaptureUploader.h"
+#include "DataWise.h"
+#include "AnalyticsCaptureManager.h"
+#include "AnalyticsCaptureMultiplexer.h"
+#include "AnalyticsCaptureFormat.h"
+#include "AnalyticsLocalCaptureManager.h"
+#include "AnalyticsSession.h"
+#include "AnalyticsSettings.h"
+#include "HAL/FileManager.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/Paths.h"
+#include "Misc/CoreDelegates.h"
+
+#define upload_block_size (256 * 1024)
+
+// Files are stored under this suffix until they are complete, so the destination never lists a partial capture
+#define upload_part_extension ".part"
+
+static FCriticalSection uploader_mutex;
+static FAnalyticsCaptureUploader* uploader_instance = nullptr;
+static FThreadSafeBool uploads_paused;
+static bool uploader_failed = false;
+
+void FAnalyticsCaptureUploader::Start()
+{
+	FAnalyticsCaptureUploader* uploader = GetInstance();
+	if (uploader == nullptr) return;
+
+	TArray<FString> active;
+	for (UAnalyticsSession* session : UAnalyticsSession::GetActiveSessions())
+	{
+		active.Add(session->GetName());
+	}
+
+	UAnalyticsSession::RecoverCrashDumps();
+
+	// Captures left behind by earlier runs, including ones that were cut short by a crash
+	FString directory = FPaths::ProjectDir() + local_capture_path;
+	IFileManager& FileManager = IFileManager::Get();
+
+	TArray<FString> files;
+	FileManager.FindFiles(files, *directory, TEXT(".cap"));
+	for (const FString& file : files)
+	{
+		FString name = FPaths::GetBaseFilename(file);
+		if (!active.Contains(name)) QueueCapture(name);
+	}
+
+	FileManager.FindFiles(files, *directory, TEXT(multiplex_extension));
+	for (const FString& file : files)
+	{
+		FString path = directory + file;
+		if (!FAnalyticsCaptureMultiplexer::IsWriting(path)) uploader->Queue(path);
+	}
+}
+
+void FAnalyticsCaptureUploader::QueueCapture(const FString& name)
+{
+	FAnalyticsCaptureUploader* uploader = GetInstance();
+	if (uploader == nullptr) return;
+
+	FString path = FPaths::ProjectDir() + local_capture_path + name + ".cap";
+
+	// The first segment is uploaded last, so a capture is only listed by the destination once all of it is there
+	int32 segment_count = 0;
+	while (FPaths::FileExists(FAnalyticsCaptureFormat::GetSegmentPath(path, segment_count))) segment_count++;
+
+	for (int32 segment = 1; segment < segment_count; segment++)
+	{
+		uploader->Queue(FAnalyticsCaptureFormat::GetSegmentPath(path, segment));
+	}
+
+	FString meta_path = FPaths::ProjectDir() + local_capture_path + name + ".meta";
+	if (FPaths::FileExists(meta_path)) uploader->Queue(meta_path);
+
+	if (segment_count > 0) uploader->Queue(path);
+}
+
+void FAnalyticsCaptureUploader::QueueFile(const FString& path)
+{
+	FAnalyticsCaptureUploader* uploader = GetInstance();
+	if (uploader == nullptr) return;
+
+	uploader->Queue(path);
+}
+
+void FAnalyticsCaptureUploader::SetPaused(bool paused)
+{
+	uploads_paused = paused;
+
+	FScopeLock lock(&uploader_mutex);
+	if (uploader_instance != nullptr && !paused) uploader_instance->wake_event->Trigger();
+}
+
+int32 FAnalyticsCaptureUploader::GetPendingFiles()
+{
+	FScopeLock lock(&uploader_mutex);
+	if (uploader_instance == nullptr) return 0;
+
+	FScopeLock pending_lock(&uploader_instance->pending_mutex);
+	return uploader_instance->pending.Num();
+}
+
+int64 FAnalyticsCaptureUploader::GetUploadedBytes()
+{
+	FScopeLock lock(&uploader_mutex);
+	if (uploader_instance == nullptr) return 0;
+
+	return uploader_instance->uploaded_bytes.GetValue();
+}
+
+FAnalyticsCaptureUploader* FAnalyticsCaptureUploader::GetInstance()
+{
+	FScopeLock lock(&uploader_mutex);
+	if (uploader_instance != nullptr || uploader_failed) return uploader_instance;
+
+	const UAnalyticsSettings* settings = UAnalyticsSettings::Get();
+	if (!settings->bUploadCaptures) return nullptr;
+
+	UClass** type = UAnalyticsCaptureManagementTools::GetCaptureManagerConnectionTags().Find(settings->UploadConnection);
+	if (type == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Captures can not be uploaded, there is no capture manager with tag %s"), *settings->UploadConnection);
+		uploader_failed = true;
+		return nullptr;
+	}
+
+	UAnalyticsCaptureManagerConnection* connection = NewObject<UAnalyticsCaptureManagerConnection>((UObject*)GetTransientPackage(), *type);
+	connection->AddToRoot();
+
+	for (const TPair<FString, FString>& setting : settings->UploadConnectionSettings)
+	{
+		UProperty* property = FindField<UProperty>(*type, *setting.Key);
+		if (property == nullptr)
+		{
+			UE_LOG(AnalyticsLog, Warning, TEXT("Capture manager %s has no setting %s"), *settings->UploadConnection, *setting.Key);
+			continue;
+		}
+
+		property->ImportText(*setting.Value, property->ContainerPtrToValuePtr<void>(connection), PPF_None, nullptr);
+	}
+
+	uploader_instance = new FAnalyticsCaptureUploader(settings, connection);
+	FCoreDelegates::OnPreExit.AddStatic(&FAnalyticsCaptureUploader::Shutdown);
+
+	return uploader_instance;
+}
+
+void FAnalyticsCaptureUploader::Shutdown()
+{
+	FAnalyticsCaptureUploader* uploader;
+	{
+		FScopeLock lock(&uploader_mutex);
+		uploader = uploader_instance;
+		uploader_instance = nullptr;
+	}
+
+	// Files that are not done are picked up again by the next Start
+	delete uploader;
+}
+
+FAnalyticsCaptureUploader::FAnalyticsCaptureUploader(const UAnalyticsSettings* settings, UAnalyticsCaptureManagerConnection* connection_) : connection(connection_)
+{
+	retries = settings->UploadRetries;
+	retry_delay = settings->UploadRetryDelay;
+	bandwidth = (int64)settings->UploadBandwidth * 1024;
+	pause_during_sessions = settings->bPauseUploadDuringSessions;
+	delete_uploaded = settings->bDeleteUploadedCaptures;
+
+	should_stop = false;
+	wake_event = FGenericPlatformProcess::GetSynchEventFromPool(false);
+	thread = FRunnableThread::Create(this, TEXT("FAnalyticsCaptureUploader"), 0, TPri_Lowest);
+}
+
+FAnalyticsCaptureUploader::~FAnalyticsCaptureUploader()
+{
+	if (thread != nullptr)
+	{
+		Stop();
+		thread->WaitForCompletion();
+		delete thread;
+		thread = nullptr;
+	}
+
+	FGenericPlatformProcess::ReturnSynchEventToPool(wake_event);
+	wake_event = nullptr;
+
+	Disconnect();
+	connection->RemoveFromRoot();
+}
+
+void FAnalyticsCaptureUploader::Queue(const FString& path)
+{
+	{
+		FScopeLock lock(&pending_mutex);
+		for (const FPendingFile& file : pending)
+		{
+			if (file.Path == path) return;
+		}
+
+		FPendingFile file;
+		file.Path = path;
+		pending.Add(file);
+	}
+
+	wake_event->Trigger();
+}
+
+bool FAnalyticsCaptureUploader::IsHeld()
+{
+	if (should_stop || uploads_paused) return true;
+	if (!pause_during_sessions) return false;
+
+	// Flight recorders run for the whole game and write nothing, they do not hold uploads
+	return UAnalyticsSession::GetRecordingSessionCount() > 0;
+}
+
+uint32 FAnalyticsCaptureUploader::Run()
+{
+	while (!should_stop)
+	{
+		if (IsHeld())
+		{
+			wake_event->Wait(1000);
+			continue;
+		}
+
+		double now = FPlatformTime::Seconds();
+		FString path;
+		{
+			FScopeLock lock(&pending_mutex);
+			for (const FPendingFile& file : pending)
+			{
+				if (file.RetryTime <= now) { path = file.Path; break; }
+			}
+		}
+
+		if (path.IsEmpty())
+		{
+			wake_event->Wait(1000);
+			continue;
+		}
+
+		if (destination == nullptr)
+		{
+			destination = connection->GetManager();
+			if (destination == nullptr) UE_LOG(AnalyticsLog, Warning, TEXT("Could not connect to %s to upload captures"), *connection->GetInfo());
+		}
+
+		EUploadResult result = destination != nullptr ? Upload(path) : EUploadResult::Failed;
+		if (result == EUploadResult::Interrupted) continue;
+
+		if (result == EUploadResult::Done && delete_uploaded)
+		{
+			IFileManager::Get().Delete(*path);
+		}
+
+		FScopeLock lock(&pending_mutex);
+		int32 index = pending.IndexOfByPredicate([&path](const FPendingFile& file) { return file.Path == path; });
+		if (index == INDEX_NONE) continue;
+
+		if (result == EUploadResult::Done)
+		{
+			pending.RemoveAt(index);
+			continue;
+		}
+
+		// A broken connection is only noticed when it is used, it is opened again for the next attempt
+		Disconnect();
+
+		FPendingFile& file = pending[index];
+		file.Attempts++;
+
+		if (file.Attempts > retries)
+		{
+			UE_LOG(AnalyticsLog, Error, TEXT("Giving up on uploading %s after %i attempts"), *path, file.Attempts);
+			pending.RemoveAt(index);
+			continue;
+		}
+
+		file.RetryTime = FPlatformTime::Seconds() + retry_delay * FMath::Pow(2.0f, (float)(file.Attempts - 1));
+		UE_LOG(AnalyticsLog, Warning, TEXT("Could not upload %s, retrying in %.0f seconds"), *path, file.RetryTime - FPlatformTime::Seconds());
+	}
+
+	return 0;
+}
+
+void FAnalyticsCaptureUploader::Stop()
+{
+	should_stop = true;
+
+	if (wake_event)
+	{
+		wake_event->Trigger();
+	}
+}
+
+FAnalyticsCaptureUploader::EUploadResult FAnalyticsCaptureUploader::Upload(const FString& path)
+{
+	int64 size = IFileManager::Get().FileSize(*path);
+	if (size < 0) return EUploadResult::Done;
+
+	FString file = FPaths::GetCleanFilename(path);
+	FString part = file + upload_part_extension;
+
+	int64 stored = destination->GetStoredFileSize(file);
+	if (stored == size) return EUploadResult::Done;
+
+	// Resumes a part that an earlier attempt left behind
+	int64 offset = destination->GetStoredFileSize(part);
+	if (stored < 0 || offset < 0) return EUploadResult::Failed;
+	if (offset > size) offset = 0;
+
+	FArchive* reader = IFileManager::Get().CreateFileReader(*path);
+	if (reader == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Could not open %s for uploading"), *path);
+		return EUploadResult::Failed;
+	}
+
+	reader->Seek(offset);
+
+	TArray<uint8> block;
+	while (offset < size)
+	{
+		if (IsHeld())
+		{
+			delete reader;
+			return EUploadResult::Interrupted;
+		}
+
+		double block_start = FPlatformTime::Seconds();
+		int32 block_size = (int32)FMath::Min<int64>(upload_block_size, size - offset);
+
+		block.SetNumUninitialized(block_size);
+		reader->Serialize(block.GetData(), block_size);
+
+		if (reader->IsError() || !destination->WriteStoredFile(part, offset, block.GetData(), block_size))
+		{
+			delete reader;
+			return EUploadResult::Failed;
+		}
+
+		offset += block_size;
+		uploaded_bytes.Add(block_size);
+
+		Throttle(block_size, block_start);
+	}
+
+	delete reader;
+
+	if (!destination->RenameStoredFile(part, file)) return EUploadResult::Failed;
+
+	UE_LOG(AnalyticsLog, Log, TEXT("Uploaded %s"), *file);
+	return EUploadResult::Done;
+}
+
+void FAnalyticsCaptureUploader::Throttle(int32 size, double start)
+{
+	if (bandwidth <= 0) return;
+
+	double remaining = (double)size / bandwidth - (FPlatformTime::Seconds() - start);
+	if (remaining > 0.0) FPlatformProcess::Sleep((float)remaining);
+}
+
+void FAnalyticsCaptureUploader::Disconnect()
+{
+	if (destination == nullptr) return;
+
+	connection->ReleaseManager();
+	destination = nullptr;
+}
@@ -0,0 +1,999 @@
+#include "AnalyticsCaptureWriter.h"
+#include "DataWise.h"
+#include "AnalyticsCaptureChunks.h"
+#include "AnalyticsCaptureFormat.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/PlatformProcess.h"
+
+static int64 LoadPosition(volatile const int64* position)
+{
+	return FPlatformAtomics::InterlockedCompareExchange((volatile int64*)position, 0, 0);
+}
+
+// Type, timestamp and lane in front of every buffered record
+static const int32 record_header_size = sizeof(uint32) + sizeof(int64) + sizeof(uint8);
+
+static void PackRecordHeader(uint8* header, uint32 type, int64 timestamp, EAnalyticsLane lane)
+{
+	FMemory::Memcpy(header, &type, sizeof(uint32));
+	FMemory::Memcpy(header + sizeof(uint32), &timestamp, sizeof(int64));
+	header[sizeof(uint32) + sizeof(int64)] = (uint8)lane;
+}
+
+static void UnpackRecordHeader(const uint8* header, uint32& type, int64& timestamp, EAnalyticsLane& lane)
+{
+	FMemory::Memcpy(&type, header, sizeof(uint32));
+	FMemory::Memcpy(&timestamp, header + sizeof(uint32), sizeof(int64));
+	lane = (EAnalyticsLane)header[sizeof(uint32) + sizeof(int64)];
+}
+
+// States of a buffer, a retired buffer has no ring until it is revived
+static const int32 buffer_idle = 0;
+static const int32 buffer_claimed = 1;
+static const int32 buffer_retired = 2;
+
+// Seconds a thread has to go without reporting before the ring of its buffer is freed
+static const double buffer_retire_delay = 10.0;
+
+// Sections of a crash dump, each is a kind and a size followed by the bytes of the section
+static const uint32 crash_dump_magic = 0x50444644;
+static const uint8 crash_section_control = 0;
+static const uint8 crash_section_records = 1;
+static const int32 crash_section_header_size = sizeof(uint8) + sizeof(uint64);
+
+FAnalyticsRecordBuffer::FAnalyticsRecordBuffer(uint32 requested_capacity)
+{
+	capacity = FMath::RoundUpToPowerOfTwo(FMath::Max<uint32>(requested_capacity, 1024));
+	mask = capacity - 1;
+	data.SetNumUninitialized(capacity);
+}
+
+bool FAnalyticsRecordBuffer::Claim()
+{
+	return FPlatformAtomics::InterlockedCompareExchange(&state, buffer_claimed, buffer_idle) == buffer_idle;
+}
+
+void FAnalyticsRecordBuffer::Release()
+{
+	FPlatformAtomics::InterlockedExchange(&state, buffer_idle);
+}
+
+bool FAnalyticsRecordBuffer::Retire()
+{
+	if (FPlatformAtomics::InterlockedCompareExchange(&state, buffer_retired, buffer_idle) != buffer_idle) return false;
+
+	// A record may have been pushed after the caller found the buffer empty
+	if (!IsEmpty())
+	{
+		Release();
+		return false;
+	}
+
+	data.Empty();
+	return true;
+}
+
+bool FAnalyticsRecordBuffer::Revive()
+{
+	if (state != buffer_retired) return false;
+
+	data.SetNumUninitialized(capacity);
+	Release();
+	return true;
+}
+
+bool FAnalyticsRecordBuffer::IsRetired() const
+{
+	return state == buffer_retired;
+}
+
+bool FAnalyticsRecordBuffer::IsIdleFor(double now, double duration)
+{
+	int64 write = LoadPosition(&write_position);
+	if (write != idle_position || LoadPosition(&read_position) != write)
+	{
+		idle_position = write;
+		idle_since = now;
+		return false;
+	}
+
+	return now - idle_since >= duration;
+}
+
+bool FAnalyticsRecordBuffer::Push(const uint8* header, uint32 header_size, const uint8* payload, uint32 payload_size)
+{
+	int64 write = write_position;
+	int64 read = LoadPosition(&read_position);
+	uint32 size = header_size + payload_size;
+	uint64 required = sizeof(uint32) + size;
+
+	if ((uint64)(write - read) + required > capacity) return false;
+
+	WriteBytes(write, reinterpret_cast<const uint8*>(&size), sizeof(uint32));
+	if (header_size != 0) WriteBytes(write + sizeof(uint32), header, header_size);
+	WriteBytes(write + sizeof(uint32) + header_size, payload, payload_size);
+
+	FPlatformMisc::MemoryBarrier();
+	FPlatformAtomics::InterlockedExchange(&write_position, write + required);
+	return true;
+}
+
+bool FAnalyticsRecordBuffer::Pop(TArray<uint8>& record)
+{
+	while (true)
+	{
+		int64 read = LoadPosition(&read_position);
+		int64 write = LoadPosition(&write_position);
+		if (read == write) return false;
+
+		uint32 size;
+		ReadBytes(read, reinterpret_cast<uint8*>(&size), sizeof(uint32));
+
+		// The producer may have discarded this record in the meantime, in which case size is garbage
+		if ((uint64)size + sizeof(uint32) > (uint64)(write - read))
+		{
+			if (LoadPosition(&read_position) == read)
+			{
+				UE_LOG(AnalyticsLog, Error, TEXT("Writer buffer is corrupted"));
+				return false;
+			}
+			continue;
+		}
+
+		record.SetNumUninitialized(size, false);
+		ReadBytes(read + sizeof(uint32), record.GetData(), size);
+
+		if (FPlatformAtomics::InterlockedCompareExchange(&read_position, read + sizeof(uint32) + size, read) == read) return true;
+	}
+}
+
+bool FAnalyticsRecordBuffer::Peek(uint8* destination, uint32 size) const
+{
+	int64 read = LoadPosition(&read_position);
+	int64 write = LoadPosition(&write_position);
+	if (read == write) return false;
+
+	uint32 record_size;
+	ReadBytes(read, reinterpret_cast<uint8*>(&record_size), sizeof(uint32));
+	if (record_size < size || (uint64)record_size + sizeof(uint32) > (uint64)(write - read)) return false;
+
+	ReadBytes(read + sizeof(uint32), destination, size);
+	return true;
+}
+
+bool FAnalyticsRecordBuffer::DiscardOldest()
+{
+	int64 read = LoadPosition(&read_position);
+	if (read == write_position) return false;
+
+	uint32 size;
+	ReadBytes(read, reinterpret_cast<uint8*>(&size), sizeof(uint32));
+
+	return FPlatformAtomics::InterlockedCompareExchange(&read_position, read + sizeof(uint32) + size, read) == read;
+}
+
+void FAnalyticsRecordBuffer::ForEachRecord(TFunctionRef<void(const TArray<uint8>& record)> visitor) const
+{
+	int64 write = LoadPosition(&write_position);
+	TArray<uint8> record;
+
+	for (int64 read = LoadPosition(&read_position); read < write;)
+	{
+		uint32 size;
+		ReadBytes(read, reinterpret_cast<uint8*>(&size), sizeof(uint32));
+
+		record.SetNumUninitialized(size, false);
+		ReadBytes(read + sizeof(uint32), record.GetData(), size);
+		visitor(record);
+
+		read += sizeof(uint32) + size;
+	}
+}
+
+void FAnalyticsRecordBuffer::GetBytes(const uint8*& first, uint64& first_size, const uint8*& second, uint64& second_size) const
+{
+	int64 read = LoadPosition(&read_position);
+	int64 write = LoadPosition(&write_position);
+
+	uint64 used = write - read;
+	uint64 start = read & mask;
+
+	first = data.GetData() + start;
+	first_size = FMath::Min<uint64>(used, capacity - start);
+	second = data.GetData();
+	second_size = used - first_size;
+}
+
+bool FAnalyticsRecordBuffer::IsEmpty() const
+{
+	return LoadPosition(&read_position) == LoadPosition(&write_position);
+}
+
+uint64 FAnalyticsRecordBuffer::GetUsed() const
+{
+	return LoadPosition(&write_position) - LoadPosition(&read_position);
+}
+
+void FAnalyticsRecordBuffer::ReadBytes(int64 position, uint8* destination, uint32 size) const
+{
+	uint64 start = position & mask;
+	uint64 first = FMath::Min<uint64>(size, capacity - start);
+	FMemory::Memcpy(destination, data.GetData() + start, first);
+	if (first < size) FMemory::Memcpy(destination + first, data.GetData(), size - first);
+}
+
+void FAnalyticsRecordBuffer::WriteBytes(int64 position, const uint8* source, uint32 size)
+{
+	uint64 start = position & mask;
+	uint64 first = FMath::Min<uint64>(size, capacity - start);
+	FMemory::Memcpy(data.GetData() + start, source, first);
+	if (first < size) FMemory::Memcpy(data.GetData(), source + first, size - first);
+}
+
+
+
+
+
+static FThreadSafeCounter next_writer_id;
+
+FAnalyticsCaptureWriter::FAnalyticsCaptureWriter(FArchive* archive_, const FString& path_, double start_time_, const UAnalyticsSettings* settings) : archive(archive_), path(path_), start_time(start_time_), policy(settings->BackpressurePolicy)
+{
+	chunk_writer = new FAnalyticsChunkWriter(archive);
+	Start(settings);
+}
+
+FAnalyticsCaptureWriter::FAnalyticsCaptureWriter(double start_time_, const UAnalyticsSettings* settings) : start_time(start_time_), policy(settings->BackpressurePolicy)
+{
+	recording_duration = FAnalyticsCaptureFormat::ToTimestamp(settings->FlightRecorderDuration * 60.0);
+	recording_size = (uint64)FMath::Max(settings->FlightRecorderSize, 1) * 1024 * 1024;
+	recording = new FAnalyticsRecordBuffer((uint32)FMath::Min<uint64>(recording_size, MAX_uint32 / 2 + 1));
+	recording_size = FMath::Min(recording_size, recording->GetCapacity());
+	Start(settings);
+}
+
+void FAnalyticsCaptureWriter::Start(const UAnalyticsSettings* settings)
+{
+	should_stop = false;
+
+	id = next_writer_id.Increment();
+
+	// Archives that are not files of their own, like streams of a multiplexed capture, are not split
+	segment_size = path.IsEmpty() ? 0 : (int64)settings->SegmentSize * 1024 * 1024;
+	flush_interval = settings->FlushInterval;
+	last_flush_time = FPlatformTime::Seconds();
+	critical_latency = settings->CriticalFlushLatency / 1000.0;
+	merge_window = FAnalyticsCaptureFormat::ToTimestamp(settings->MergeWindow / 1000.0);
+	buffer_size = settings->WriterBufferSize;
+	threaded = settings->bAsyncWriter;
+
+	UpdateWrittenSize();
+
+	if (threaded)
+	{
+		wake_event = FGenericPlatformProcess::GetSynchEventFromPool(false);
+		drain_event = FGenericPlatformProcess::GetSynchEventFromPool(false);
+		thread = FRunnableThread::Create(this, TEXT("FAnalyticsCaptureWriter"), 0, TPri_BelowNormal);
+	}
+}
+
+FAnalyticsCaptureWriter::~FAnalyticsCaptureWriter()
+{
+	Close();
+
+	if (wake_event)
+	{
+		FGenericPlatformProcess::ReturnSynchEventToPool(wake_event);
+		wake_event = nullptr;
+	}
+
+	if (drain_event)
+	{
+		FGenericPlatformProcess::ReturnSynchEventToPool(drain_event);
+		drain_event = nullptr;
+	}
+
+	for (TPair<uint32, FAnalyticsRecordBuffer*>& buffer : buffers)
+	{
+		delete buffer.Value;
+	}
+	buffers.Empty();
+
+	delete recording;
+	recording = nullptr;
+
+	if (crash_file != nullptr)
+	{
+		delete crash_file;
+		crash_file = nullptr;
+
+		if (!crash_dumped) IFileManager::Get().Delete(*crash_path);
+	}
+}
+
+void FAnalyticsCaptureWriter::WriteControl(const TArray<uint8>& record)
+{
+	// Registrations of a flight recorder are kept apart from its records anyway, storing them right away leaves nothing in the queue a crash dump would miss
+	if (recording != nullptr)
+	{
+		Store(record);
+		return;
+	}
+
+	if (!threaded)
+	{
+		FScopeLock lock(&store_mutex);
+		Store(record);
+		FlushIfDue();
+		return;
+	}
+
+	control_queue.Enqueue(record);
+}
+
+void FAnalyticsCaptureWriter::WriteRecord(uint32 type, int64 timestamp, const TArray<uint8>& payload, EAnalyticsLane lane)
+{
+	if (!threaded)
+	{
+		FScopeLock lock(&store_mutex);
+		StoreRecord(type, timestamp, payload.GetData(), payload.Num(), lane);
+		FlushIfDue();
+		return;
+	}
+
+	FAnalyticsRecordBuffer* buffer = ClaimThreadBuffer();
+
+	uint8 header[record_header_size];
+	PackRecordHeader(header, type, timestamp, lane);
+
+	if (sizeof(uint32) + sizeof(header) + payload.Num() > buffer->GetCapacity())
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Event of %i bytes does not fit in the writer buffer"), payload.Num());
+		buffer->Release();
+		CountDropped();
+		return;
+	}
+
+	while (!buffer->Push(header, sizeof(header), payload.GetData(), payload.Num()))
+	{
+		switch (policy)
+		{
+		case EAnalyticsBackpressurePolicy::DropNewest:
+			buffer->Release();
+			CountDropped();
+			return;
+
+		case EAnalyticsBackpressurePolicy::DropOldest:
+			if (buffer->DiscardOldest()) CountDropped();
+			break;
+
+		default:
+			wake_event->Trigger();
+			drain_event->Wait(10);
+			break;
+		}
+	}
+
+	if (buffer->GetUsed() > buffer->GetCapacity() / 2) wake_event->Trigger();
+	buffer->Release();
+}
+
+void FAnalyticsCaptureWriter::WriteDelayedRecord(uint32 type, int64 timestamp, const TArray<uint8>& payload)
+{
+	if (!threaded)
+	{
+		FScopeLock lock(&store_mutex);
+		StoreRecord(type, timestamp, payload.GetData(), payload.Num(), EAnalyticsLane::Bulk);
+		FlushIfDue();
+		return;
+	}
+
+	FDelayedRecord record;
+	record.Type = type;
+	record.Timestamp = timestamp;
+	record.Payload = payload;
+
+	FScopeLock lock(&delayed_mutex);
+	delayed_records.HeapPush(MoveTemp(record));
+	delayed_count.Increment();
+}
+
+void FAnalyticsCaptureWriter::SetMergeHold(int64 timestamp)
+{
+	FPlatformAtomics::InterlockedExchange(&merge_hold, timestamp);
+}
+
+FAnalyticsRecordBuffer* FAnalyticsCaptureWriter::ClaimThreadBuffer()
+{
+	FAnalyticsThreadContext& context = FAnalyticsThreadContext::Get();
+	if (context.WriterId == id && context.Buffer->Claim()) return context.Buffer;
+
+	uint32 thread_id = FPlatformTLS::GetCurrentThreadId();
+
+	FScopeLock lock(&buffers_mutex);
+
+	FAnalyticsRecordBuffer*& buffer = buffers.FindOrAdd(thread_id);
+	if (buffer == nullptr)
+	{
+		buffer = new FAnalyticsRecordBuffer(buffer_size);
+		buffers_version.Increment();
+	}
+	else if (buffer->Revive())
+	{
+		buffers_version.Increment();
+	}
+
+	// Buffers are only retired while holding the lock
+	buffer->Claim();
+
+	context.WriterId = id;
+	context.Buffer = buffer;
+	return buffer;
+}
+
+void FAnalyticsCaptureWriter::RetireIdleBuffers()
+{
+	double now = FPlatformTime::Seconds();
+
+	for (FAnalyticsRecordBuffer* buffer : merge_buffers)
+	{
+		if (!buffer->IsIdleFor(now, buffer_retire_delay)) continue;
+
+		// Threads that stopped reporting, like finished tasks, would otherwise keep their ring until the session ends
+		FScopeLock lock(&buffers_mutex);
+		if (buffer->Retire()) buffers_version.Increment();
+	}
+}
+
+void FAnalyticsCaptureWriter::Close()
+{
+	if (thread != nullptr)
+	{
+		Stop();
+		thread->WaitForCompletion();
+		delete thread;
+		thread = nullptr;
+	}
+
+	if (chunk_writer != nullptr)
+	{
+		chunk_writer->Finish();
+		UpdateWrittenSize();
+		delete chunk_writer;
+		chunk_writer = nullptr;
+	}
+
+	if (archive != nullptr)
+	{
+		archive->Flush();
+		archive->Close();
+		delete archive;
+		archive = nullptr;
+	}
+}
+
+uint32 FAnalyticsCaptureWriter::Run()
+{
+	while (!should_stop)
+	{
+		wake_event->Wait(10);
+
+		FScopeLock lock(&store_mutex);
+		Drain(false);
+		drain_event->Trigger();
+
+		RetireIdleBuffers();
+		FlushIfDue();
+	}
+
+	// Clean drain of everything reported before the session ended
+	FScopeLock lock(&store_mutex);
+	Drain(true);
+	drain_event->Trigger();
+
+	return 0;
+}
+
+void FAnalyticsCaptureWriter::Stop()
+{
+	should_stop = true;
+
+	if (wake_event)
+	{
+		wake_event->Trigger();
+	}
+}
+
+void FAnalyticsCaptureWriter::Drain(bool all)
+{
+	if (merge_buffers_version != buffers_version.GetValue())
+	{
+		FScopeLock lock(&buffers_mutex);
+		merge_buffers_version = buffers_version.GetValue();
+
+		merge_buffers.Reset();
+		for (TPair<uint32, FAnalyticsRecordBuffer*>& buffer : buffers)
+		{
+			if (!buffer.Value->IsRetired()) merge_buffers.Add(buffer.Value);
+		}
+	}
+
+	// Records younger than the merge window may still be preceded by records of other threads that are about to be reported,
+	// and records after the hold by delayed records that are about to be written
+	int64 horizon = FAnalyticsCaptureFormat::ToTimestamp(FPlatformTime::Seconds() - start_time) - merge_window;
+	horizon = FMath::Min(horizon, LoadPosition(&merge_hold) - 1);
+
+	uint8 header[record_header_size];
+
+	while (true)
+	{
+		// Every buffer is in timestamp order, so the oldest record is at the head of one of them
+		FAnalyticsRecordBuffer* oldest = nullptr;
+		int64 oldest_timestamp = 0;
+
+		for (FAnalyticsRecordBuffer* buffer : merge_buffers)
+		{
+			if (!buffer->Peek(header, record_header_size)) continue;
+
+			uint32 type;
+			int64 timestamp;
+			EAnalyticsLane lane;
+			UnpackRecordHeader(header, type, timestamp, lane);
+
+			if (oldest == nullptr || timestamp < oldest_timestamp)
+			{
+				oldest = buffer;
+				oldest_timestamp = timestamp;
+			}
+		}
+
+		bool delayed = false;
+		if (delayed_count.GetValue() > 0)
+		{
+			FScopeLock lock(&delayed_mutex);
+			if (delayed_records.Num() > 0 && (oldest == nullptr || delayed_records.HeapTop().Timestamp < oldest_timestamp))
+			{
+				delayed = true;
+				oldest_timestamp = delayed_records.HeapTop().Timestamp;
+			}
+		}
+
+		if ((oldest == nullptr && !delayed) || (!all && oldest_timestamp > horizon)) break;
+
+		if (delayed)
+		{
+			{
+				FScopeLock lock(&delayed_mutex);
+				delayed_records.HeapPop(drain_delayed);
+				delayed_count.Decrement();
+			}
+
+			DrainControl();
+			StoreRecord(drain_delayed.Type, drain_delayed.Timestamp, drain_delayed.Payload.GetData(), drain_delayed.Payload.Num(), EAnalyticsLane::Bulk);
+			continue;
+		}
+
+		if (!oldest->Pop(drain_record)) continue;
+
+		// Registrations are queued before the records depending on them, so all that were queued before this record was popped are stored first
+		DrainControl();
+
+		uint32 type;
+		int64 timestamp;
+		EAnalyticsLane lane;
+		UnpackRecordHeader(drain_record.GetData(), type, timestamp, lane);
+		StoreRecord(type, timestamp, drain_record.GetData() + record_header_size, drain_record.Num() - record_header_size, lane);
+	}
+
+	DrainControl();
+
+#if STATS
+	int64 queue_depth = 0;
+	for (FAnalyticsRecordBuffer* buffer : merge_buffers)
+	{
+		queue_depth += buffer->GetUsed();
+	}
+	SET_MEMORY_STAT(STAT_DataWiseQueueDepth, queue_depth);
+#endif
+}
+
+void FAnalyticsCaptureWriter::DrainControl()
+{
+	while (control_queue.Dequeue(drain_control))
+	{
+		Store(drain_control);
+	}
+}
+
+void FAnalyticsCaptureWriter::Store(const TArray<uint8>& record)
+{
+	if (recording != nullptr)
+	{
+		FScopeLock lock(&recording_mutex);
+		recording_registrations.Append(record);
+		return;
+	}
+
+	if (chunk_writer == nullptr) return;
+
+	chunk_writer->WriteControl(record.GetData(), record.Num());
+}
+
+void FAnalyticsCaptureWriter::StoreRecord(uint32 type, int64 timestamp, const uint8* payload, int32 size, EAnalyticsLane lane)
+{
+	if (recording != nullptr)
+	{
+		uint8 header[record_header_size];
+		PackRecordHeader(header, type, timestamp, lane);
+		Record(header, payload, size);
+		return;
+	}
+
+	if (chunk_writer == nullptr)
+	{
+		CountDropped();
+		return;
+	}
+
+	if (lane == EAnalyticsLane::Critical && !chunk_writer->HasPendingRecords(lane)) critical_pending_time = FPlatformTime::Seconds();
+
+	chunk_writer->WriteRecord(type, timestamp, payload, size, lane);
+	UpdateWrittenSize();
+
+	if (segment_size > 0 && chunk_writer->GetWrittenSize() >= segment_size) RotateSegment();
+}
+
+void FAnalyticsCaptureWriter::FlushIfDue()
+{
+	if (chunk_writer == nullptr) return;
+
+	double now = FPlatformTime::Seconds();
+
+	// Critical records are flushed on their own, without waiting for the bulk chunk to fill up
+	if (chunk_writer->HasPendingRecords(EAnalyticsLane::Critical) && now - critical_pending_time >= critical_latency && now - last_flush_time < flush_interval)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_DataWiseFlush);
+
+		chunk_writer->FlushChunk(EAnalyticsLane::Critical);
+		archive->Flush();
+		UpdateWrittenSize();
+
+		flush_latency.Add(FPlatformTime::Seconds() - now);
+		return;
+	}
+
+	if (now - last_flush_time < flush_interval) return;
+	last_flush_time = now;
+
+	SCOPE_CYCLE_COUNTER(STAT_DataWiseFlush);
+
+	// Every stored chunk is complete and checksummed, so a crash loses at most the records since the last flush
+	chunk_writer->FlushChunk();
+	archive->Flush();
+	UpdateWrittenSize();
+
+	flush_latency.Add(FPlatformTime::Seconds() - now);
+}
+
+void FAnalyticsCaptureWriter::RotateSegment()
+{
+	TArray<uint8> registrations = chunk_writer->GetRegistrations();
+
+	chunk_writer->Finish();
+	finished_segments_size += chunk_writer->GetWrittenSize();
+	delete chunk_writer;
+	chunk_writer = nullptr;
+
+	archive->Flush();
+	archive->Close();
+	delete archive;
+
+	segment++;
+	FString segment_path = FAnalyticsCaptureFormat::GetSegmentPath(path, segment);
+	archive = IFileManager::Get().CreateFileWriter(*segment_path);
+
+	if (archive == nullptr || archive->GetError())
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Could not create capture segment %s, further events are dropped"), *segment_path);
+		delete archive;
+		archive = nullptr;
+		return;
+	}
+
+	// Every segment can be read on its own
+	chunk_writer = new FAnalyticsChunkWriter(archive);
+	chunk_writer->WriteControl(registrations.GetData(), registrations.Num());
+	UpdateWrittenSize();
+}
+
+void FAnalyticsCaptureWriter::UpdateWrittenSize()
+{
+	written_size.Set(finished_segments_size + (chunk_writer != nullptr ? chunk_writer->GetWrittenSize() : 0));
+}
+
+void FAnalyticsCaptureWriter::Record(const uint8* header, const uint8* payload, int32 size)
+{
+	FScopeLock lock(&recording_mutex);
+
+	uint32 type;
+	int64 timestamp;
+	EAnalyticsLane lane;
+	UnpackRecordHeader(header, type, timestamp, lane);
+
+	uint64 required = sizeof(uint32) + record_header_size + size;
+	if (required > recording_size) return;
+
+	// Oldest records make room for new ones and are discarded once they fall out of the recorded duration
+	while (recording->GetUsed() + required > recording_size)
+	{
+		recording->DiscardOldest();
+	}
+
+	uint8 oldest[record_header_size];
+	while (recording_duration > 0 && recording->Peek(oldest, record_header_size))
+	{
+		uint32 oldest_type;
+		int64 oldest_timestamp;
+		EAnalyticsLane oldest_lane;
+		UnpackRecordHeader(oldest, oldest_type, oldest_timestamp, oldest_lane);
+		if (oldest_timestamp >= timestamp - recording_duration) break;
+
+		recording->DiscardOldest();
+	}
+
+	recording->Push(header, record_header_size, payload, size);
+	written_size.Set(recording->GetUsed() + recording_registrations.Num());
+}
+
+bool FAnalyticsCaptureWriter::Dump(const FString& dump_path)
+{
+	if (recording == nullptr) return false;
+
+	FArchive* dump_archive = IFileManager::Get().CreateFileWriter(*dump_path);
+	if (dump_archive == nullptr || dump_archive->GetError())
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Could not write flight recorder to %s"), *dump_path);
+		delete dump_archive;
+		return false;
+	}
+
+	{
+		// Stops the writer thread and stores what reporting threads have buffered, so the dump is not missing the most recent records
+		FScopeLock store_lock(&store_mutex);
+		if (threaded) Drain(true);
+		DrainControl();
+
+		FScopeLock lock(&recording_mutex);
+
+		FAnalyticsChunkWriter dump_writer(dump_archive);
+		dump_writer.WriteControl(recording_registrations.GetData(), recording_registrations.Num());
+
+		recording->ForEachRecord([&](const TArray<uint8>& record)
+		{
+			uint32 type;
+			int64 timestamp;
+			EAnalyticsLane lane;
+			UnpackRecordHeader(record.GetData(), type, timestamp, lane);
+			dump_writer.WriteRecord(type, timestamp, record.GetData() + record_header_size, record.Num() - record_header_size, lane);
+		});
+
+		dump_writer.Finish();
+	}
+
+	dump_archive->Flush();
+	dump_archive->Close();
+	delete dump_archive;
+
+	return true;
+}
+
+void FAnalyticsCaptureWriter::OpenCrashDump(const FString& path_)
+{
+	if (recording == nullptr || crash_file != nullptr) return;
+
+	crash_path = path_;
+	crash_file = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*crash_path);
+
+	if (crash_file == nullptr) UE_LOG(AnalyticsLog, Error, TEXT("Could not create crash dump %s"), *crash_path);
+}
+
+void FAnalyticsCaptureWriter::WriteCrashDump()
+{
+	if (crash_file == nullptr || crash_dumped) return;
+	crash_dumped = true;
+
+	// Records are of no use without the registrations, an empty dump is discarded by the next run
+	if (!recording_mutex.TryLock()) return;
+
+	crash_file->Write(reinterpret_cast<const uint8*>(&crash_dump_magic), sizeof(uint32));
+
+	WriteCrashSection(crash_section_control, recording_registrations.Num());
+	crash_file->Write(recording_registrations.GetData(), recording_registrations.Num());
+	WriteCrashBuffer(*recording);
+
+	recording_mutex.Unlock();
+
+	// Buffers are only read, a record the writer thread stores in the meantime may end up in the dump twice
+	if (buffers_mutex.TryLock())
+	{
+		for (const TPair<uint32, FAnalyticsRecordBuffer*>& buffer : buffers)
+		{
+			WriteCrashBuffer(*buffer.Value);
+		}
+
+		buffers_mutex.Unlock();
+	}
+
+	if (delayed_mutex.TryLock())
+	{
+		uint64 size = 0;
+		for (const FDelayedRecord& record : delayed_records)
+		{
+			size += sizeof(uint32) + record_header_size + record.Payload.Num();
+		}
+
+		WriteCrashSection(crash_section_records, size);
+
+		uint8 header[record_header_size];
+		for (const FDelayedRecord& record : delayed_records)
+		{
+			uint32 record_size = record_header_size + record.Payload.Num();
+			PackRecordHeader(header, record.Type, record.Timestamp, EAnalyticsLane::Bulk);
+
+			crash_file->Write(reinterpret_cast<const uint8*>(&record_size), sizeof(uint32));
+			crash_file->Write(header, record_header_size);
+			crash_file->Write(record.Payload.GetData(), record.Payload.Num());
+		}
+
+		delayed_mutex.Unlock();
+	}
+}
+
+void FAnalyticsCaptureWriter::WriteCrashSection(uint8 kind, uint64 size)
+{
+	uint8 section[crash_section_header_size];
+	section[0] = kind;
+	FMemory::Memcpy(section + sizeof(uint8), &size, sizeof(uint64));
+	crash_file->Write(section, crash_section_header_size);
+}
+
+void FAnalyticsCaptureWriter::WriteCrashBuffer(const FAnalyticsRecordBuffer& buffer)
+{
+	const uint8* first;
+	const uint8* second;
+	uint64 first_size;
+	uint64 second_size;
+	buffer.GetBytes(first, first_size, second, second_size);
+
+	WriteCrashSection(crash_section_records, first_size + second_size);
+	crash_file->Write(first, first_size);
+	if (second_size > 0) crash_file->Write(second, second_size);
+}
+
+bool FAnalyticsCaptureWriter::RecoverCrashDump(const FString& dump_path, const FString& capture_path)
+{
+	TArray<uint8> dump;
+	if (!FFileHelper::LoadFileToArray(dump, *dump_path) || dump.Num() < sizeof(uint32)) return false;
+
+	uint32 magic;
+	FMemory::Memcpy(&magic, dump.GetData(), sizeof(uint32));
+	if (magic != crash_dump_magic) return false;
+
+	struct FRecoveredRecord
+	{
+		int64 Timestamp;
+		int64 Offset;
+		uint32 Size;
+	};
+
+	TArray<uint8> control;
+	TArray<FRecoveredRecord> records;
+
+	// The dump may have been cut short by the crash, everything up to the first incomplete record is kept
+	int64 position = sizeof(uint32);
+	while (position + crash_section_header_size <= dump.Num())
+	{
+		uint8 kind = dump[position];
+		uint64 size;
+		FMemory::Memcpy(&size, dump.GetData() + position + sizeof(uint8), sizeof(uint64));
+		position += crash_section_header_size;
+
+		int64 end = position + (int64)FMath::Min<uint64>(size, dump.Num() - position);
+
+		if (kind == crash_section_control)
+		{
+			control.Append(dump.GetData() + position, end - position);
+		}
+		else
+		{
+			for (int64 record = position; record + (int64)sizeof(uint32) <= end;)
+			{
+				uint32 record_size;
+				FMemory::Memcpy(&record_size, dump.GetData() + record, sizeof(uint32));
+				if (record_size < (uint32)record_header_size || record + (int64)sizeof(uint32) + record_size > end) break;
+
+				uint32 type;
+				int64 timestamp;
+				EAnalyticsLane lane;
+				UnpackRecordHeader(dump.GetData() + record + sizeof(uint32), type, timestamp, lane);
+
+				FRecoveredRecord recovered;
+				recovered.Timestamp = timestamp;
+				recovered.Offset = record + sizeof(uint32);
+				recovered.Size = record_size;
+				records.Add(recovered);
+
+				record += sizeof(uint32) + record_size;
+			}
+		}
+
+		if ((uint64)(end - position) < size) break;
+		position = end;
+	}
+
+	if (control.Num() == 0) return false;
+
+	// Every buffer is in timestamp order, but the buffers of different threads overlap
+	records.StableSort([](const FRecoveredRecord& a, const FRecoveredRecord& b) { return a.Timestamp < b.Timestamp; });
+
+	FArchive* capture_archive = IFileManager::Get().CreateFileWriter(*capture_path);
+	if (capture_archive == nullptr || capture_archive->GetError())
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Could not write recovered flight recorder to %s"), *capture_path);
+		delete capture_archive;
+		return false;
+	}
+
+	{
+		FAnalyticsChunkWriter capture_writer(capture_archive);
+		capture_writer.WriteControl(control.GetData(), control.Num());
+
+		for (int32 index = 0; index < records.Num(); index++)
+		{
+			const FRecoveredRecord& recovered = records[index];
+
+			// A record that was moved from a thread buffer to the recording while the dump was written is in both
+			bool duplicate = false;
+			for (int32 previous = index - 1; previous >= 0 && records[previous].Timestamp == recovered.Timestamp && !duplicate; previous--)
+			{
+				duplicate = records[previous].Size == recovered.Size && FMemory::Memcmp(dump.GetData() + records[previous].Offset, dump.GetData() + recovered.Offset, recovered.Size) == 0;
+			}
+			if (duplicate) continue;
+
+			uint32 type;
+			int64 timestamp;
+			EAnalyticsLane lane;
+			UnpackRecordHeader(dump.GetData() + recovered.Offset, type, timestamp, lane);
+			capture_writer.WriteRecord(type, timestamp, dump.GetData() + recovered.Offset + record_header_size, recovered.Size - record_header_size, lane);
+		}
+
+		capture_writer.Finish();
+	}
+
+	capture_archive->Flush();
+	capture_archive->Close();
+	delete capture_archive;
+
+	return true;
+}
+
+void FAnalyticsCaptureWriter::CountDropped()
+{
+	dropped_count.Increment();
+	INC_DWORD_STAT(STAT_DataWiseDropped);
+}
+
+int64 FAnalyticsCaptureWriter::GetQueueDepth()
+{
+	FScopeLock lock(&buffers_mutex);
+
+	int64 queue_depth = 0;
+	for (TPair<uint32, FAnalyticsRecordBuffer*>& buffer : buffers)
+	{
+		queue_depth += buffer.Value->GetUsed();
+	}
+
+	return queue_depth;
+}
@@ -1,11 +1,22 @@
 #include "AnalyticsLocalCaptureManager.h"
 #include "DataWise.h"
 #include "ClassFinder.h"
+#include "AnalyticsCaptureFormat.h"
+#include "AnalyticsCaptureMultiplexer.h"
 #include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/BufferReader.h"
+#include "Async/ParallelFor.h"
 #include "Misc/FileHelper.h"
 #include "Misc/Paths.h"
 #include "HAL/PlatformFilemanager.h"
+#include "HAL/FileManager.h"
 #include "AnalyticsPacket.h"
+#include "AnalyticsSchemaCatalog.h"
+#include "AnalyticsPacketCursor.h"
+#include "AnalyticsSettings.h"
+#include "UObject/UObjectIterator.h"
+#include "Misc/ScopeLock.h"
 
 
 UAnalyticsLocalCaptureManager* local_capture_manager_ = nullptr;
@@ -33,31 +44,138 @@ FAnalyticsCaptureInfo UAnalyticsLocalCaptureManager::SerializeCaptureToCache(UAn
 
 UAnalyticsCapture* UAnalyticsLocalCaptureManager::DeserializeCapture(FAnalyticsCaptureInfo info)
 {
-	FString directory = FPaths::ProjectDir() + local_capture_path;
-	FString path = directory + info.Name + ".cap";
+	return DeserializeCaptureRange(info, 0.0, TNumericLimits<double>::Max());
+}
+
+// Decodes straight from a mapping of the file where the platform supports it, and through a file reader otherwise.
+// Neither reads the whole file up front, so a large capture does not need its size in memory on top of its packets.
+static void DeserializeFile(const FString& path, UAnalyticsCapture* capture, double start_time, double end_time)
+{
+	IPlatformFile& platform_file = FPlatformFileManager::Get().GetPlatformFile();
+	if (platform_file.FileSize(*path) <= 0) return;
+
+	IMappedFileHandle* mapped_file = platform_file.OpenMapped(*path);
+	IMappedFileRegion* mapped_region = mapped_file != nullptr ? mapped_file->MapRegion() : nullptr;
+
+	if (mapped_region != nullptr)
+	{
+		FBufferReader archive(const_cast<uint8*>(mapped_region->GetMappedPtr()), mapped_region->GetMappedSize(), false, true);
+
+		LocalPacketDeserializer deserializer(&archive, capture);
+		deserializer.Process(start_time, end_time);
+
+		delete mapped_region;
+		delete mapped_file;
+		return;
+	}
+
+	delete mapped_file;
+
+	FArchive* archive = IFileManager::Get().CreateFileReader(*path);
+	if (archive == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Capture could not be opened: %s"), *path);
+		return;
+	}
+
+	LocalPacketDeserializer deserializer(archive, capture);
+	deserializer.Process(start_time, end_time);
+
+	archive->Close();
+	delete archive;
+}
 
-	if(!FPaths::FileExists(path))
+FString UAnalyticsLocalCaptureManager::FindCapturePath(const FString& name)
+{
+	FString path = FPaths::ProjectDir() + local_capture_path + name + ".cap";
+	if (FPaths::FileExists(path)) return path;
+
+	path = FPaths::ProjectDir() + local_cache_path + name + ".cap";
+	if (FPaths::FileExists(path)) return path;
+
+	return FString();
+}
+
+int64 UAnalyticsLocalCaptureManager::GetStoredCaptureSize(FAnalyticsCaptureInfo info)
+{
+	IFileManager& file_manager = IFileManager::Get();
+	FString path = FindCapturePath(info.Name);
+
+	if (path.IsEmpty())
 	{
-		directory = FPaths::ProjectDir() + local_cache_path;
-		path = directory + info.Name + ".cap";
+		// Size of the whole container, the size of the stream would require reading its block headers
+		return !info.Container.IsEmpty() ? FMath::Max<int64>(file_manager.FileSize(*info.Container), 0) : 0;
 	}
 
-	if (!FPaths::FileExists(path))
+	int64 size = 0;
+	for (int32 segment = 0; FPaths::FileExists(FAnalyticsCaptureFormat::GetSegmentPath(path, segment)); segment++)
 	{
+		size += FMath::Max<int64>(file_manager.FileSize(*FAnalyticsCaptureFormat::GetSegmentPath(path, segment)), 0);
+	}
+	return size;
+}
+
+FAnalyticsPacketCursor* UAnalyticsLocalCaptureManager::OpenCursor(FAnalyticsCaptureInfo info, double start_time, double end_time)
+{
+	FString path = FindCapturePath(info.Name);
+	TArray<FArchive*> archives;
+
+	if (path.IsEmpty())
+	{
+		// Streams of a multiplexed capture are read from their blocks in the container, like the segments of a capture file
+		FArchive* stream = OpenMultiplexedStream(info);
+		if (stream == nullptr) return nullptr;
+
+		archives.Add(stream);
+	}
+	else
+	{
+		// Read through file readers, the cursor only holds the chunk it is at
+		for (int32 segment = 0; FPaths::FileExists(FAnalyticsCaptureFormat::GetSegmentPath(path, segment)); segment++)
+		{
+			FArchive* archive = IFileManager::Get().CreateFileReader(*FAnalyticsCaptureFormat::GetSegmentPath(path, segment));
+			if (archive != nullptr) archives.Add(archive);
+		}
+	}
+
+	return new FAnalyticsPacketCursor(info.Name, archives, start_time, end_time);
+}
+
+UAnalyticsCapture* UAnalyticsLocalCaptureManager::DeserializeCaptureRange(FAnalyticsCaptureInfo info, double start_time, double end_time, bool root)
+{
+	FString path = FindCapturePath(info.Name);
+
+	if (path.IsEmpty())
+	{
+		FArchive* stream = OpenMultiplexedStream(info);
+		if (stream != nullptr)
+		{
+			UAnalyticsCapture* capture = NewObject<UAnalyticsCapture>(this);
+			if (root) capture->AddToRoot();
+			capture->Name = info.Name;
+
+			LocalPacketDeserializer deserializer(stream, capture);
+			deserializer.Process(start_time, end_time);
+			delete stream;
+
+			capture->Meta = info.Meta;
+			return capture;
+		}
+
 		UE_LOG(AnalyticsLog, Error, TEXT("Capture not found in storage or cache: %s"), *info.Name);
 		return nullptr;
 	}
 
-	// Capture
-
-	TArray<uint8> file_data;
-	FFileHelper::LoadFileToArray(file_data, *path);
-	FMemoryReader archive = FMemoryReader(file_data, true);
+	// Capture, segments are complete captures that continue each other
 
 	UAnalyticsCapture* capture = NewObject<UAnalyticsCapture>(this);
+	if (root) capture->AddToRoot();
 	capture->Name = info.Name;
-	LocalPacketDeserializer deserializer(&archive, capture);
-	deserializer.Process();
+
+	for (int32 segment = 0; FPaths::FileExists(FAnalyticsCaptureFormat::GetSegmentPath(path, segment)); segment++)
+	{
+		DeserializeFile(FAnalyticsCaptureFormat::GetSegmentPath(path, segment), capture, start_time, end_time);
+	}
 
 	capture->Meta = info.Meta;
 
@@ -96,9 +214,80 @@ TArray<FAnalyticsCaptureInfo> UAnalyticsLocalCaptureManager::FindCaptures()
 		result.Add(info);
 	}
 
+	// Every stream of a multiplexed capture is listed as a capture of its own
+	FileManager.FindFiles(files, *directory, TEXT(multiplex_extension));
+
+	for (const FString& file : files)
+	{
+		FString path = directory + file;
+
+		// Only the stream list at the end of the container is read
+		FArchive* archive = IFileManager::Get().CreateFileReader(*path);
+		if (archive == nullptr) continue;
+
+		TArray<FAnalyticsStreamInfo> streams;
+		bool loaded = FAnalyticsCaptureMultiplexer::LoadStreams(*archive, streams);
+		delete archive;
+		if (!loaded) continue;
+
+		TMap<FString, int32> name_count;
+		for (const FAnalyticsStreamInfo& stream : streams)
+		{
+			name_count.FindOrAdd(stream.Name)++;
+		}
+
+		for (const FAnalyticsStreamInfo& stream : streams)
+		{
+			if (stream.Blocks.Num() == 0) continue;
+
+			// Sessions started in the same second have the same name, the id tells their streams apart
+			FAnalyticsCaptureInfo info;
+			info.Name = name_count[stream.Name] > 1 ? stream.Name + FString::Printf(TEXT("_%u"), stream.Id) : stream.Name;
+			info.Meta = stream.Meta;
+			info.Source = Connection;
+			info.Container = path;
+			info.Stream = stream.Id;
+			result.Add(info);
+		}
+	}
+
 	return result;
 }
 
+FArchive* UAnalyticsLocalCaptureManager::OpenMultiplexedStream(const FAnalyticsCaptureInfo& info)
+{
+	if (info.Container.IsEmpty()) return nullptr;
+
+	// The blocks of the stream are read from the container, without loading the other streams
+	FArchive* archive = IFileManager::Get().CreateFileReader(*info.Container);
+	if (archive == nullptr) return nullptr;
+
+	// Listed again, a container that is still written has gained blocks since FindCaptures
+	TArray<FAnalyticsStreamInfo> streams;
+	const FAnalyticsStreamInfo* stream = nullptr;
+	if (FAnalyticsCaptureMultiplexer::LoadStreams(*archive, streams))
+	{
+		stream = streams.FindByPredicate([&](const FAnalyticsStreamInfo& candidate) { return candidate.Id == info.Stream; });
+	}
+
+	if (stream == nullptr)
+	{
+		delete archive;
+		return nullptr;
+	}
+
+	FAnalyticsStreamReader* reader = new FAnalyticsStreamReader(archive, *stream);
+
+	// Nothing could be read when the first block is corrupted already
+	if (reader->TotalSize() == 0 && stream->Blocks.Num() != 0)
+	{
+		delete reader;
+		return nullptr;
+	}
+
+	return reader;
+}
+
 TArray<FAnalyticsCaptureInfo> UAnalyticsLocalCaptureManager::FindCachedCaptures()
 {
 	FString directory = FPaths::ProjectDir() + local_cache_path;
@@ -134,7 +323,15 @@ void UAnalyticsLocalCaptureManager::DeleteStoredCapture(FAnalyticsCaptureInfo in
 {
 	FString directory = FPaths::ProjectDir() + local_capture_path;
 	FString path = directory + info.Name + ".cap";
-	FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*path);
+
+	if (!FPaths::FileExists(path) && !info.Container.IsEmpty())
+	{
+		UE_LOG(AnalyticsLog, Warning, TEXT("%s is a stream of multiplexed capture %s and is only deleted with it"), *info.Name, *info.Container);
+		return;
+	}
+
+	int32 segment = 0;
+	while (FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*FAnalyticsCaptureFormat::GetSegmentPath(path, segment))) segment++;
 
 	path = directory + info.Name + ".meta";
 	FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*path);
@@ -208,9 +405,29 @@ FAnalyticsCaptureInfo UAnalyticsLocalCaptureManager::SerializeCaptureToDirectory
 
 
 
-LocalPacketSerializer::LocalPacketSerializer(FArchive* archive_) : archive(archive_), next_packet_id(1)
+LocalPacketSerializer::LocalPacketSerializer(FArchive* archive_, FArchive* registration_archive_) : archive(archive_), registration_archive(registration_archive_), next_packet_id(1)
 {
+	if (registration_archive == nullptr && archive != nullptr)
+	{
+		chunk_writer = new FAnalyticsChunkWriter(archive);
+		registration_archive = new FMemoryWriter(registration_data);
 
+		strings.SetOutput([this](const TArray<uint8>& definition) { chunk_writer->WriteControl(definition.GetData(), definition.Num()); });
+	}
+}
+
+LocalPacketSerializer::~LocalPacketSerializer()
+{
+	for (TPair<UStruct*, FLocalPacketType*>& packet_type : packet_types)
+	{
+		delete packet_type.Value;
+	}
+
+	if (chunk_writer == nullptr) return;
+
+	chunk_writer->Finish();
+	delete chunk_writer;
+	delete registration_archive;
 }
 
 void LocalPacketSerializer::AddPacket(UAnalyticsPacket* packet)
@@ -227,66 +444,70 @@ void LocalPacketSerializer::AddPacket(UAnalyticsPacket* packet)
 		return;
 	}
 
-	UClass* reported_class = packet->GetClass();
-
-	PacketTypeIndex packet_id = 0;
-	PacketTypeIndex* packet_id_ptr = packet_types.Find(reported_class);
-	if (packet_id_ptr == nullptr)
+	UAnalyticsStructPacket* struct_packet = Cast<UAnalyticsStructPacket>(packet);
+	if (struct_packet != nullptr && struct_packet->Struct != nullptr)
 	{
-		packet_id = RegisterPacketType(TSubclassOf<UAnalyticsPacket>(reported_class));
+		AddPacket(struct_packet->Struct, struct_packet->GetData(), struct_packet->PreciseTime);
+		return;
 	}
-	else {
-		packet_id = *packet_id_ptr;
+
+	AddPacket(packet->GetClass(), packet, packet->PreciseTime);
+}
+
+void LocalPacketSerializer::AddPacket(UStruct* type, const void* container, double time)
+{
+	if (chunk_writer == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Serializer does not write a capture!"));
+		return;
 	}
 
-	*archive << packet_id;
+	const FLocalPacketType& packet_type = GetPacketType(type);
+
+	payload_data.Reset();
+	FMemoryWriter payload_archive(payload_data);
+	SerializePayload(payload_archive, packet_type, container, &strings);
+
+	chunk_writer->WriteRecord(packet_type.Index, FAnalyticsCaptureFormat::ToTimestamp(time), payload_data.GetData(), payload_data.Num(), packet_type.Lane);
+}
+
+const FLocalPacketType& LocalPacketSerializer::GetPacketType(UStruct* type)
+{
+	FLocalPacketType** packet_type = packet_types.Find(type);
+	if (packet_type != nullptr) return **packet_type;
+
+	return RegisterPacketType(type);
+}
 
-	for (TFieldIterator<UProperty> property_iterator(reported_class); property_iterator; ++property_iterator)
+void LocalPacketSerializer::RegisterLoadedTypes(TArray<const FLocalPacketType*>& registered)
+{
+	for (TObjectIterator<UClass> iterator; iterator; ++iterator)
 	{
-		UProperty* prop = *property_iterator;
-		FString type = prop->GetCPPType();
-		FString name = prop->GetNameCPP();
-		FString value;
+		UClass* found_class = *iterator;
+		if (!found_class->IsChildOf(UAnalyticsPacket::StaticClass()) || found_class == UAnalyticsPacket::StaticClass() || found_class->IsChildOf(UAnalyticsStructPacket::StaticClass())) continue;
+		if (found_class->HasAnyClassFlags(CLASS_Abstract | CLASS_Deprecated | CLASS_NewerVersionExists)) continue;
 
-		if (type.Equals("FString")) {
-			FString* data = prop->ContainerPtrToValuePtr<FString>(packet);
-			*archive << *data;
-		}
-		else if (type.Equals("FVector")) {
-			FVector* data = prop->ContainerPtrToValuePtr<FVector>(packet);
-			*archive << *data;
-		}
-		else if (type.Equals("int32")) {
-			int32* data = prop->ContainerPtrToValuePtr<int32>(packet);
-			*archive << *data;
-		}
-		else if (type.Equals("uint32")) {
-			uint32* data = prop->ContainerPtrToValuePtr<uint32>(packet);
-			*archive << *data;
-		}
-		else if (type.Equals("uint8")) {
-			uint8* data = prop->ContainerPtrToValuePtr<uint8>(packet);
-			*archive << *data;
-		}
-		else if (type.Equals("bool")) {
-			bool* data = prop->ContainerPtrToValuePtr<bool>(packet);
-			*archive << *data;
-		}
-		else if (type.Equals("float")) {
-			float* data = prop->ContainerPtrToValuePtr<float>(packet);
-			*archive << *data;
-		}
-		else if (type.Equals("FVector2D")) {
-			FVector2D* data = prop->ContainerPtrToValuePtr<FVector2D>(packet);
-			*archive << *data;
-		}
-		else
-		{
-			UE_LOG(AnalyticsLog, Error, TEXT("Unsupported property type: %s (%s)"), *type, *name);
-		}
+		// Intermediate classes of blueprint compilation
+		FString class_name = found_class->GetName();
+		if (class_name.StartsWith(TEXT("SKEL_")) || class_name.StartsWith(TEXT("REINST_"))) continue;
+
+		if (packet_types.Find(found_class) != nullptr) continue;
+
+		registered.Add(&RegisterPacketType(found_class));
 	}
 }
 
+void LocalPacketSerializer::SerializePayload(FArchive& archive, const FLocalPacketType& type, const void* container, FAnalyticsStringTable* strings)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DataWiseSerialize);
+#if STATS
+	FScopeCycleCounter type_counter(type.StatId);
+#endif
+
+	// The archive only reads from the container while saving
+	type.Plan->SerializeCompact(archive, const_cast<void*>(container), type.Quantization, strings, &type.PropertyFlags);
+}
+
 void LocalPacketSerializer::StoreMetaData(FArchive * Archive, TMap<FString, FString> Meta)
 {
 	TArray<FString> keys;
@@ -298,36 +519,77 @@ void LocalPacketSerializer::StoreMetaData(FArchive * Archive, TMap<FString, FStr
 	}
 }
 
-PacketTypeIndex LocalPacketSerializer::RegisterPacketType(TSubclassOf<UAnalyticsPacket> type)
+const FLocalPacketType& LocalPacketSerializer::RegisterPacketType(UStruct* type)
 {
-	PacketTypeIndex register_class_type = 0;
-	*archive << register_class_type;	// Class registration packet id
-	*archive << next_packet_id;			// ID to register
-	FString name = type.Get()->GetName();
-	*archive << name;					// Classname to register
+	const FAnalyticsPacketPlan* plan = FAnalyticsPacketPlan::Get(type);
+	UScriptStruct* struct_type = Cast<UScriptStruct>(type);
+
+	FLocalPacketType* packet_type = new FLocalPacketType();
 
-	PacketPropertyCount property_count = 0;
+	schema_data.Reset();
+	FMemoryWriter schema_archive(schema_data);
 
-	for (TFieldIterator<UProperty> property_iterator(*type); property_iterator; ++property_iterator)
+	// Structs are registered by path, which can not collide with class names
+	FString name = struct_type != nullptr ? struct_type->GetPathName() : plan->Name;
+	FAnalyticsCaptureFormat::SerializeString(schema_archive, name);					// Classname to register
+
+	PacketPropertyCount property_count = plan->Properties.Num();
+	FAnalyticsCaptureFormat::SerializeVarInt(schema_archive, property_count);			// Amount of properties
+
+	for (const FAnalyticsPropertyPlan& property : plan->Properties)
 	{
-		property_count++;
+		FString prop_name = property.Name;
+		FString prop_type = property.Type;
+		float quantization = property.Quantization;
+		uint8 flags = property.GetFlags();
+		FAnalyticsCaptureFormat::SerializeString(schema_archive, prop_name);			// Property name
+		FAnalyticsCaptureFormat::SerializeString(schema_archive, prop_type);			// Property type
+		schema_archive << quantization;													// Quantization step
+		schema_archive << flags;														// Property flags
+
+		packet_type->Quantization.Add(quantization);
+		packet_type->PropertyFlags.Add(flags);
 	}
 
-	*archive << property_count;			// Amount of properties
+	uint32 schema_hash = FCrc::MemCrc32(schema_data.GetData(), schema_data.Num());
+	uint32 schema_size = schema_data.Num();
+
+	PacketTypeIndex register_class_type = 0;
+	FAnalyticsCaptureFormat::SerializeVarInt(*registration_archive, register_class_type);	// Class registration packet id
+	FAnalyticsCaptureFormat::SerializeVarInt(*registration_archive, next_packet_id);		// ID to register
+	*registration_archive << schema_hash;													// Schema hash
+	FAnalyticsCaptureFormat::SerializeVarInt(*registration_archive, schema_size);			// Schema size
+	registration_archive->Serialize(schema_data.GetData(), schema_size);					// Schema
+
+	packet_type->SchemaHash = schema_hash;
 
-	for (TFieldIterator<UProperty> property_iterator(*type); property_iterator; ++property_iterator)
+	packet_type->Index = next_packet_id;
+	packet_type->Class = Cast<UClass>(type);
+	packet_type->Struct = struct_type;
+	packet_type->Plan = plan;
+
+	if (UAnalyticsSettings::Get()->CriticalPackets.Contains(plan->Name))
 	{
-		UProperty* prop = *property_iterator;
-		FString prop_type = prop->GetCPPType();
-		FString prop_name = prop->GetNameCPP();
-		*archive << prop_name;				// Property name
-		*archive << prop_type;				// Property type
+		packet_type->Lane = EAnalyticsLane::Critical;
 	}
-
-	packet_types.Add(*type, next_packet_id);
-	PacketTypeIndex registered_id = next_packet_id;
+	else if (packet_type->Class != nullptr)
+	{
+		packet_type->Lane = packet_type->Class->GetDefaultObject<UAnalyticsPacket>()->Lane;
+	}
+#if STATS
+	packet_type->StatId = FDynamicStats::CreateStatId<FStatGroup_STATGROUP_DataWise>(FString(TEXT("Serialize ")) + plan->Name);
+#endif
 	next_packet_id++;
-	return registered_id;
+
+	if (chunk_writer != nullptr)
+	{
+		chunk_writer->WriteControl(registration_data.GetData(), registration_data.Num());
+		registration_data.Reset();
+		registration_archive->Seek(0);
+	}
+
+	packet_types.Add(type, packet_type);
+	return *packet_type;
 }
 
 
@@ -355,149 +617,470 @@ LocalPacketDeserializer::LocalPacketDeserializer(FArchive* archive_, UAnalyticsC
 
 }
 
-void LocalPacketDeserializer::Process()
+LocalPacketDeserializer::~LocalPacketDeserializer()
+{
+	delete stream_reader;
+}
+
+void LocalPacketDeserializer::Process(double start_time, double end_time)
+{
+	range_start = start_time;
+	range_end = end_time;
+
+	version = FAnalyticsCaptureFormat::ReadHeader(*archive);
+	if (version == 0) return;
+
+	if (version >= 3)
+	{
+		ProcessChunks();
+	}
+	else
+	{
+		ProcessRecords();
+	}
+
+	// Critical records are flushed in chunks of their own ahead of the bulk chunk, so order by time here
+	TArray<UAnalyticsPacket*>& packets = output->packets;
+	for (int32 packet_id = 1; packet_id < packets.Num(); packet_id++)
+	{
+		if (packets[packet_id]->PreciseTime < packets[packet_id - 1]->PreciseTime)
+		{
+			packets.StableSort([](const UAnalyticsPacket& a, const UAnalyticsPacket& b) { return a.PreciseTime < b.PreciseTime; });
+			break;
+		}
+	}
+}
+
+void LocalPacketDeserializer::LoadChunks(FAnalyticsChunkIndex& index, TArray<const FAnalyticsChunkInfo*>& chunks)
+{
+	bool indexed = index.Load(*archive);
+
+	if (!indexed)
+	{
+		UE_LOG(AnalyticsLog, Warning, TEXT("Capture has no chunk index, reading all chunks in order: %s"), output != nullptr ? *output->Name : TEXT(""));
+		index.Scan(*archive);
+	}
+
+	FArchive* capture_archive = archive;
+
+	// Registrations of chunks outside of the time range are needed as well, these are repeated in the index
+	if (indexed)
+	{
+		FMemoryReader registration_archive(index.Registrations);
+		archive = &registration_archive;
+
+		PacketTypeIndex packet_type;
+		while (archive->Tell() < archive->TotalSize() && !archive->IsError())
+		{
+			SerializeIndex(packet_type);
+			if (packet_type != 0) break;
+			RegisterPacketType();
+		}
+
+		archive = capture_archive;
+	}
+
+	chunks.Reset();
+	for (const FAnalyticsChunkInfo& chunk : index.Chunks)
+	{
+		if (indexed && (FAnalyticsCaptureFormat::ToSeconds(chunk.LastTimestamp) < range_start || FAnalyticsCaptureFormat::ToSeconds(chunk.FirstTimestamp) > range_end)) continue;
+		chunks.Add(&chunk);
+	}
+}
+
+void LocalPacketDeserializer::ProcessChunks()
+{
+	FAnalyticsChunkIndex index;
+	TArray<const FAnalyticsChunkInfo*> chunks;
+	LoadChunks(index, chunks);
+
+	FArchive* capture_archive = archive;
+
+	// Chunks are decompressed in parallel in batches to bound memory use, packets are created in order on this thread
+	const int32 batch_size = 16;
+	TArray<FAnalyticsFrameHeader> headers;
+	TArray<TArray<uint8>> stored;
+	TArray<TArray<uint8>> raw;
+	TArray<bool> valid;
+
+	for (int32 batch_start = 0; batch_start < chunks.Num(); batch_start += batch_size)
+	{
+		int32 count = FMath::Min(batch_size, chunks.Num() - batch_start);
+		headers.SetNum(count);
+		stored.SetNum(count);
+		raw.SetNum(count);
+		valid.Init(false, count);
+
+		for (int32 i = 0; i < count; i++)
+		{
+			valid[i] = FAnalyticsChunkIndex::ReadChunk(*capture_archive, *chunks[batch_start + i], headers[i], stored[i]);
+		}
+
+		ParallelFor(count, [&](int32 i)
+		{
+			if (valid[i]) valid[i] = FAnalyticsChunkIndex::Decompress(headers[i], stored[i], raw[i]);
+		});
+
+		for (int32 i = 0; i < count; i++)
+		{
+			if (!valid[i])
+			{
+				UE_LOG(AnalyticsLog, Error, TEXT("Chunk at %lld is corrupted and skipped"), chunks[batch_start + i]->Offset);
+				continue;
+			}
+
+			// Records of a chunk are read through the same path as an unchunked capture
+			FMemoryReader chunk_archive(raw[i]);
+			archive = &chunk_archive;
+			last_timestamp = 0;
+			predictor.Reset();
+			ProcessRecords();
+			archive = capture_archive;
+		}
+	}
+}
+
+bool LocalPacketDeserializer::ReadRecord(FLocalPacketType*& type)
 {
 	PacketTypeIndex packet_type;
 
-	while (archive->Tell() < archive->TotalSize() - 1)
+	while (archive->Tell() < archive->TotalSize() - 1 && !archive->IsError())
 	{
-		*archive << packet_type;
+		SerializeIndex(packet_type);
 
 		if (packet_type == 0) { RegisterPacketType(); continue; }
 
-		UClass** type_ptr = packet_types.Find(packet_type);
+		if (version >= 2)
+		{
+			int64 time_delta;
+			FAnalyticsCaptureFormat::SerializeZigZag(*archive, time_delta);
+			last_timestamp += time_delta;
+		}
+
+		type = packet_types.Find(packet_type);
 
-		if(type_ptr==nullptr)
+		if (type == nullptr)
 		{
 			UE_LOG(AnalyticsLog, Error, TEXT("Packet type not found: %i"), packet_type);
+			return false;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+bool LocalPacketDeserializer::ReadPacket(const FLocalPacketType& type, UAnalyticsPacket* packet)
+{
+	void* container = packet;
+	if (type.Struct != nullptr) container = static_cast<UAnalyticsStructPacket*>(packet)->GetData();
+
+	if (version == 1)
+	{
+		type.Plan->Serialize(*archive, container);
+		if (type.Struct != nullptr) *archive << packet->Time;
+		packet->PreciseTime = packet->Time;
+	}
+	else
+	{
+		type.Plan->SerializeCompact(*archive, container, type.Quantization, version >= 6 ? &strings : nullptr, &type.PropertyFlags, &predictor, type.Index);
+		packet->PreciseTime = FAnalyticsCaptureFormat::ToSeconds(last_timestamp);
+		packet->Time = (uint32)packet->PreciseTime;
+	}
+
+	return !archive->IsError();
+}
+
+void LocalPacketDeserializer::ProcessRecords()
+{
+	FLocalPacketType* type_ptr;
+
+	while (ReadRecord(type_ptr))
+	{
+		UAnalyticsPacket* packet;
+
+		if (type_ptr->Struct != nullptr)
+		{
+			UAnalyticsStructPacket* struct_packet = NewObject<UAnalyticsStructPacket>(output);
+			struct_packet->Initialize(type_ptr->Struct);
+			packet = struct_packet;
+		}
+		else
+		{
+			packet = NewObject<UAnalyticsPacket>(output, type_ptr->Class);
+		}
+
+		// The last record of a capture that was not closed can be incomplete
+		if (!ReadPacket(*type_ptr, packet))
+		{
+			UE_LOG(AnalyticsLog, Warning, TEXT("Discarded incomplete record at the end of %s"), *output->Name);
 			return;
 		}
 
-		UClass* class_type = *type_ptr;
-		UAnalyticsPacket* packet = NewObject<UAnalyticsPacket>(output, class_type);
+		if (packet->PreciseTime < range_start || packet->PreciseTime > range_end) continue;
+
 		output->packets.Add(packet);
+	}
+}
+
+bool LocalPacketDeserializer::BeginStream(double start_time, double end_time)
+{
+	range_start = start_time;
+	range_end = end_time;
+
+	version = FAnalyticsCaptureFormat::ReadHeader(*archive);
+	if (version == 0) return false;
+
+	// Records of unchunked captures follow the header
+	if (version < 3) return true;
 
-		for (TFieldIterator<UProperty> property_iterator(class_type); property_iterator; ++property_iterator)
+	stream_archive = archive;
+	LoadChunks(stream_index, stream_chunks);
+	stream_next_chunk = 0;
+	return true;
+}
+
+bool LocalPacketDeserializer::NextRecord(const FLocalPacketType*& type)
+{
+	FLocalPacketType* found;
+
+	if (stream_archive == nullptr)
+	{
+		if (!ReadRecord(found)) return false;
+		type = found;
+		return true;
+	}
+
+	while (true)
+	{
+		if (stream_reader != nullptr && ReadRecord(found))
 		{
-			UProperty* prop = *property_iterator;
-			FString type = prop->GetCPPType();
-			FString name = prop->GetNameCPP();
+			type = found;
+			return true;
+		}
 
-			if (type.Equals("FString")) {
-				FString* data = prop->ContainerPtrToValuePtr<FString>(packet);
-				*archive << *data;
-			}
-			else if (type.Equals("FVector")) {
-				FVector* data = prop->ContainerPtrToValuePtr<FVector>(packet);
-				*archive << *data;
-			}
-			else if (type.Equals("int32")) {
-				int32* data = prop->ContainerPtrToValuePtr<int32>(packet);
-				*archive << *data;
-			}
-			else if (type.Equals("uint32")) {
-				uint32* data = prop->ContainerPtrToValuePtr<uint32>(packet);
-				*archive << *data;
-			}
-			else if (type.Equals("uint8")) {
-				uint8* data = prop->ContainerPtrToValuePtr<uint8>(packet);
-				*archive << *data;
-			}
-			else if (type.Equals("bool")) {
-				bool* data = prop->ContainerPtrToValuePtr<bool>(packet);
-				*archive << *data;
-			}
-			else if (type.Equals("float")) {
-				float* data = prop->ContainerPtrToValuePtr<float>(packet);
-				*archive << *data;
-			}
-			else if (type.Equals("FVector2D")) {
-				FVector2D* data = prop->ContainerPtrToValuePtr<FVector2D>(packet);
-				*archive << *data;
-			}
-			else
-			{
-				UE_LOG(AnalyticsLog, Error, TEXT("Unsupported property type: %s (%s)"), *type, *name); break;
-			}
+		archive = stream_archive;
+		if (stream_next_chunk >= stream_chunks.Num()) return false;
+
+		const FAnalyticsChunkInfo* chunk = stream_chunks[stream_next_chunk++];
+
+		FAnalyticsFrameHeader header;
+		if (!FAnalyticsChunkIndex::ReadChunk(*stream_archive, *chunk, header, stream_stored) || !FAnalyticsChunkIndex::Decompress(header, stream_stored, stream_raw))
+		{
+			UE_LOG(AnalyticsLog, Error, TEXT("Chunk at %lld is corrupted and skipped"), chunk->Offset);
+			continue;
 		}
+
+		delete stream_reader;
+		stream_reader = new FMemoryReader(stream_raw);
+		archive = stream_reader;
+		last_timestamp = 0;
+		predictor.Reset();
 	}
 }
 
 void LocalPacketDeserializer::RegisterPacketType()
 {
 	PacketTypeIndex register_id;
-	*archive << register_id;
-	
-	if(packet_types.Find(register_id) != nullptr)
+	SerializeIndex(register_id);
+
+	// Registration 0 defines a string of the capture instead of a packet type
+	if (version >= 6 && register_id == 0)
 	{
-		UE_LOG(AnalyticsLog, Error, TEXT("Packet type already exists! index: %i"), register_id);
+		strings.ReadDefinition(*archive);
 		return;
 	}
 
-	FString class_name;
-	*archive << class_name;
+	FLocalPacketType packet_type;
 
-	TArray<UClass*> possible_classes = UClassFinder::FindSubclasses(UAnalyticsPacket::StaticClass());
+	if (version < 4)
+	{
+		// Chunked captures repeat their registrations in the index
+		bool known = packet_types.Find(register_id) != nullptr;
+		if (known && version < 3) UE_LOG(AnalyticsLog, Error, TEXT("Packet type already exists! index: %i"), register_id);
 
-	UClass* found_class = nullptr;
+		if (!ReadSchema(packet_type, !known)) return;
 
-	for(UClass* possible_class : possible_classes)
-	{
-		if (possible_class->GetName().Equals(class_name)) { found_class = possible_class; break; }
+		packet_type.Index = register_id;
+		packet_types.Add(register_id, packet_type);
+		return;
 	}
 
-	if(found_class == nullptr)
+	uint32 schema_hash;
+	uint32 schema_size;
+	*archive << schema_hash;
+	FAnalyticsCaptureFormat::SerializeVarInt(*archive, schema_size);
+
+	if (archive->IsError() || schema_size > archive->TotalSize() - archive->Tell())
 	{
-		UE_LOG(AnalyticsLog, Error, TEXT("No matching class found! name: %s"), *class_name);
+		archive->SetError();
 		return;
 	}
 
+	schema_data.SetNumUninitialized(schema_size);
+	archive->Serialize(schema_data.GetData(), schema_size);
+
+	if (archive->IsError() || packet_types.Find(register_id) != nullptr) return;
+
+	// Schemas resolved by earlier captures are reused without looking up and validating the type again
+	if (!FAnalyticsSchemaCatalog::Find(schema_hash, schema_data, packet_type))
+	{
+		if (FAnalyticsSchemaCatalog::IsUnresolved(schema_hash, schema_data)) return;
+
+		// Taken before the lookup, so a change to the class finder cache while it runs is not missed
+		int32 generation = UClassFinder::GetCacheGeneration();
+
+		FArchive* record_archive = archive;
+		FMemoryReader schema_archive(schema_data);
+		archive = &schema_archive;
+		bool resolved = ReadSchema(packet_type, true);
+		archive = record_archive;
+
+		if (!resolved)
+		{
+			FAnalyticsSchemaCatalog::AddUnresolved(schema_hash, schema_data, generation);
+			return;
+		}
+
+		FAnalyticsSchemaCatalog::Add(schema_hash, schema_data, packet_type);
+	}
+
+	packet_type.Index = register_id;
+	packet_types.Add(register_id, packet_type);
+}
+
+bool LocalPacketDeserializer::ReadSchema(FLocalPacketType& packet_type, bool resolve)
+{
+	FString class_name;
+	SerializeString(class_name);
+
 	PacketPropertyCount property_count;
-	*archive << property_count;
+	SerializeIndex(property_count);
 
 	TArray<FString> property_names;
 	TArray<FString> property_types;
 
-	for (PacketPropertyCount i = 0; i < property_count; i++)
+	for (PacketPropertyCount i = 0; i < property_count && !archive->IsError(); i++)
 	{
 		FString name;
 		FString type;
-		*archive << name;
-		*archive << type;
+		SerializeString(name);
+		SerializeString(type);
 
 		property_names.Add(name);
 		property_types.Add(type);
+
+		if (version >= 2)
+		{
+			float quantization;
+			*archive << quantization;
+			packet_type.Quantization.Add(quantization);
+		}
+
+		if (version >= 5)
+		{
+			uint8 flags;
+			*archive << flags;
+			packet_type.PropertyFlags.Add(flags);
+		}
 	}
 
-	uint32 property_id = 0;
-	for (TFieldIterator<UProperty> property_iterator(found_class); property_iterator; ++property_iterator)
+	if (archive->IsError() || !resolve) return false;
+
+	if (class_name.StartsWith("/"))
 	{
-		UProperty* prop = *property_iterator;
-		FString type = prop->GetCPPType();
-		FString name = prop->GetNameCPP();
+		UScriptStruct* found_struct = FindObject<UScriptStruct>(nullptr, *class_name);
+
+		if (found_struct == nullptr)
+		{
+			UE_LOG(AnalyticsLog, Error, TEXT("No matching struct found! name: %s"), *class_name);
+			return false;
+		}
+
+		// Version 1 stores the time of a struct packet after its properties
+		if (version == 1)
+		{
+			if (property_names.Num() == 0 || !property_names.Last().Equals("Time"))
+			{
+				UE_LOG(AnalyticsLog, Error, TEXT("Struct packet has no time! name: %s"), *class_name);
+				return false;
+			}
+
+			property_names.Pop();
+			property_types.Pop();
+		}
+
+		packet_type.Struct = found_struct;
+		packet_type.Plan = FAnalyticsPacketPlan::Get(found_struct);
+	}
+	else
+	{
+		// Resolved signatures are kept by the schema catalog, this only runs for schemas that are new to the process
+		packet_type.Class = UClassFinder::FindSubclassByName(UAnalyticsPacket::StaticClass(), class_name);
+
+		if(packet_type.Class == nullptr)
+		{
+			UE_LOG(AnalyticsLog, Error, TEXT("No matching class found! name: %s"), *class_name);
+			return false;
+		}
+
+		packet_type.Plan = FAnalyticsPacketPlan::Get(packet_type.Class);
+	}
+
+	return ValidateProperties(class_name, packet_type.Plan, property_names, property_types);
+}
+
+bool LocalPacketDeserializer::ValidateProperties(const FString& class_name, const FAnalyticsPacketPlan* plan, const TArray<FString>& property_names, const TArray<FString>& property_types)
+{
+	for (int32 property_id = 0; property_id < plan->Properties.Num(); property_id++)
+	{
+		const FString& type = plan->Properties[property_id].Type;
+		const FString& name = plan->Properties[property_id].Name;
 
 		if (property_names.IsValidIndex(property_id)) 
 		{
-			if (!name.ToLower().Equals(property_names[property_id].ToLower()) || !type.ToLower().Equals(property_types[property_id].ToLower()))
+			if (!name.Equals(property_names[property_id], ESearchCase::IgnoreCase) || !type.Equals(property_types[property_id], ESearchCase::IgnoreCase))
 			{
 				UE_LOG(AnalyticsLog, Error, TEXT("Property does not match signature! Class: %s (%s), Capture: %s (%s)"), *name, *type, *property_names[property_id], *property_types[property_id]); 
-				return;
+				return false;
 			}
 		} else
 		{
-			UE_LOG(AnalyticsLog, Error, TEXT("Class has more properties than registered"), *class_name); 
-			return;
+			UE_LOG(AnalyticsLog, Error, TEXT("Class has more properties than registered! name: %s"), *class_name); 
+			return false;
 		}
-
-		property_id++;
 	}
 
-	if (property_id != property_names.Num())
+	if (plan->Properties.Num() != property_names.Num())
 	{
-		UE_LOG(AnalyticsLog, Error, TEXT("Class has less properties than registered!"), *class_name);
-		return;
+		UE_LOG(AnalyticsLog, Error, TEXT("Class has less properties than registered! name: %s"), *class_name);
+		return false;
 	}
 
-	packet_types.Add(register_id, found_class);
+	return true;
+}
+
+void LocalPacketDeserializer::SerializeIndex(uint32& value)
+{
+	if (version == 1)
+	{
+		*archive << value;
+	}
+	else
+	{
+		FAnalyticsCaptureFormat::SerializeVarInt(*archive, value);
+	}
 }
 
+void LocalPacketDeserializer::SerializeString(FString& value)
+{
+	if (version == 1)
+	{
+		*archive << value;
+	}
+	else
+	{
+		FAnalyticsCaptureFormat::SerializeString(*archive, value);
+	}
+}
@@ -1,2 +1,28 @@
 #include "AnalyticsPacket.h"
 #include "DataWise.h"
+
+void UAnalyticsStructPacket::Initialize(UScriptStruct* type)
+{
+	Release();
+
+	Struct = type;
+	if (Struct == nullptr) return;
+
+	data = FMemory::Malloc(FMath::Max(Struct->GetStructureSize(), 1), Struct->GetMinAlignment());
+	Struct->InitializeStruct(data);
+}
+
+void UAnalyticsStructPacket::BeginDestroy()
+{
+	Release();
+	Super::BeginDestroy();
+}
+
+void UAnalyticsStructPacket::Release()
+{
+	if (data == nullptr) return;
+
+	Struct->DestroyStruct(data);
+	FMemory::Free(data);
+	data = nullptr;
+}
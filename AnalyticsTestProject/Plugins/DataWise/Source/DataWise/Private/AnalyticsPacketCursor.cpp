@@ -0,0 +1,139 @@
+#include "AnalyticsPacketCursor.h"
+#include "DataWise.h"
+#include "AnalyticsLocalCaptureManager.h"
+#include "AnalyticsCaptureManager.h"
+
+FAnalyticsPacketCursor::FAnalyticsPacketCursor(const FString& name_, const TArray<FArchive*>& archives_, double start_time, double end_time) : name(name_), archives(archives_), range_start(start_time), range_end(end_time)
+{
+
+}
+
+FAnalyticsPacketCursor::~FAnalyticsPacketCursor()
+{
+	delete deserializer;
+
+	for (FArchive* archive : archives)
+	{
+		archive->Close();
+		delete archive;
+	}
+}
+
+bool FAnalyticsPacketCursor::Next()
+{
+	packet = nullptr;
+
+	while (true)
+	{
+		if (deserializer == nullptr)
+		{
+			if (archive_index + 1 >= archives.Num()) return false;
+			archive_index++;
+
+			deserializer = new LocalPacketDeserializer(archives[archive_index], nullptr);
+			if (!deserializer->BeginStream(range_start, range_end))
+			{
+				delete deserializer;
+				deserializer = nullptr;
+			}
+			continue;
+		}
+
+		const FLocalPacketType* type;
+		if (!deserializer->NextRecord(type))
+		{
+			delete deserializer;
+			deserializer = nullptr;
+			continue;
+		}
+
+		UAnalyticsPacket* view = GetView(*type);
+
+		// The rest of the chunk is skipped, the next record is read from the chunk after it
+		if (!deserializer->ReadPacket(*type, view))
+		{
+			UE_LOG(AnalyticsLog, Warning, TEXT("Discarded incomplete record of %s"), *name);
+			continue;
+		}
+
+		if (view->PreciseTime < range_start || view->PreciseTime > range_end) continue;
+
+		packet = view;
+		return true;
+	}
+}
+
+UAnalyticsPacket* FAnalyticsPacketCursor::GetView(const FLocalPacketType& type)
+{
+	UStruct* key = type.Struct != nullptr ? static_cast<UStruct*>(type.Struct) : static_cast<UStruct*>(type.Class);
+
+	UAnalyticsPacket** existing = views.Find(key);
+	if (existing != nullptr) return *existing;
+
+	UAnalyticsPacket* view;
+	if (type.Struct != nullptr)
+	{
+		UAnalyticsStructPacket* struct_packet = NewObject<UAnalyticsStructPacket>(GetTransientPackage());
+		struct_packet->Initialize(type.Struct);
+		view = struct_packet;
+	}
+	else
+	{
+		view = NewObject<UAnalyticsPacket>(GetTransientPackage(), type.Class);
+	}
+
+	views.Add(key, view);
+	return view;
+}
+
+void FAnalyticsPacketCursor::AddReferencedObjects(FReferenceCollector& collector)
+{
+	for (TPair<UStruct*, UAnalyticsPacket*>& view : views)
+	{
+		collector.AddReferencedObject(view.Value);
+	}
+}
+
+
+
+UAnalyticsPacketCursor* UAnalyticsPacketCursor::OpenCapture(FAnalyticsCaptureInfo Capture)
+{
+	return OpenCaptureRange(Capture, 0.0f, TNumericLimits<float>::Max());
+}
+
+UAnalyticsPacketCursor* UAnalyticsPacketCursor::OpenCaptureRange(FAnalyticsCaptureInfo Capture, float StartTime, float EndTime)
+{
+	UAnalyticsCaptureManager* manager = Capture.Source.IsValid() ? Capture.Source->GetManager() : UAnalyticsLocalCaptureManager::GetLocalCaptureManager();
+	FAnalyticsPacketCursor* cursor = manager != nullptr ? manager->OpenCursor(Capture, StartTime, EndTime) : nullptr;
+
+	if (cursor == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Capture can not be streamed: %s"), *Capture.Name);
+		return nullptr;
+	}
+
+	UAnalyticsPacketCursor* result = NewObject<UAnalyticsPacketCursor>();
+	result->cursor = cursor;
+	return result;
+}
+
+bool UAnalyticsPacketCursor::Next(UAnalyticsPacket*& Packet)
+{
+	Packet = nullptr;
+	if (cursor == nullptr || !cursor->Next()) return false;
+
+	Packet = cursor->GetPacket();
+	return true;
+}
+
+void UAnalyticsPacketCursor::Close()
+{
+	delete cursor;
+	cursor = nullptr;
+}
+
+void UAnalyticsPacketCursor::BeginDestroy()
+{
+	Close();
+	Super::BeginDestroy();
+}
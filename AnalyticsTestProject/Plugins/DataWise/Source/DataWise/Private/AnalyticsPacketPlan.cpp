@@ -0,0 +1,709 @@
+#include "AnalyticsPacketPlan.h"
+#include "DataWise.h"
+#include "AnalyticsCaptureFormat.h"
+#include "AnalyticsStringTable.h"
+#include "AnalyticsPacket.h"
+#include "AnalyticsSettings.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/Crc.h"
+
+#define max_fixed_packet_size 4096
+
+// Quantized values are clamped to this many steps, which leaves room to add and subtract them without overflowing
+#define max_quantized_steps ((int64)1 << 60)
+
+static FCriticalSection plan_mutex;
+static TMap<UStruct*, FAnalyticsPacketPlan*> compiled_plans;
+
+const FAnalyticsPacketPlan* FAnalyticsPacketPlan::Get(UStruct* type)
+{
+	if (type == nullptr) return nullptr;
+
+	FScopeLock lock(&plan_mutex);
+
+	FAnalyticsPacketPlan** found = compiled_plans.Find(type);
+	if (found != nullptr && (*found)->Type.Get() == type)
+	{
+		return *found;
+	}
+
+	// A stale plan belongs to a type that has been destroyed and may still be referenced by an open serializer, so it is not freed
+	FAnalyticsPacketPlan* plan = Compile(type);
+	compiled_plans.Add(type, plan);
+	return plan;
+}
+
+float FAnalyticsPacketPlan::GetMetaStep(UField* field, const TCHAR* meta_name)
+{
+#if WITH_EDITOR
+	// UPROPERTY(meta = (Quantize = "0.1")), meta data is not available in packaged builds
+	if (field->HasMetaData(meta_name))
+	{
+		return FMath::Max(FCString::Atof(*field->GetMetaData(meta_name)), 0.0f);
+	}
+#endif
+
+	return 0.0f;
+}
+
+float FAnalyticsPacketPlan::GetQuantization(UStruct* type, UProperty* property, const TCHAR* meta_name)
+{
+	float quantization = GetMetaStep(property, meta_name);
+
+	const float* configured = UAnalyticsSettings::Get()->QuantizedProperties.Find(type->GetName() + "." + property->GetName());
+	if (configured != nullptr) quantization = *configured;
+
+	return FMath::Max(quantization, 0.0f);
+}
+
+EAnalyticsPropertyCodec FAnalyticsPacketPlan::GetCodec(UProperty* property, int32& size)
+{
+	size = 0;
+
+	if (property->IsA<UStrProperty>())
+	{
+		return EAnalyticsPropertyCodec::String;
+	}
+
+	if (UStructProperty* struct_property = Cast<UStructProperty>(property))
+	{
+		if (struct_property->Struct == TBaseStructure<FVector>::Get())
+		{
+			size = sizeof(FVector);
+			return EAnalyticsPropertyCodec::Vector;
+		}
+
+		if (struct_property->Struct == TBaseStructure<FVector2D>::Get())
+		{
+			size = sizeof(FVector2D);
+			return EAnalyticsPropertyCodec::Vector2D;
+		}
+
+		return EAnalyticsPropertyCodec::Unsupported;
+	}
+
+	if (property->IsA<UIntProperty>())
+	{
+		size = sizeof(int32);
+		return EAnalyticsPropertyCodec::Int32;
+	}
+
+	if (property->IsA<UUInt32Property>())
+	{
+		size = sizeof(uint32);
+		return EAnalyticsPropertyCodec::UInt32;
+	}
+
+	if (UByteProperty* byte_property = Cast<UByteProperty>(property))
+	{
+		if (byte_property->Enum != nullptr) return EAnalyticsPropertyCodec::Unsupported;
+
+		size = sizeof(uint8);
+		return EAnalyticsPropertyCodec::UInt8;
+	}
+
+	if (property->IsA<UBoolProperty>())
+	{
+		size = sizeof(uint32);
+		return EAnalyticsPropertyCodec::Bool;
+	}
+
+	if (property->IsA<UFloatProperty>())
+	{
+		size = sizeof(float);
+		return EAnalyticsPropertyCodec::Float;
+	}
+
+	// Arrays of numbers, used by summary packets for buckets and cells, and paths of points
+	if (UArrayProperty* array_property = Cast<UArrayProperty>(property))
+	{
+		if (array_property->Inner->IsA<UIntProperty>()) return EAnalyticsPropertyCodec::Int32Array;
+		if (array_property->Inner->IsA<UFloatProperty>()) return EAnalyticsPropertyCodec::FloatArray;
+
+		UStructProperty* inner_struct = Cast<UStructProperty>(array_property->Inner);
+		if (inner_struct != nullptr && inner_struct->Struct == TBaseStructure<FVector>::Get()) return EAnalyticsPropertyCodec::VectorArray;
+
+		return EAnalyticsPropertyCodec::Unsupported;
+	}
+
+	return EAnalyticsPropertyCodec::Unsupported;
+}
+
+FAnalyticsPacketPlan* FAnalyticsPacketPlan::Compile(UStruct* type)
+{
+	FAnalyticsPacketPlan* plan = new FAnalyticsPacketPlan();
+	plan->Type = type;
+	plan->Name = type->GetName();
+	plan->bFixedSize = true;
+
+	UProperty* time_property = UAnalyticsPacket::StaticClass()->FindPropertyByName(GET_MEMBER_NAME_CHECKED(UAnalyticsPacket, Time));
+	UProperty* sampling_property = UAnalyticsPacket::StaticClass()->FindPropertyByName(GET_MEMBER_NAME_CHECKED(UAnalyticsPacket, SamplingPolicy));
+	UProperty* lane_property = UAnalyticsPacket::StaticClass()->FindPropertyByName(GET_MEMBER_NAME_CHECKED(UAnalyticsPacket, Lane));
+
+	// UCLASS(meta = (Trajectory = "1.0", TrajectoryKey = "PlayerId")) predicts every plain vector of the class across records
+	float class_trajectory = GetMetaStep(type, TEXT("Trajectory"));
+	FName trajectory_key;
+#if WITH_EDITOR
+	if (type->HasMetaData(TEXT("TrajectoryKey"))) trajectory_key = FName(*type->GetMetaData(TEXT("TrajectoryKey")));
+#endif
+
+	const FAnalyticsTrajectoryPacket* configured_trajectory = UAnalyticsSettings::Get()->TrajectoryPackets.Find(plan->Name);
+	if (configured_trajectory != nullptr)
+	{
+		class_trajectory = FMath::Max(configured_trajectory->Step, 0.0f);
+		trajectory_key = configured_trajectory->KeyProperty;
+	}
+
+	bool predicted = false;
+
+	for (TFieldIterator<UProperty> property_iterator(type); property_iterator; ++property_iterator)
+	{
+		UProperty* prop = *property_iterator;
+		if (prop == sampling_property || prop == lane_property) continue;
+
+		FAnalyticsPropertyPlan property;
+		property.Property = prop;
+		property.Name = prop->GetNameCPP();
+		property.Type = prop->GetCPPType();
+		property.Offset = prop->GetOffset_ForInternal();
+		property.Codec = GetCodec(prop, property.Size);
+		property.bIsTime = prop == time_property;
+
+		if (property.Codec == EAnalyticsPropertyCodec::Int32Array || property.Codec == EAnalyticsPropertyCodec::FloatArray || property.Codec == EAnalyticsPropertyCodec::VectorArray)
+		{
+			// The element type is part of the schema, so TArray<int32> and TArray<float> do not match each other
+			FString element_type;
+			property.Type = prop->GetCPPType(&element_type) + element_type;
+		}
+
+		if (property.Codec == EAnalyticsPropertyCodec::Vector || property.Codec == EAnalyticsPropertyCodec::Vector2D)
+		{
+			property.Quantization = GetQuantization(type, prop, TEXT("Quantize"));
+		}
+
+		// UPROPERTY(meta = (Trajectory = "1.0")) on a plain FVector that is reported over and over, like the location of a player
+		if (property.Codec == EAnalyticsPropertyCodec::Vector)
+		{
+			float trajectory = GetMetaStep(prop, TEXT("Trajectory"));
+			if (trajectory <= 0.0f) trajectory = class_trajectory;
+
+			if (trajectory > 0.0f)
+			{
+				if (property.Quantization <= 0.0f) property.Quantization = trajectory;
+				property.bPredicted = true;
+				predicted = true;
+			}
+		}
+
+		// UPROPERTY(meta = (Trajectory = "1.0")) on a TArray<FVector> of points along a path
+		if (property.Codec == EAnalyticsPropertyCodec::VectorArray)
+		{
+			property.Quantization = GetQuantization(type, prop, TEXT("Trajectory"));
+		}
+
+		if (property.Codec == EAnalyticsPropertyCodec::Unsupported)
+		{
+			UE_LOG(AnalyticsLog, Error, TEXT("Unsupported property type: %s (%s)"), *property.Type, *property.Name);
+		}
+		else if (property.Size == 0)
+		{
+			plan->bFixedSize = false;
+		}
+
+		plan->Properties.Add(property);
+	}
+
+	if (predicted && trajectory_key != NAME_None)
+	{
+		FAnalyticsPropertyPlan* key = plan->Properties.FindByPredicate([&](const FAnalyticsPropertyPlan& property) { return property.Property->GetFName() == trajectory_key; });
+
+		if (key != nullptr && (key->Codec == EAnalyticsPropertyCodec::Int32 || key->Codec == EAnalyticsPropertyCodec::UInt32 || key->Codec == EAnalyticsPropertyCodec::String))
+		{
+			key->bIsPredictionKey = true;
+		}
+		else
+		{
+			UE_LOG(AnalyticsLog, Warning, TEXT("Trajectory key %s of %s is not an int or string property, its packets are predicted as one"), *trajectory_key.ToString(), *plan->Name);
+		}
+	}
+
+	if (plan->bFixedSize)
+	{
+		for (const FAnalyticsPropertyPlan& property : plan->Properties)
+		{
+			if (property.Codec == EAnalyticsPropertyCodec::Unsupported) continue;
+
+			plan->FixedSize += property.Size;
+
+			if (property.Codec == EAnalyticsPropertyCodec::Bool)
+			{
+				FAnalyticsCopyRun run;
+				run.Offset = property.Offset;
+				run.Size = property.Size;
+				run.BoolProperty = Cast<UBoolProperty>(property.Property);
+				plan->Runs.Add(run);
+				continue;
+			}
+
+			// Merge properties that are laid out back to back in memory into a single copy
+			if (plan->Runs.Num() != 0)
+			{
+				FAnalyticsCopyRun& previous = plan->Runs.Last();
+				if (previous.BoolProperty == nullptr && previous.Offset + previous.Size == property.Offset)
+				{
+					previous.Size += property.Size;
+					continue;
+				}
+			}
+
+			FAnalyticsCopyRun run;
+			run.Offset = property.Offset;
+			run.Size = property.Size;
+			plan->Runs.Add(run);
+		}
+
+		if (plan->FixedSize > max_fixed_packet_size) plan->bFixedSize = false;
+	}
+
+	return plan;
+}
+
+void FAnalyticsPacketPlan::Serialize(FArchive& archive, void* container) const
+{
+	if (bFixedSize && !archive.IsByteSwapping())
+	{
+		SerializeFixedSize(archive, container);
+	}
+	else
+	{
+		SerializeProperties(archive, container);
+	}
+}
+
+const FAnalyticsPropertyPlan* FAnalyticsPacketPlan::FindProperty(FName name) const
+{
+	for (const FAnalyticsPropertyPlan& property : Properties)
+	{
+		if (property.Property->GetFName() == name) return &property;
+	}
+
+	return nullptr;
+}
+
+void FAnalyticsPacketPlan::SerializeProperties(FArchive& archive, void* container) const
+{
+	for (const FAnalyticsPropertyPlan& property : Properties)
+	{
+		void* value = static_cast<uint8*>(container) + property.Offset;
+
+		switch (property.Codec)
+		{
+		case EAnalyticsPropertyCodec::String:
+			archive << *static_cast<FString*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::Vector:
+			archive << *static_cast<FVector*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::Int32:
+			archive << *static_cast<int32*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::UInt32:
+			archive << *static_cast<uint32*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::UInt8:
+			archive << *static_cast<uint8*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::Bool:
+		{
+			UBoolProperty* bool_property = static_cast<UBoolProperty*>(property.Property);
+			bool data = bool_property->GetPropertyValue(value);
+			archive << data;
+			if (archive.IsLoading()) bool_property->SetPropertyValue(value, data);
+			break;
+		}
+
+		case EAnalyticsPropertyCodec::Float:
+			archive << *static_cast<float*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::Vector2D:
+			archive << *static_cast<FVector2D*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::Int32Array:
+			archive << *static_cast<TArray<int32>*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::FloatArray:
+			archive << *static_cast<TArray<float>*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::VectorArray:
+			archive << *static_cast<TArray<FVector>*>(value);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+static volatile int32 non_finite_reported = 0;
+
+// Converting NaN, infinity or anything out of the range of int64 to an integer is undefined, so they are stored as 0 or clamped
+static int64 Quantize(float value, float quantization)
+{
+	if (!FMath::IsFinite(value))
+	{
+		if (FPlatformAtomics::InterlockedExchange(&non_finite_reported, 1) == 0) UE_LOG(AnalyticsLog, Warning, TEXT("Quantized properties that are not finite are stored as 0"));
+		return 0;
+	}
+
+	double steps = FMath::FloorToDouble((double)value / quantization + 0.5);
+	return (int64)FMath::Clamp(steps, -(double)max_quantized_steps, (double)max_quantized_steps);
+}
+
+static void SerializeQuantized(FArchive& archive, float& value, float quantization)
+{
+	int64 steps = archive.IsLoading() ? 0 : Quantize(value, quantization);
+	FAnalyticsCaptureFormat::SerializeZigZag(archive, steps);
+	if (archive.IsLoading()) value = steps * quantization;
+}
+
+// Points are rounded to steps of quantization and stored as the residual against a linear prediction from the two points before,
+// which is close to zero for anything that moves at a steady velocity. The prediction starts over in every record, so each record
+// decodes on its own regardless of which records were sampled out, dropped or skipped by a time range.
+static void SerializeTrajectory(FArchive& archive, TArray<FVector>& points, float quantization)
+{
+	uint32 count = points.Num();
+	FAnalyticsCaptureFormat::SerializeVarInt(archive, count);
+	if (archive.IsLoading())
+	{
+		// Every coordinate takes at least a byte, a larger count comes from a corrupted record
+		if (count > (archive.TotalSize() - archive.Tell()) / 3) { archive.SetError(); return; }
+		points.SetNumUninitialized(count);
+	}
+
+	if (quantization <= 0.0f)
+	{
+		for (FVector& point : points)
+		{
+			archive << point;
+		}
+		return;
+	}
+
+	int64 previous[3] = { 0, 0, 0 };
+	int64 before[3] = { 0, 0, 0 };
+
+	for (int32 point_id = 0; point_id < points.Num(); point_id++)
+	{
+		for (int32 axis = 0; axis < 3; axis++)
+		{
+			int64 predicted = point_id == 0 ? 0 : (point_id == 1 ? previous[axis] : 2 * previous[axis] - before[axis]);
+
+			int64 steps = archive.IsLoading() ? 0 : Quantize(points[point_id][axis], quantization);
+			int64 residual = steps - predicted;
+			FAnalyticsCaptureFormat::SerializeZigZag(archive, residual);
+
+			if (archive.IsLoading())
+			{
+				steps = predicted + residual;
+				points[point_id][axis] = steps * quantization;
+			}
+
+			before[axis] = previous[axis];
+			previous[axis] = steps;
+		}
+	}
+}
+
+static uint32 GetPredictionKey(const FAnalyticsPropertyPlan& property, const void* container)
+{
+	const void* value = static_cast<const uint8*>(container) + property.Offset;
+
+	switch (property.Codec)
+	{
+	case EAnalyticsPropertyCodec::Int32:
+	case EAnalyticsPropertyCodec::UInt32:
+		return *static_cast<const uint32*>(value);
+
+	case EAnalyticsPropertyCodec::String:
+		return FCrc::StrCrc32(**static_cast<const FString*>(value));
+
+	default:
+		return 0;
+	}
+}
+
+void FAnalyticsPacketPlan::SerializeCompact(FArchive& archive, void* container, const TArray<float>& quantization, FAnalyticsStringTable* strings,
+	const TArray<uint8>* flags, FAnalyticsVectorPredictor* predictor, uint32 type) const
+{
+	// Quantized coordinates of the predicted vectors, in property order
+	TArray<int64, TInlineAllocator<6>> predicted;
+	const FAnalyticsPropertyPlan* key_property = nullptr;
+
+	if (flags != nullptr)
+	{
+		for (int32 property_id = 0; property_id < Properties.Num() && property_id < flags->Num(); property_id++)
+		{
+			if ((*flags)[property_id] & property_flag_prediction_key) key_property = &Properties[property_id];
+			if (!((*flags)[property_id] & property_flag_predicted) || Properties[property_id].Codec != EAnalyticsPropertyCodec::Vector) continue;
+
+			float step = quantization.IsValidIndex(property_id) ? quantization[property_id] : 0.0f;
+			if (step <= 0.0f) { archive.SetError(); return; }
+
+			const FVector& vector = *reinterpret_cast<const FVector*>(static_cast<uint8*>(container) + Properties[property_id].Offset);
+			for (int32 axis = 0; axis < 3; axis++)
+			{
+				predicted.Add(archive.IsLoading() ? 0 : Quantize(vector[axis], step));
+			}
+		}
+	}
+
+	if (predicted.Num() != 0)
+	{
+		if (archive.IsSaving())
+		{
+			// Fixed size so the chunk writer can replace them without knowing the other properties
+			uint32 key = key_property != nullptr ? GetPredictionKey(*key_property, container) : 0;
+			archive << key;
+
+			for (int64 value : predicted)
+			{
+				int32 steps = (int32)FMath::Clamp<int64>(value, MIN_int32, MAX_int32);
+				archive << steps;
+			}
+		}
+		else
+		{
+			// Residuals only mean something relative to the records before them in the chunk
+			if (predictor == nullptr) { archive.SetError(); return; }
+
+			for (int64& value : predicted)
+			{
+				FAnalyticsCaptureFormat::SerializeZigZag(archive, value);
+			}
+		}
+	}
+
+	for (int32 property_id = 0; property_id < Properties.Num(); property_id++)
+	{
+		const FAnalyticsPropertyPlan& property = Properties[property_id];
+		if (property.bIsTime) continue;
+		if (predicted.Num() != 0 && property_id < flags->Num() && ((*flags)[property_id] & property_flag_predicted) && property.Codec == EAnalyticsPropertyCodec::Vector) continue;
+
+		void* value = static_cast<uint8*>(container) + property.Offset;
+		float step = quantization.IsValidIndex(property_id) ? quantization[property_id] : 0.0f;
+
+		switch (property.Codec)
+		{
+		case EAnalyticsPropertyCodec::String:
+			if (strings != nullptr)
+			{
+				strings->Serialize(archive, *static_cast<FString*>(value));
+			}
+			else
+			{
+				FAnalyticsCaptureFormat::SerializeString(archive, *static_cast<FString*>(value));
+			}
+			break;
+
+		case EAnalyticsPropertyCodec::Vector:
+		{
+			FVector& vector = *static_cast<FVector*>(value);
+			if (step > 0.0f)
+			{
+				SerializeQuantized(archive, vector.X, step);
+				SerializeQuantized(archive, vector.Y, step);
+				SerializeQuantized(archive, vector.Z, step);
+			}
+			else
+			{
+				archive << vector;
+			}
+			break;
+		}
+
+		case EAnalyticsPropertyCodec::Int32:
+			FAnalyticsCaptureFormat::SerializeZigZag(archive, *static_cast<int32*>(value));
+			break;
+
+		case EAnalyticsPropertyCodec::UInt32:
+			FAnalyticsCaptureFormat::SerializeVarInt(archive, *static_cast<uint32*>(value));
+			break;
+
+		case EAnalyticsPropertyCodec::UInt8:
+			archive << *static_cast<uint8*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::Bool:
+		{
+			UBoolProperty* bool_property = static_cast<UBoolProperty*>(property.Property);
+			uint8 data = bool_property->GetPropertyValue(value) ? 1 : 0;
+			archive << data;
+			if (archive.IsLoading()) bool_property->SetPropertyValue(value, data != 0);
+			break;
+		}
+
+		case EAnalyticsPropertyCodec::Float:
+			archive << *static_cast<float*>(value);
+			break;
+
+		case EAnalyticsPropertyCodec::Vector2D:
+		{
+			FVector2D& vector = *static_cast<FVector2D*>(value);
+			if (step > 0.0f)
+			{
+				SerializeQuantized(archive, vector.X, step);
+				SerializeQuantized(archive, vector.Y, step);
+			}
+			else
+			{
+				archive << vector;
+			}
+			break;
+		}
+
+		case EAnalyticsPropertyCodec::Int32Array:
+		{
+			TArray<int32>& values = *static_cast<TArray<int32>*>(value);
+			uint32 count = values.Num();
+			FAnalyticsCaptureFormat::SerializeVarInt(archive, count);
+			if (archive.IsLoading())
+			{
+				// Every element takes at least a byte, a larger count comes from a corrupted record
+				if (count > archive.TotalSize() - archive.Tell()) { archive.SetError(); break; }
+				values.SetNumUninitialized(count);
+			}
+
+			for (int32& element : values)
+			{
+				FAnalyticsCaptureFormat::SerializeZigZag(archive, element);
+			}
+			break;
+		}
+
+		case EAnalyticsPropertyCodec::FloatArray:
+		{
+			TArray<float>& values = *static_cast<TArray<float>*>(value);
+			uint32 count = values.Num();
+			FAnalyticsCaptureFormat::SerializeVarInt(archive, count);
+			if (archive.IsLoading())
+			{
+				if (count > (archive.TotalSize() - archive.Tell()) / sizeof(float)) { archive.SetError(); break; }
+				values.SetNumUninitialized(count);
+			}
+
+			for (float& element : values)
+			{
+				archive << element;
+			}
+			break;
+		}
+
+		case EAnalyticsPropertyCodec::VectorArray:
+			SerializeTrajectory(archive, *static_cast<TArray<FVector>*>(value), step);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	if (predicted.Num() == 0 || !archive.IsLoading() || archive.IsError()) return;
+
+	// The key is read with the other properties, after the residuals that depend on it
+	predictor->Decode(type, key_property != nullptr ? GetPredictionKey(*key_property, container) : 0, predicted.GetData(), predicted.Num());
+
+	int32 coordinate = 0;
+	for (int32 property_id = 0; property_id < Properties.Num() && property_id < flags->Num(); property_id++)
+	{
+		if (!((*flags)[property_id] & property_flag_predicted) || Properties[property_id].Codec != EAnalyticsPropertyCodec::Vector) continue;
+
+		FVector& vector = *reinterpret_cast<FVector*>(static_cast<uint8*>(container) + Properties[property_id].Offset);
+		for (int32 axis = 0; axis < 3; axis++)
+		{
+			vector[axis] = predicted[coordinate++] * quantization[property_id];
+		}
+	}
+}
+
+void FAnalyticsVectorPredictor::Predict(uint32 type, uint32 key, int64* values, int32 count, bool encode)
+{
+	FEntity& entity = entities.FindOrAdd(TPair<uint32, uint32>(type, key));
+
+	if (entity.Previous.Num() != count)
+	{
+		entity.Records = 0;
+		entity.Previous.SetNumZeroed(count);
+		entity.Before.SetNumZeroed(count);
+	}
+
+	// Same prediction as the points of a trajectory: nothing for the first record, the previous one for the second, a constant velocity after
+	for (int32 i = 0; i < count; i++)
+	{
+		int64 prediction = entity.Records == 0 ? 0 : (entity.Records == 1 ? entity.Previous[i] : 2 * entity.Previous[i] - entity.Before[i]);
+		int64 steps = encode ? values[i] : prediction + values[i];
+		values[i] = encode ? steps - prediction : steps;
+
+		entity.Before[i] = entity.Previous[i];
+		entity.Previous[i] = steps;
+	}
+
+	entity.Records = FMath::Min(entity.Records + 1, 2);
+}
+
+void FAnalyticsPacketPlan::SerializeFixedSize(FArchive& archive, void* container) const
+{
+	if (FixedSize == 0) return;
+
+	uint8* packed = static_cast<uint8*>(FMemory_Alloca(FixedSize));
+	uint8* data = static_cast<uint8*>(container);
+	int32 position = 0;
+
+	if (archive.IsLoading())
+	{
+		archive.Serialize(packed, FixedSize);
+
+		for (const FAnalyticsCopyRun& run : Runs)
+		{
+			if (run.BoolProperty != nullptr)
+			{
+				uint32 value;
+				FMemory::Memcpy(&value, packed + position, sizeof(uint32));
+				run.BoolProperty->SetPropertyValue(data + run.Offset, value != 0);
+			}
+			else
+			{
+				FMemory::Memcpy(data + run.Offset, packed + position, run.Size);
+			}
+
+			position += run.Size;
+		}
+	}
+	else
+	{
+		for (const FAnalyticsCopyRun& run : Runs)
+		{
+			if (run.BoolProperty != nullptr)
+			{
+				uint32 value = run.BoolProperty->GetPropertyValue(data + run.Offset) ? 1 : 0;
+				FMemory::Memcpy(packed + position, &value, sizeof(uint32));
+			}
+			else
+			{
+				FMemory::Memcpy(packed + position, data + run.Offset, run.Size);
+			}
+
+			position += run.Size;
+		}
+
+		archive.Serialize(packed, FixedSize);
+	}
+}
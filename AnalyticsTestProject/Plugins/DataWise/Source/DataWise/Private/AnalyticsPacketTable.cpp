@@ -0,0 +1,155 @@
+#include "AnalyticsPacketTable.h"
+#include "DataWise.h"
+#include "Algo/BinarySearch.h"
+
+FAnalyticsPacketTable::FAnalyticsPacketTable(UStruct* type)
+{
+	plan = FAnalyticsPacketPlan::Get(type);
+	if (plan == nullptr) return;
+
+	for (const FAnalyticsPropertyPlan& property : plan->Properties)
+	{
+		// The time column holds UAnalyticsPacket::Time at full precision
+		if (property.bIsTime || property.Codec == EAnalyticsPropertyCodec::Unsupported) continue;
+
+		FColumn column;
+		column.Property = &property;
+
+		switch (property.Codec)
+		{
+		case EAnalyticsPropertyCodec::String:
+			break;
+		case EAnalyticsPropertyCodec::Bool:
+			column.Stride = sizeof(uint8);
+			break;
+		case EAnalyticsPropertyCodec::Int32Array:
+		case EAnalyticsPropertyCodec::FloatArray:
+		case EAnalyticsPropertyCodec::VectorArray:
+			column.Stride = CastChecked<UArrayProperty>(property.Property)->Inner->ElementSize;
+			break;
+		default:
+			column.Stride = property.Size;
+			break;
+		}
+
+		columns.Add(MoveTemp(column));
+	}
+}
+
+void FAnalyticsPacketTable::Add(double time, const void* container)
+{
+	times.Add(time);
+
+	for (FColumn& column : columns)
+	{
+		const FAnalyticsPropertyPlan& property = *column.Property;
+		const uint8* value = static_cast<const uint8*>(container) + property.Offset;
+
+		switch (property.Codec)
+		{
+		case EAnalyticsPropertyCodec::String:
+			column.Strings.Add(*reinterpret_cast<const FString*>(value));
+			break;
+		case EAnalyticsPropertyCodec::Bool:
+			column.Values.Add(CastChecked<UBoolProperty>(property.Property)->GetPropertyValue_InContainer(container) ? 1 : 0);
+			break;
+		case EAnalyticsPropertyCodec::Int32Array:
+		case EAnalyticsPropertyCodec::FloatArray:
+		case EAnalyticsPropertyCodec::VectorArray:
+		{
+			FScriptArrayHelper array(CastChecked<UArrayProperty>(property.Property), value);
+			column.Values.Append(array.GetRawPtr(), array.Num() * column.Stride);
+			column.Ends.Add(column.Values.Num() / column.Stride);
+			break;
+		}
+		default:
+			column.Values.Append(value, column.Stride);
+			break;
+		}
+	}
+}
+
+void FAnalyticsPacketTable::SortByTime()
+{
+	bool sorted = true;
+	for (int32 row = 1; row < times.Num() && sorted; row++)
+	{
+		sorted = times[row - 1] <= times[row];
+	}
+	if (sorted) return;
+
+	TArray<int32> order;
+	order.Reserve(times.Num());
+	for (int32 row = 0; row < times.Num(); row++) order.Add(row);
+	order.StableSort([this](int32 a, int32 b) { return times[a] < times[b]; });
+
+	TArray<double> sorted_times;
+	sorted_times.Reserve(times.Num());
+	for (int32 row : order) sorted_times.Add(times[row]);
+	times = MoveTemp(sorted_times);
+
+	for (FColumn& column : columns)
+	{
+		if (column.Property->Codec == EAnalyticsPropertyCodec::String)
+		{
+			TArray<FString> strings;
+			strings.Reserve(column.Strings.Num());
+			for (int32 row : order) strings.Add(MoveTemp(column.Strings[row]));
+			column.Strings = MoveTemp(strings);
+			continue;
+		}
+
+		TArray<uint8> values;
+		values.Reserve(column.Values.Num());
+
+		if (column.Property->Size == 0)
+		{
+			TArray<int32> ends;
+			ends.Reserve(column.Ends.Num());
+			for (int32 row : order)
+			{
+				int32 start = row > 0 ? column.Ends[row - 1] : 0;
+				values.Append(column.Values.GetData() + start * column.Stride, (column.Ends[row] - start) * column.Stride);
+				ends.Add(values.Num() / column.Stride);
+			}
+			column.Ends = MoveTemp(ends);
+		}
+		else
+		{
+			for (int32 row : order)
+			{
+				values.Append(column.Values.GetData() + row * column.Stride, column.Stride);
+			}
+		}
+
+		column.Values = MoveTemp(values);
+	}
+}
+
+int32 FAnalyticsPacketTable::FindFirstRow(double time) const
+{
+	return Algo::LowerBound(times, time);
+}
+
+TArrayView<const int32> FAnalyticsPacketTable::GetArrayEnds(FName property) const
+{
+	const FColumn* column = FindColumn(property);
+	if (column == nullptr || column->Property->Size != 0) return TArrayView<const int32>();
+	return column->Ends;
+}
+
+const TArray<FString>* FAnalyticsPacketTable::GetStringColumn(FName property) const
+{
+	const FColumn* column = FindColumn(property);
+	return column != nullptr && column->Property->Codec == EAnalyticsPropertyCodec::String ? &column->Strings : nullptr;
+}
+
+const FAnalyticsPacketTable::FColumn* FAnalyticsPacketTable::FindColumn(FName property) const
+{
+	for (const FColumn& column : columns)
+	{
+		if (column.Property->Property->GetFName() == property) return &column;
+	}
+
+	return nullptr;
+}
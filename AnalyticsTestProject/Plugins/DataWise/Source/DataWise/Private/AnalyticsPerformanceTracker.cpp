@@ -0,0 +1,111 @@
+#include "AnalyticsPerformanceTracker.h"
+#include "DataWise.h"
+#include "AnalyticsSession.h"
+#include "RenderCore.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/ScopeLock.h"
+
+UAnalyticsPerformanceTracker* UAnalyticsPerformanceTracker::StartPerformanceTracking(UAnalyticsSession* Session, float Interval, float HitchThreshold, int32 BurstFrames)
+{
+	if (Session == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Performance tracking needs a session to report to"));
+		return nullptr;
+	}
+
+	UAnalyticsPerformanceTracker* tracker = NewObject<UAnalyticsPerformanceTracker>(Session);
+	tracker->Initialize(Session, "Performance", Interval);
+	tracker->hitch_threshold = FMath::Max(HitchThreshold, 1.0f);
+	tracker->burst_frames = FMath::Max(BurstFrames, 0);
+	tracker->history.SetNum(tracker->burst_frames);
+	Session->AddAggregator(tracker);
+
+	return tracker;
+}
+
+void UAnalyticsPerformanceTracker::Tick(float delta_time)
+{
+	// Thread and GPU times are those of the last frame the render thread finished
+	FAnalyticsHitchFrame frame;
+	frame.FrameTime = delta_time * 1000.0f;
+	frame.GameThreadTime = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	frame.RenderThreadTime = FPlatformTime::ToMilliseconds(GRenderThreadTime);
+	frame.GPUTime = FPlatformTime::ToMilliseconds(GGPUFrameTime);
+
+	FScopeLock lock(&mutex);
+
+	frames++;
+	frame_time += frame.FrameTime;
+	frame_time_max = FMath::Max(frame_time_max, frame.FrameTime);
+	game_thread_time += frame.GameThreadTime;
+	render_thread_time += frame.RenderThreadTime;
+	gpu_time += frame.GPUTime;
+
+	UAnalyticsSession* target = session.Get();
+	bool hitch = frame.FrameTime >= hitch_threshold;
+	if (hitch) hitches++;
+
+	if (target != nullptr && hitch && burst_remaining == 0)
+	{
+		hitch_count++;
+
+		// Frames leading up to the hitch, oldest first
+		int32 recorded = history_count;
+		for (int32 index = 0; index < recorded; index++)
+		{
+			FAnalyticsHitchFrame& previous = history[(history_next - recorded + index + burst_frames) % burst_frames];
+			previous.Hitch = hitch_count;
+			previous.Offset = index - recorded;
+			target->Report(previous);
+		}
+
+		burst_remaining = burst_frames + 1;
+	}
+
+	bool in_burst = burst_remaining > 0;
+	if (target != nullptr && in_burst)
+	{
+		frame.Hitch = hitch_count;
+		frame.Offset = burst_frames + 1 - burst_remaining;
+		target->Report(frame);
+		burst_remaining--;
+	}
+
+	if (burst_frames > 0)
+	{
+		history[history_next] = frame;
+		history_next = (history_next + 1) % burst_frames;
+
+		// Frames of a burst are reported already, the next burst only leads with frames that came after it
+		history_count = in_burst ? 0 : FMath::Min(history_count + 1, burst_frames);
+	}
+}
+
+bool UAnalyticsPerformanceTracker::Report(UAnalyticsSession* target, float covered)
+{
+	if (frames == 0) return false;
+
+	FPlatformMemoryStats memory = FPlatformMemory::GetStats();
+
+	FAnalyticsPerformanceSample sample;
+	sample.Interval = covered;
+	sample.Frames = frames;
+	sample.FrameTime = (float)(frame_time / frames);
+	sample.FrameTimeMax = frame_time_max;
+	sample.GameThreadTime = (float)(game_thread_time / frames);
+	sample.RenderThreadTime = (float)(render_thread_time / frames);
+	sample.GPUTime = (float)(gpu_time / frames);
+	sample.Hitches = hitches;
+	sample.UsedPhysicalMemory = (int32)(memory.UsedPhysical / (1024 * 1024));
+	sample.UsedVirtualMemory = (int32)(memory.UsedVirtual / (1024 * 1024));
+	target->Report(sample);
+
+	frames = 0;
+	hitches = 0;
+	frame_time = 0.0;
+	frame_time_max = 0.0f;
+	game_thread_time = 0.0;
+	render_thread_time = 0.0;
+	gpu_time = 0.0;
+	return true;
+}
@@ -0,0 +1,301 @@
+#include "AnalyticsSampling.h"
+#include "DataWise.h"
+#include "AnalyticsPacket.h"
+#include "AnalyticsPacketPlan.h"
+#include "AnalyticsSettings.h"
+#include "AnalyticsCaptureFormat.h"
+#include "Misc/Crc.h"
+#include "Misc/ScopeLock.h"
+
+static int64 LoadTimestamp(volatile const int64* value)
+{
+	return FPlatformAtomics::InterlockedCompareExchange((volatile int64*)value, 0, 0);
+}
+
+static void LowerTimestamp(volatile int64* value, int64 candidate)
+{
+	int64 current = LoadTimestamp(value);
+	while (candidate < current)
+	{
+		int64 previous = FPlatformAtomics::InterlockedCompareExchange(value, candidate, current);
+		if (previous == current) return;
+		current = previous;
+	}
+}
+
+FAnalyticsSampler::~FAnalyticsSampler()
+{
+	for (TPair<UStruct*, FAnalyticsSamplingState*>& type : types)
+	{
+		delete type.Value;
+	}
+
+	for (FAnalyticsSamplingState* state : retired)
+	{
+		delete state;
+	}
+}
+
+void FAnalyticsSampler::SetPolicy(UStruct* type, const FAnalyticsSamplingPolicy& policy)
+{
+	FAnalyticsSamplingState* previous = nullptr;
+
+	{
+		FScopeLock lock(&types_mutex);
+		overrides.Add(type, policy);
+
+		// Resolved again on the next event, dropping the state of the previous policy
+		types.RemoveAndCopyValue(type, previous);
+		if (previous != nullptr) retired.Add(previous);
+		generation.Increment();
+	}
+
+	if (previous == nullptr) return;
+
+	TArray<TPair<TPair<UStruct*, uint32>, double>> closed;
+	{
+		FScopeLock state_lock(&previous->Mutex);
+		previous->bRetired = true;
+
+		for (TPair<uint32, FAnalyticsSamplingState::FSource>& source : previous->Sources)
+		{
+			if (source.Value.WindowCount > 0) closed.Emplace(TPair<UStruct*, uint32>(type, source.Key), source.Value.WindowStart);
+		}
+	}
+
+	CloseWindows(closed);
+}
+
+FAnalyticsSamplingState* FAnalyticsSampler::GetState(UStruct* type, const FAnalyticsPacketPlan* plan)
+{
+	FScopeLock lock(&types_mutex);
+
+	FAnalyticsSamplingState** found = types.Find(type);
+	if (found != nullptr) return (*found)->Policy.IsEnabled() ? *found : nullptr;
+
+	FAnalyticsSamplingState* state = new FAnalyticsSamplingState();
+	state->Type = type;
+	types.Add(type, state);
+
+	const FAnalyticsSamplingPolicy* configured = overrides.Find(type);
+	if (configured == nullptr) configured = UAnalyticsSettings::Get()->SamplingPolicies.Find(plan->Name);
+
+	if (configured != nullptr)
+	{
+		state->Policy = *configured;
+	}
+	else if (UClass* packet_class = Cast<UClass>(type))
+	{
+		if (packet_class->IsChildOf(UAnalyticsPacket::StaticClass())) state->Policy = packet_class->GetDefaultObject<UAnalyticsPacket>()->SamplingPolicy;
+	}
+
+	if (!state->Policy.KeyProperty.IsNone())
+	{
+		state->KeyProperty = plan->FindProperty(state->Policy.KeyProperty);
+		if (state->KeyProperty == nullptr) UE_LOG(AnalyticsLog, Error, TEXT("Sampling key %s not found in %s"), *state->Policy.KeyProperty.ToString(), *plan->Name);
+	}
+
+	return state->Policy.IsEnabled() ? state : nullptr;
+}
+
+EAnalyticsSamplingResult FAnalyticsSampler::Sample(FAnalyticsSamplingState& state, const FAnalyticsPacketPlan* plan, const void* container, double time, TFunctionRef<void(FAnalyticsSampledRecord&)> fill)
+{
+	FScopeLock lock(&state.Mutex);
+
+	// The replacing policy applies from the next event of this thread on
+	if (state.bRetired) return EAnalyticsSamplingResult::Write;
+
+	const FAnalyticsSamplingPolicy& policy = state.Policy;
+	uint32 source_key = GetSourceKey(state.KeyProperty, container);
+	FAnalyticsSamplingState::FSource& source = state.Sources.FindOrAdd(source_key);
+
+	if (policy.MoveEpsilon > 0.0f)
+	{
+		GetVectors(plan, container, state.Vectors);
+		if (!HasMoved(plan, source.LastVectors, state.Vectors, policy.MoveEpsilon)) return EAnalyticsSamplingResult::Skip;
+	}
+
+	if (policy.MaxFrequency > 0.0f && source.LastTime >= 0.0 && time - source.LastTime < 1.0 / policy.MaxFrequency) return EAnalyticsSamplingResult::Skip;
+
+	if (policy.EveryNth > 1 && source.Count++ % policy.EveryNth != 0) return EAnalyticsSamplingResult::Skip;
+
+	source.LastTime = time;
+	if (policy.MoveEpsilon > 0.0f) source.LastVectors = state.Vectors;
+
+	if (policy.ReservoirSize <= 0) return EAnalyticsSamplingResult::Write;
+
+	if (source.WindowCount == 0)
+	{
+		source.WindowStart = time;
+		OpenWindow(state.Type, source_key, time, time + policy.ReservoirWindow);
+	}
+
+	source.WindowCount++;
+
+	// Algorithm R: the nth event of a window replaces a random slot with probability size / n
+	if (source.Reservoir.Num() < policy.ReservoirSize)
+	{
+		fill(source.Reservoir[source.Reservoir.AddDefaulted()]);
+		return EAnalyticsSamplingResult::Reservoir;
+	}
+
+	int32 index = state.Random.RandRange(0, (int32)FMath::Min<int64>(source.WindowCount - 1, MAX_int32));
+	if (index >= policy.ReservoirSize) return EAnalyticsSamplingResult::Skip;
+
+	fill(source.Reservoir[index]);
+	return EAnalyticsSamplingResult::Reservoir;
+}
+
+void FAnalyticsSampler::CollectReservoirs(double time, bool flush, TFunctionRef<void(TArray<FAnalyticsSampledRecord>&)> write)
+{
+	if (!flush && FAnalyticsCaptureFormat::ToTimestamp(time) < LoadTimestamp(&next_window_end)) return;
+
+	// Reporting threads do not wait for another thread that is collecting already
+	if (flush) collect_mutex.Lock();
+	else if (!collect_mutex.TryLock()) return;
+
+	// Windows opened while collecting lower it again
+	FPlatformAtomics::InterlockedExchange(&next_window_end, MAX_int64);
+
+	TArray<FAnalyticsSampledRecord> records;
+	TArray<TPair<TPair<UStruct*, uint32>, double>> closed;
+	int64 next_end = MAX_int64;
+
+	{
+		FScopeLock types_lock(&types_mutex);
+
+		for (TPair<UStruct*, FAnalyticsSamplingState*>& type : types)
+		{
+			FAnalyticsSamplingState& state = *type.Value;
+			if (state.Policy.ReservoirSize <= 0) continue;
+
+			FScopeLock state_lock(&state.Mutex);
+
+			for (TPair<uint32, FAnalyticsSamplingState::FSource>& entry : state.Sources)
+			{
+				FAnalyticsSamplingState::FSource& source = entry.Value;
+				if (source.WindowCount == 0) continue;
+
+				double window_end = source.WindowStart + state.Policy.ReservoirWindow;
+				if (!flush && time < window_end)
+				{
+					next_end = FMath::Min(next_end, FAnalyticsCaptureFormat::ToTimestamp(window_end));
+					continue;
+				}
+
+				source.Reservoir.Sort([](const FAnalyticsSampledRecord& a, const FAnalyticsSampledRecord& b) { return a.Timestamp < b.Timestamp; });
+				for (FAnalyticsSampledRecord& record : source.Reservoir)
+				{
+					records.Add(MoveTemp(record));
+				}
+
+				closed.Emplace(TPair<UStruct*, uint32>(type.Key, entry.Key), source.WindowStart);
+				source.Reservoir.Reset();
+				source.WindowCount = 0;
+			}
+		}
+	}
+
+	LowerTimestamp(&next_window_end, next_end);
+
+	if (records.Num() > 0) write(records);
+	CloseWindows(closed);
+
+	collect_mutex.Unlock();
+}
+
+void FAnalyticsSampler::OpenWindow(UStruct* type, uint32 source, double start, double end)
+{
+	FScopeLock lock(&windows_mutex);
+
+	open_windows.Add(TPair<UStruct*, uint32>(type, source), start);
+	LowerTimestamp(&next_window_end, FAnalyticsCaptureFormat::ToTimestamp(end));
+	UpdateHold();
+}
+
+void FAnalyticsSampler::CloseWindows(const TArray<TPair<TPair<UStruct*, uint32>, double>>& windows)
+{
+	if (windows.Num() == 0) return;
+
+	FScopeLock lock(&windows_mutex);
+
+	for (const TPair<TPair<UStruct*, uint32>, double>& window : windows)
+	{
+		// The source may have opened its next window since it was collected
+		const double* start = open_windows.Find(window.Key);
+		if (start != nullptr && *start == window.Value) open_windows.Remove(window.Key);
+	}
+
+	UpdateHold();
+}
+
+void FAnalyticsSampler::UpdateHold()
+{
+	double oldest = TNumericLimits<double>::Max();
+	for (const TPair<TPair<UStruct*, uint32>, double>& window : open_windows)
+	{
+		oldest = FMath::Min(oldest, window.Value);
+	}
+
+	if (oldest == hold) return;
+	hold = oldest;
+
+	if (hold_output) hold_output(hold);
+}
+
+uint32 FAnalyticsSampler::GetSourceKey(const FAnalyticsPropertyPlan* key_property, const void* container)
+{
+	if (key_property == nullptr) return 0;
+
+	const uint8* value = static_cast<const uint8*>(container) + key_property->Offset;
+
+	switch (key_property->Codec)
+	{
+	case EAnalyticsPropertyCodec::String:
+		return GetTypeHash(*reinterpret_cast<const FString*>(value));
+
+	case EAnalyticsPropertyCodec::Bool:
+		return static_cast<UBoolProperty*>(key_property->Property)->GetPropertyValue(value) ? 1 : 0;
+
+	case EAnalyticsPropertyCodec::Unsupported:
+		return 0;
+
+	default:
+		return FCrc::MemCrc32(value, key_property->Size);
+	}
+}
+
+void FAnalyticsSampler::GetVectors(const FAnalyticsPacketPlan* plan, const void* container, TArray<float>& result)
+{
+	result.Reset();
+
+	for (const FAnalyticsPropertyPlan& property : plan->Properties)
+	{
+		if (property.Codec != EAnalyticsPropertyCodec::Vector && property.Codec != EAnalyticsPropertyCodec::Vector2D) continue;
+
+		const float* value = reinterpret_cast<const float*>(static_cast<const uint8*>(container) + property.Offset);
+		result.Append(value, property.Size / sizeof(float));
+	}
+}
+
+bool FAnalyticsSampler::HasMoved(const FAnalyticsPacketPlan* plan, const TArray<float>& previous, const TArray<float>& current, float epsilon)
+{
+	if (previous.Num() != current.Num()) return true;
+
+	int32 component = 0;
+	for (const FAnalyticsPropertyPlan& property : plan->Properties)
+	{
+		if (property.Codec != EAnalyticsPropertyCodec::Vector && property.Codec != EAnalyticsPropertyCodec::Vector2D) continue;
+
+		float distance = 0.0f;
+		int32 count = property.Size / sizeof(float);
+		for (int32 i = 0; i < count; i++, component++)
+		{
+			distance += FMath::Square(current[component] - previous[component]);
+		}
+
+		if (distance > FMath::Square(epsilon)) return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,110 @@
+#include "AnalyticsSchemaCatalog.h"
+#include "DataWise.h"
+#include "Misc/ScopeLock.h"
+#include "ClassFinder.h"
+
+struct FAnalyticsSchemaEntry
+{
+	TArray<uint8> Schema;
+	TWeakObjectPtr<UStruct> Type;
+	FLocalPacketType PacketType;
+};
+
+struct FAnalyticsUnresolvedSchema
+{
+	TArray<uint8> Schema;
+
+	// UClassFinder::GetCacheGeneration before the lookup that failed
+	int32 Generation = 0;
+};
+
+static FCriticalSection catalog_mutex;
+static TMultiMap<uint32, FAnalyticsSchemaEntry> catalog;
+static TMultiMap<uint32, FAnalyticsUnresolvedSchema> unresolved;
+
+bool FAnalyticsSchemaCatalog::Find(uint32 hash, const TArray<uint8>& schema, FLocalPacketType& packet_type)
+{
+	FScopeLock lock(&catalog_mutex);
+
+	TArray<FAnalyticsSchemaEntry*> entries;
+	catalog.MultiFindPointer(hash, entries);
+
+	for (FAnalyticsSchemaEntry* entry : entries)
+	{
+		if (entry->Schema != schema) continue;
+
+		// The plan is recompiled when the type is replaced, the schema has to be validated against the new one
+		UStruct* type = entry->Type.Get();
+		if (type == nullptr || FAnalyticsPacketPlan::Get(type) != entry->PacketType.Plan) return false;
+
+		packet_type = entry->PacketType;
+		return true;
+	}
+
+	return false;
+}
+
+void FAnalyticsSchemaCatalog::Add(uint32 hash, const TArray<uint8>& schema, const FLocalPacketType& packet_type)
+{
+	FScopeLock lock(&catalog_mutex);
+
+	TArray<FAnalyticsSchemaEntry*> entries;
+	catalog.MultiFindPointer(hash, entries);
+
+	FAnalyticsSchemaEntry* entry = nullptr;
+	for (FAnalyticsSchemaEntry* existing : entries)
+	{
+		if (existing->Schema == schema) { entry = existing; break; }
+	}
+
+	if (entry == nullptr) entry = &catalog.Add(hash, FAnalyticsSchemaEntry());
+
+	entry->Schema = schema;
+	entry->Type = packet_type.Struct != nullptr ? static_cast<UStruct*>(packet_type.Struct) : static_cast<UStruct*>(packet_type.Class);
+	entry->PacketType = packet_type;
+	entry->PacketType.SchemaHash = hash;
+}
+
+bool FAnalyticsSchemaCatalog::IsUnresolved(uint32 hash, const TArray<uint8>& schema)
+{
+	FScopeLock lock(&catalog_mutex);
+
+	TArray<FAnalyticsUnresolvedSchema*> entries;
+	unresolved.MultiFindPointer(hash, entries);
+
+	for (FAnalyticsUnresolvedSchema* entry : entries)
+	{
+		if (entry->Schema != schema) continue;
+
+		// Assets or classes changed since, the type may be found now
+		return entry->Generation == UClassFinder::GetCacheGeneration();
+	}
+
+	return false;
+}
+
+void FAnalyticsSchemaCatalog::AddUnresolved(uint32 hash, const TArray<uint8>& schema, int32 generation)
+{
+	FScopeLock lock(&catalog_mutex);
+
+	TArray<FAnalyticsUnresolvedSchema*> entries;
+	unresolved.MultiFindPointer(hash, entries);
+
+	FAnalyticsUnresolvedSchema* entry = nullptr;
+	for (FAnalyticsUnresolvedSchema* existing : entries)
+	{
+		if (existing->Schema == schema) { entry = existing; break; }
+	}
+
+	if (entry == nullptr) entry = &unresolved.Add(hash, FAnalyticsUnresolvedSchema());
+
+	entry->Schema = schema;
+	entry->Generation = generation;
+}
+
+void FAnalyticsSchemaCatalog::Reset()
+{
+	FScopeLock lock(&catalog_mutex);
+	catalog.Empty();
+	unresolved.Empty();
+}
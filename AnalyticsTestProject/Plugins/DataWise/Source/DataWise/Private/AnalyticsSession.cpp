@@ -1,15 +1,33 @@
 #include "AnalyticsSession.h"
 #include "DataWise.h"
 #include "AnalyticsLocalCaptureManager.h"
+#include "AnalyticsCaptureWriter.h"
+#include "AnalyticsCaptureFormat.h"
+#include "AnalyticsCaptureMultiplexer.h"
+#include "AnalyticsCaptureUploader.h"
+#include "AnalyticsAggregators.h"
+#include "AnalyticsPacketPlan.h"
+#include "AnalyticsSettings.h"
+#include "Serialization/MemoryWriter.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/ScopeRWLock.h"
 #include "Engine/Engine.h"
 #include "HAL/PlatformFilemanager.h"
 #include "HAL/FileManager.h"
 #include "Misc/Paths.h"
+#include "Misc/CoreDelegates.h"
+#include "Containers/Ticker.h"
 
 TArray<UAnalyticsSession*> UAnalyticsSession::active_sessions;
+FCriticalSection UAnalyticsSession::sessions_mutex;
+FThreadSafeCounter UAnalyticsSession::recording_sessions;
+
+static FThreadSafeCounter next_session_id;
+static FThreadSafeCounter ended_sessions;
 
 void UAnalyticsSession::GetSession(int32 index, UAnalyticsSession*& session, bool& valid)
 {
+	FScopeLock lock(&sessions_mutex);
 	valid = active_sessions.IsValidIndex(index);
 
 	if (valid)
@@ -24,61 +42,228 @@ void UAnalyticsSession::GetSession(int32 index, UAnalyticsSession*& session, boo
 
 TArray<UAnalyticsSession*> UAnalyticsSession::GetActiveSessions()
 {
+	FScopeLock lock(&sessions_mutex);
 	return active_sessions;
 }
 
 void UAnalyticsSession::BeginSession(UObject* WorldContextObject, FString name, UAnalyticsSession*& session, int32& index)
+{
+	StartSession(WorldContextObject, name, false, session, index);
+}
+
+void UAnalyticsSession::BeginFlightRecorder(UObject* WorldContextObject, FString name, UAnalyticsSession*& session, int32& index)
+{
+	StartSession(WorldContextObject, name, true, session, index);
+}
+
+void UAnalyticsSession::StartSession(UObject* WorldContextObject, const FString& name, bool flight_recorder, UAnalyticsSession*& session, int32& index)
 {
 	UWorld * world = GEngine->GetWorldFromContextObjectChecked(WorldContextObject);
+
+	static bool crash_dumps_recovered = false;
+	if (!crash_dumps_recovered)
+	{
+		RecoverCrashDumps();
+		crash_dumps_recovered = true;
+	}
 	session = NewObject<UAnalyticsSession>(world);
 
+	session->id = next_session_id.Increment();
 	session->start_time = FPlatformTime::Seconds();
-	index = active_sessions.Add(session);
+	session->flight_recorder = flight_recorder;
 
 	FDateTime now = FDateTime::Now();
 	session->name = name + (name.IsEmpty() ? "" : "_") + FString::Printf(TEXT("%02i"), now.GetDay()) + FString::Printf(TEXT("%02i"), now.GetMonth()) + "_" + FString::Printf(TEXT("%02i"), now.GetHour()) + FString::Printf(TEXT("%02i"), now.GetMinute()) + FString::Printf(TEXT("%02i"), now.GetSecond());
 
-	FString directory = FPaths::ProjectDir() + local_capture_path;
-	FString filename = session->name + ".cap";
-	FString path = directory + filename;
+	if (flight_recorder)
+	{
+		session->writer = new FAnalyticsCaptureWriter(session->start_time, UAnalyticsSettings::Get());
 
-	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
-	PlatformFile.CreateDirectoryTree(*directory);
+		if (UAnalyticsSettings::Get()->bDumpFlightRecorderOnError)
+		{
+			FString directory = FPaths::ProjectDir() + local_capture_path;
+			FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*directory);
+			session->writer->OpenCrashDump(directory + session->name + crash_dump_extension);
+
+			static bool error_dump_bound = false;
+			if (!error_dump_bound)
+			{
+				FCoreDelegates::OnHandleSystemError.AddStatic(&UAnalyticsSession::DumpFlightRecordersOnError);
+				error_dump_bound = true;
+			}
+		}
+	}
+	else if (IsRunningDedicatedServer() && UAnalyticsSettings::Get()->bMultiplexServerSessions)
+	{
+		FArchive* archive = FAnalyticsCaptureMultiplexer::CreateStreamWriter(session->name, session->multiplex_container, session->multiplex_stream);
 
-	session->archive = IFileManager::Get().CreateFileWriter(*path);
+		if (archive == nullptr)
+		{
+			UE_LOG(AnalyticsLog, Error, TEXT("Session could not be started"));
+			session->ConditionalBeginDestroy();
+			session = nullptr;
+			index = -1;
+			return;
+		}
 
-	if (session->archive->GetError())
+		session->multiplexed = true;
+		session->writer = new FAnalyticsCaptureWriter(archive, FString(), session->start_time, UAnalyticsSettings::Get());
+	}
+	else
 	{
-		UE_LOG(AnalyticsLog, Error, TEXT("Session could not be started"));
-		session->ConditionalBeginDestroy();
-		session = nullptr;
-		index = -1;
-		return;
+		FString directory = FPaths::ProjectDir() + local_capture_path;
+		FString filename = session->name + ".cap";
+		FString path = directory + filename;
+
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		PlatformFile.CreateDirectoryTree(*directory);
+
+		FArchive* archive = IFileManager::Get().CreateFileWriter(*path);
+
+		if (archive == nullptr || archive->GetError())
+		{
+			UE_LOG(AnalyticsLog, Error, TEXT("Session could not be started"));
+			delete archive;
+			session->ConditionalBeginDestroy();
+			session = nullptr;
+			index = -1;
+			return;
+		}
+
+		session->writer = new FAnalyticsCaptureWriter(archive, path, session->start_time, UAnalyticsSettings::Get());
+	}
+
+	session->registration_archive = new FMemoryWriter(session->registration_buffer);
+	session->serializer = new LocalPacketSerializer(nullptr, session->registration_archive);
+
+	// String definitions are queued like registrations, ahead of the records that refer to them
+	FAnalyticsCaptureWriter* session_writer = session->writer;
+	session->serializer->GetStrings().SetOutput([session_writer](const TArray<uint8>& definition) { session_writer->WriteControl(definition); });
+	session->sampler = new FAnalyticsSampler();
+
+	// Reservoir samples are written once their window ends, the writer holds back everything reported since the oldest open window
+	session->sampler->SetHoldOutput([session_writer](double hold)
+	{
+		session_writer->SetMergeHold(hold == TNumericLimits<double>::Max() ? MAX_int64 : FAnalyticsCaptureFormat::ToTimestamp(hold));
+	});
+	session->stats = new FAnalyticsStatsTracker();
+
+	// Schemas of all loaded packet classes lead the capture, so reporting a class for the first time does not cause a hitch
+	TArray<const FLocalPacketType*> registered;
+	session->serializer->RegisterLoadedTypes(registered);
+	if (session->registration_buffer.Num() != 0) session->writer->WriteControl(session->registration_buffer);
+
+	for (const FLocalPacketType* packet_type : registered)
+	{
+		session->stats->RegisterType(packet_type->Index, packet_type->Plan->Name);
 	}
 
 	session->active = true;
-	session->serializer = new LocalPacketSerializer(session->archive);
+
+	{
+		FScopeLock lock(&sessions_mutex);
+		index = active_sessions.Add(session);
+		if (!flight_recorder) recording_sessions.Increment();
+	}
 
 	UE_LOG(AnalyticsLog, Log, TEXT("Started analytics session"));
 }
 
 void UAnalyticsSession::EndSession()
 {
-	delete serializer;
-	serializer = nullptr;
+	{
+		FScopeLock lock(&sessions_mutex);
+		if (active_sessions.Remove(this) > 0 && !flight_recorder) recording_sessions.Decrement();
+	}
 
-	archive->Flush();
-	archive->Close();
-	archive = nullptr;
+	// The last partial interval of every aggregator, reported while the writer is still open
+	FlushAggregators();
 
-	StoreMetaData();
+	{
+		// Waits for reports that are in progress on other threads
+		FRWScopeLock lock(lifetime_lock, SLT_Write);
+		if (!active) return;
+
+		WriteSampledRecords(0.0, true);
+
+		// Other threads drop their entry on their next report
+		FAnalyticsThreadContext::Get().Sessions.Remove(id);
+		ended_sessions.Increment();
+		delete sampler;
+		sampler = nullptr;
+
+		delete stats;
+		stats = nullptr;
+
+		delete serializer;
+		serializer = nullptr;
+
+		delete registration_archive;
+		registration_archive = nullptr;
+
+		// Meta data of a multiplexed stream is kept in the container, which is finished when the last stream closes
+		if (multiplexed) FAnalyticsCaptureMultiplexer::SetStreamMeta(multiplex_container, multiplex_stream, meta_data);
+
+		// Blocks until the writer has stored every reported event
+		writer->Close();
+		delete writer;
+		writer = nullptr;
+
+		active = false;
+	}
+
+	// A flight recorder only leaves files behind when it is dumped
+	if (!flight_recorder && !multiplexed)
+	{
+		StoreMetaData(name);
+		FAnalyticsCaptureUploader::QueueCapture(name);
+	}
 
 	UE_LOG(AnalyticsLog, Log, TEXT("Ended analytics session"));
-	active_sessions.Remove(this);
-	active = false;
 	ConditionalBeginDestroy();
 }
 
+void UAnalyticsSession::AddAggregator(UAnalyticsAggregator* aggregator)
+{
+	if (!active) return;
+
+	aggregators.Add(aggregator);
+
+	if (!aggregator_ticker.IsValid())
+	{
+		aggregator_ticker = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UAnalyticsSession::TickAggregators));
+	}
+}
+
+bool UAnalyticsSession::TickAggregators(float delta_time)
+{
+	double now = FPlatformTime::Seconds();
+	for (UAnalyticsAggregator* aggregator : aggregators)
+	{
+		aggregator->Tick(delta_time);
+		aggregator->Emit(now, false);
+	}
+
+	return true;
+}
+
+void UAnalyticsSession::FlushAggregators()
+{
+	if (aggregator_ticker.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(aggregator_ticker);
+		aggregator_ticker.Reset();
+	}
+
+	double now = FPlatformTime::Seconds();
+	for (UAnalyticsAggregator* aggregator : aggregators)
+	{
+		aggregator->Emit(now, true);
+	}
+
+	aggregators.Empty();
+}
+
 void UAnalyticsSession::SetMetaData(TMap<FString, FString> Meta)
 {
 	TArray<FString> keys;
@@ -94,32 +279,65 @@ void UAnalyticsSession::SetMetaData(TMap<FString, FString> Meta)
 			meta_data.Add(key, Meta[key]);
 		}
 	}
+
+	// Stored right away so it survives a crash before the session ends
+	if (active && multiplexed)
+	{
+		FAnalyticsCaptureMultiplexer::SetStreamMeta(multiplex_container, multiplex_stream, meta_data);
+	}
+	else if (active && !flight_recorder)
+	{
+		StoreMetaData(name);
+	}
+}
+
+void UAnalyticsSession::SetSamplingPolicy(TSubclassOf<UAnalyticsPacket> Class, FAnalyticsSamplingPolicy Policy)
+{
+	FRWScopeLock lock(lifetime_lock, SLT_ReadOnly);
+	if (sampler == nullptr || *Class == nullptr) return;
+	sampler->SetPolicy(*Class, Policy);
+}
+
+void UAnalyticsSession::SetStructSamplingPolicy(UScriptStruct* type, const FAnalyticsSamplingPolicy& policy)
+{
+	FRWScopeLock lock(lifetime_lock, SLT_ReadOnly);
+	if (sampler == nullptr || type == nullptr) return;
+	sampler->SetPolicy(type, policy);
 }
 
 void UAnalyticsSession::BeginDestroy()
 {
 	Super::BeginDestroy();
 	if (active) EndSession();
+
+	ReleaseReport();
+	FMemory::Free(report_container);
+	report_container = nullptr;
+	report_container_size = 0;
 }
 
 int32 UAnalyticsSession::GetCaptureSize()
 {
-	if (archive == nullptr) return 0;
-	return archive->Tell();
+	return (int32)FMath::Min<int64>(GetCaptureSizeBytes(), MAX_int32);
+}
+
+int64 UAnalyticsSession::GetCaptureSizeBytes() const
+{
+	if (writer == nullptr) return 0;
+	return writer->GetWrittenSize();
 }
 
 FString UAnalyticsSession::GetFormattedCaptureSize()
 {
-	int32 size = GetCaptureSize();
-	FString out;
+	int64 size = GetCaptureSizeBytes();
 	if (size > 1024 * 1024 * 1024)
 	{
-		return FString::Printf(TEXT("%.2f"), size / 1024.0f) + "GB";
+		return FString::Printf(TEXT("%.2f"), size / (1024.0 * 1024.0 * 1024.0)) + "GB";
 	}
 
 	if (size > 1024 * 1024)
 	{
-		return FString::Printf(TEXT("%.2f"), size / 1024.0f) + "MB";
+		return FString::Printf(TEXT("%.2f"), size / (1024.0 * 1024.0)) + "MB";
 	}
 
 	if (size > 1024)
@@ -127,31 +345,133 @@ FString UAnalyticsSession::GetFormattedCaptureSize()
 		return FString::Printf(TEXT("%.2f"), size / 1024.0f) + "KB";
 	}
 
-	return FString::FromInt(size) + "B";
+	return FString::Printf(TEXT("%lld"), size) + "B";
 }
 
-void UAnalyticsSession::StoreMetaData()
+FAnalyticsSessionStats UAnalyticsSession::GetStats()
+{
+	FAnalyticsSessionStats session_stats;
+
+	FRWScopeLock lock(lifetime_lock, SLT_ReadOnly);
+	if (stats == nullptr) return session_stats;
+
+	stats->GetStats(session_stats);
+	session_stats.QueueDepth = (int32)FMath::Min<int64>(writer->GetQueueDepth(), MAX_int32);
+	session_stats.DroppedEvents = writer->GetDroppedCount();
+	writer->GetFlushLatency().Get(session_stats.FlushLatency, session_stats.FlushLatencyBuckets);
+
+	return session_stats;
+}
+
+bool UAnalyticsSession::DumpFlightRecorder(FString& Capture)
+{
+	FRWScopeLock lock(lifetime_lock, SLT_ReadOnly);
+
+	if (writer == nullptr || !writer->IsFlightRecorder())
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Session is not a flight recorder!"));
+		return false;
+	}
+
+	Capture = name + FString::Printf(TEXT("_Dump%02i"), dump_count.Increment());
+
+	FString directory = FPaths::ProjectDir() + local_capture_path;
+	FString path = directory + Capture + ".cap";
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*directory);
+
+	if (!writer->Dump(path)) return false;
+
+	StoreMetaData(Capture);
+	FAnalyticsCaptureUploader::QueueCapture(Capture);
+
+	UE_LOG(AnalyticsLog, Log, TEXT("Dumped flight recorder to %s"), *path);
+	return true;
+}
+
+void UAnalyticsSession::DumpFlightRecorders()
+{
+	for (UAnalyticsSession* session : GetActiveSessions())
+	{
+		FString capture;
+		if (session->flight_recorder) session->DumpFlightRecorder(capture);
+	}
+}
+
+void UAnalyticsSession::DumpFlightRecordersOnError()
+{
+	// Sessions remove themselves from the list before their writer is deleted, so every writer is valid while the lock is held
+	if (!sessions_mutex.TryLock()) return;
+
+	for (UAnalyticsSession* session : active_sessions)
+	{
+		if (session->flight_recorder && session->writer != nullptr) session->writer->WriteCrashDump();
+	}
+
+	sessions_mutex.Unlock();
+}
+
+void UAnalyticsSession::RecoverCrashDumps()
+{
+	TArray<FString> active;
+	for (UAnalyticsSession* session : GetActiveSessions())
+	{
+		active.Add(session->GetName());
+	}
+
+	FString directory = FPaths::ProjectDir() + local_capture_path;
+	IFileManager& FileManager = IFileManager::Get();
+
+	TArray<FString> files;
+	FileManager.FindFiles(files, *directory, TEXT(crash_dump_extension));
+
+	for (const FString& file : files)
+	{
+		FString name = FPaths::GetBaseFilename(file);
+
+		// Flight recorders that are running have their dump file open
+		if (active.Contains(name)) continue;
+
+		FString path = directory + file;
+		FString capture = name + "_Crash";
+
+		// Dumps of runs that ended without a crash are empty
+		if (FileManager.FileSize(*path) > 0 && FAnalyticsCaptureWriter::RecoverCrashDump(path, directory + capture + ".cap"))
+		{
+			UE_LOG(AnalyticsLog, Log, TEXT("Recovered flight recorder of a crashed run as %s"), *capture);
+			FAnalyticsCaptureUploader::QueueCapture(capture);
+		}
+
+		FileManager.Delete(*path);
+	}
+}
+
+void UAnalyticsSession::StoreMetaData(const FString& capture_name)
 {
 	if (meta_data.Num() == 0) return;
 
 	FString directory = FPaths::ProjectDir() + local_capture_path;
-	FString filename = name + ".meta";
+	FString filename = capture_name + ".meta";
 	FString path = directory + filename;
+	FString temporary_path = path + ".tmp";
 
 	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
 	PlatformFile.CreateDirectoryTree(*directory);
 
-	FArchive* meta_archive = IFileManager::Get().CreateFileWriter(*path);
+	// Written next to the meta file and moved over it, so a crash never leaves a torn meta file
+	FArchive* meta_archive = IFileManager::Get().CreateFileWriter(*temporary_path);
 
 	if (meta_archive == nullptr)
 	{
-		UE_LOG(AnalyticsLog, Error, TEXT("Could not write to %s"), *path);
+		UE_LOG(AnalyticsLog, Error, TEXT("Could not write to %s"), *temporary_path);
 		return;
 	}
 
 	if(meta_archive->GetError())
 	{
-		UE_LOG(AnalyticsLog, Error, TEXT("Could not open meta file: %s"), *path);
+		UE_LOG(AnalyticsLog, Error, TEXT("Could not open meta file: %s"), *temporary_path);
+		delete meta_archive;
 		return;
 	}
 
@@ -159,11 +479,17 @@ void UAnalyticsSession::StoreMetaData()
 
 	meta_archive->Flush();
 	meta_archive->Close();
+	delete meta_archive;
+
+	if (!IFileManager::Get().Move(*path, *temporary_path, true, true))
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Could not write to %s"), *path);
+	}
 }
 
 void UAnalyticsSession::ReportEvent(UObject* packet)
 {
-	if (archive == nullptr)
+	if (writer == nullptr)
 	{
 		UE_LOG(AnalyticsLog, Error, TEXT("No archive to write to!"));
 		packet->Rename(TEXT("Packet"), nullptr, REN_None);
@@ -190,11 +516,266 @@ void UAnalyticsSession::ReportEvent(UObject* packet)
 
 	UAnalyticsPacket* reported_packet = Cast<UAnalyticsPacket>(packet);
 
-	double time = FPlatformTime::Seconds() - start_time;
-	reported_packet->Time = time;
-
-	serializer->AddPacket(reported_packet);
+	{
+		FRWScopeLock lock(lifetime_lock, SLT_ReadOnly);
+		if (writer != nullptr) WriteEvent(reported_class, reported_packet, reported_packet);
+	}
 
 	packet->Rename(TEXT("Packet"), nullptr, REN_None);
 	packet->ConditionalBeginDestroy();
 }
+
+void UAnalyticsSession::ReportStruct(UScriptStruct* type, const void* packet)
+{
+	if (type == nullptr || packet == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Reported packet is not valid!"));
+		return;
+	}
+
+	FRWScopeLock lock(lifetime_lock, SLT_ReadOnly);
+	if (writer == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("No archive to write to!"));
+		return;
+	}
+
+	WriteEvent(type, packet);
+}
+
+const FAnalyticsThreadContext::FReportedType& UAnalyticsSession::GetReportedType(UStruct* type)
+{
+	FAnalyticsThreadContext& context = FAnalyticsThreadContext::Get();
+
+	// Types of sessions that ended point to their serializer and sampler, which are gone
+	int32 ended = ended_sessions.GetValue();
+	if (context.EndedSessions != ended)
+	{
+		context.EndedSessions = ended;
+
+		TSet<uint32> active_ids;
+		{
+			FScopeLock lock(&sessions_mutex);
+			for (UAnalyticsSession* session : active_sessions)
+			{
+				active_ids.Add(session->id);
+			}
+		}
+
+		for (TMap<uint32, FAnalyticsThreadContext::FSessionTypes>::TIterator entry = context.Sessions.CreateIterator(); entry; ++entry)
+		{
+			if (entry.Key() != id && !active_ids.Contains(entry.Key())) entry.RemoveCurrent();
+		}
+	}
+
+	FAnalyticsThreadContext::FSessionTypes& cache = context.Sessions.FindOrAdd(id);
+
+	// Sampling states are replaced when a policy is set, which bumps the generation
+	int32 generation = sampler->GetGeneration();
+	if (cache.SamplingGeneration != generation)
+	{
+		cache.SamplingGeneration = generation;
+		cache.Types.Reset();
+	}
+
+	const FAnalyticsThreadContext::FReportedType* found = cache.Types.Find(type);
+	if (found != nullptr) return *found;
+
+	FAnalyticsThreadContext::FReportedType reported;
+
+	{
+		FScopeLock lock(&register_mutex);
+
+		registration_buffer.Reset();
+		registration_archive->Seek(0);
+
+		// The serializer registers a type only once, even when several threads report it for the first time
+		reported.Type = &serializer->GetPacketType(type);
+		if (registration_buffer.Num() != 0)
+		{
+			writer->WriteControl(registration_buffer);
+			stats->RegisterType(reported.Type->Index, reported.Type->Plan->Name);
+		}
+	}
+
+	reported.Sampling = sampler->GetState(type, reported.Type->Plan);
+	return cache.Types.Add(type, reported);
+}
+
+void UAnalyticsSession::WriteEvent(UStruct* type, const void* container, UAnalyticsPacket* packet)
+{
+	const FAnalyticsThreadContext::FReportedType& reported = GetReportedType(type);
+	const FLocalPacketType* packet_type = reported.Type;
+
+	// Taken once the type is registered, which can wait for other threads, so the record reaches the writer within the merge window of its timestamp
+	double time = FPlatformTime::Seconds() - start_time;
+	int64 timestamp = FAnalyticsCaptureFormat::ToTimestamp(time);
+
+	if (packet != nullptr)
+	{
+		packet->Time = time;
+		packet->PreciseTime = time;
+	}
+
+	WriteSampledRecords(time, false);
+
+	if (reported.Sampling != nullptr)
+	{
+		EAnalyticsSamplingResult sampling = sampler->Sample(*reported.Sampling, packet_type->Plan, container, time, [&](FAnalyticsSampledRecord& slot)
+		{
+			slot.Type = packet_type->Index;
+			slot.Timestamp = timestamp;
+			slot.Payload.Reset();
+			FMemoryWriter slot_archive(slot.Payload);
+			LocalPacketSerializer::SerializePayload(slot_archive, *packet_type, container, &serializer->GetStrings());
+		});
+
+		if (sampling == EAnalyticsSamplingResult::Skip)
+		{
+			stats->RecordSampledOut(packet_type->Index);
+			return;
+		}
+
+		if (sampling == EAnalyticsSamplingResult::Reservoir) return;
+	}
+
+	// Encoded on the reporting thread into its own scratch buffer
+	TArray<uint8>& payload = FAnalyticsThreadContext::Get().Payload;
+	payload.Reset();
+	FMemoryWriter payload_archive(payload);
+
+	uint32 serialize_start = FPlatformTime::Cycles();
+	LocalPacketSerializer::SerializePayload(payload_archive, *packet_type, container, &serializer->GetStrings());
+	stats->RecordEvent(packet_type->Index, payload.Num(), FPlatformTime::Cycles() - serialize_start);
+
+	writer->WriteRecord(packet_type->Index, timestamp, payload, packet_type->Lane);
+}
+
+void UAnalyticsSession::WriteSampledRecords(double time, bool flush)
+{
+	sampler->CollectReservoirs(time, flush, [this](TArray<FAnalyticsSampledRecord>& records)
+	{
+		// Reservoir samples are written late by design and always go to the bulk lane, the writer merges them in timestamp order
+		for (const FAnalyticsSampledRecord& record : records)
+		{
+			stats->RecordEvent(record.Type, record.Payload.Num(), 0);
+			writer->WriteDelayedRecord(record.Type, record.Timestamp, record.Payload);
+		}
+	});
+}
+
+void UAnalyticsSession::BeginReport(TSubclassOf<UAnalyticsPacket> Class)
+{
+	ReleaseReport();
+
+	if (writer == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("No archive to write to!"));
+		return;
+	}
+
+	if (*Class == nullptr)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Reported class is not a valid packet!"));
+		return;
+	}
+
+	int32 size = Class->GetPropertiesSize();
+	int32 alignment = FMath::Max(16, Class->GetMinAlignment());
+	if (report_container == nullptr || report_container_size < size)
+	{
+		FMemory::Free(report_container);
+		report_container = static_cast<uint8*>(FMemory::Malloc(size, alignment));
+		report_container_size = size;
+	}
+
+	report_class = *Class;
+	report_plan = FAnalyticsPacketPlan::Get(report_class);
+
+	// Only the serialized properties live in the container, initialized to the class defaults
+	UObject* defaults = report_class->GetDefaultObject();
+	for (const FAnalyticsPropertyPlan& property : report_plan->Properties)
+	{
+		if (property.Codec == EAnalyticsPropertyCodec::Unsupported) continue;
+
+		property.Property->InitializeValue_InContainer(report_container);
+		property.Property->CopyCompleteValue_InContainer(report_container, defaults);
+	}
+}
+
+void UAnalyticsSession::WriteReportString(FName Property, const FString& Value)
+{
+	const FAnalyticsPropertyPlan* property = FindReportProperty(Property, EAnalyticsPropertyCodec::String);
+	if (property != nullptr) *reinterpret_cast<FString*>(report_container + property->Offset) = Value;
+}
+
+void UAnalyticsSession::WriteReportVector(FName Property, FVector Value)
+{
+	const FAnalyticsPropertyPlan* property = FindReportProperty(Property, EAnalyticsPropertyCodec::Vector);
+	if (property != nullptr) *reinterpret_cast<FVector*>(report_container + property->Offset) = Value;
+}
+
+void UAnalyticsSession::WriteReportInt(FName Property, int32 Value)
+{
+	const FAnalyticsPropertyPlan* property = FindReportProperty(Property, EAnalyticsPropertyCodec::Int32);
+	if (property != nullptr) *reinterpret_cast<int32*>(report_container + property->Offset) = Value;
+}
+
+void UAnalyticsSession::WriteReportBool(FName Property, bool Value)
+{
+	const FAnalyticsPropertyPlan* property = FindReportProperty(Property, EAnalyticsPropertyCodec::Bool);
+	if (property != nullptr) static_cast<UBoolProperty*>(property->Property)->SetPropertyValue(report_container + property->Offset, Value);
+}
+
+void UAnalyticsSession::WriteReportFloat(FName Property, float Value)
+{
+	const FAnalyticsPropertyPlan* property = FindReportProperty(Property, EAnalyticsPropertyCodec::Float);
+	if (property != nullptr) *reinterpret_cast<float*>(report_container + property->Offset) = Value;
+}
+
+void UAnalyticsSession::WriteReportVector2D(FName Property, FVector2D Value)
+{
+	const FAnalyticsPropertyPlan* property = FindReportProperty(Property, EAnalyticsPropertyCodec::Vector2D);
+	if (property != nullptr) *reinterpret_cast<FVector2D*>(report_container + property->Offset) = Value;
+}
+
+void UAnalyticsSession::EndReport()
+{
+	if (report_plan == nullptr) return;
+
+	{
+		FRWScopeLock lock(lifetime_lock, SLT_ReadOnly);
+		if (writer != nullptr) WriteEvent(report_class, report_container);
+	}
+
+	ReleaseReport();
+}
+
+const FAnalyticsPropertyPlan* UAnalyticsSession::FindReportProperty(FName Property, EAnalyticsPropertyCodec Codec)
+{
+	if (report_plan == nullptr) return nullptr;
+
+	const FAnalyticsPropertyPlan* property = report_plan->FindProperty(Property);
+	if (property == nullptr || property->Codec != Codec)
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("Property %s can not be reported for %s"), *Property.ToString(), *report_plan->Name);
+		return nullptr;
+	}
+
+	return property;
+}
+
+void UAnalyticsSession::ReleaseReport()
+{
+	if (report_plan == nullptr) return;
+
+	for (const FAnalyticsPropertyPlan& property : report_plan->Properties)
+	{
+		if (property.Codec == EAnalyticsPropertyCodec::Unsupported) continue;
+
+		property.Property->DestroyValue_InContainer(report_container);
+	}
+
+	report_plan = nullptr;
+	report_class = nullptr;
+}
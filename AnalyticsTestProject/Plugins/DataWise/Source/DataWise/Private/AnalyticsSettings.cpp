@@ -0,0 +1,13 @@
+#include "AnalyticsSettings.h"
+#include "DataWise.h"
+
+UAnalyticsSettings::UAnalyticsSettings()
+{
+	CategoryName = FName("Plugins");
+	SectionName = FName("DataWise");
+
+	// Locations of the object tracker, predicted per tracked object
+	FAnalyticsTrajectoryPacket object_trail;
+	object_trail.KeyProperty = FName("Name");
+	TrajectoryPackets.Add("BPEV_ObjectTrail_C", object_trail);
+}
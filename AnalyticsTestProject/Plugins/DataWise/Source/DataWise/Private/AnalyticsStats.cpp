@@ -0,0 +1,180 @@
+#include "AnalyticsStats.h"
+#include "DataWise.h"
+#include "Misc/ScopeLock.h"
+
+DEFINE_STAT(STAT_DataWiseEvents);
+DEFINE_STAT(STAT_DataWiseEventBytes);
+DEFINE_STAT(STAT_DataWiseSampledOut);
+DEFINE_STAT(STAT_DataWiseDropped);
+DEFINE_STAT(STAT_DataWiseQueueDepth);
+DEFINE_STAT(STAT_DataWiseSerialize);
+DEFINE_STAT(STAT_DataWiseFlush);
+
+#define rate_interval 1.0
+
+static int64 LoadCounter(volatile int64* counter)
+{
+	return FPlatformAtomics::InterlockedCompareExchange(counter, 0, 0);
+}
+
+const float FAnalyticsLatencyHistogram::bucket_bounds[FAnalyticsLatencyHistogram::bucket_count] = { 0.1f, 0.5f, 1.0f, 5.0f, 10.0f, 50.0f, 100.0f, TNumericLimits<float>::Max() };
+
+void FAnalyticsLatencyHistogram::Add(double seconds)
+{
+	float milliseconds = (float)(seconds * 1000.0);
+
+	for (int32 bucket = 0; bucket < bucket_count; bucket++)
+	{
+		if (milliseconds < bucket_bounds[bucket])
+		{
+			buckets[bucket].Increment();
+			return;
+		}
+	}
+}
+
+void FAnalyticsLatencyHistogram::Get(TArray<int32>& counts, TArray<float>& bounds) const
+{
+	counts.SetNum(bucket_count);
+	bounds.SetNum(bucket_count);
+
+	for (int32 bucket = 0; bucket < bucket_count; bucket++)
+	{
+		counts[bucket] = buckets[bucket].GetValue();
+		bounds[bucket] = bucket_bounds[bucket];
+	}
+}
+
+
+
+FAnalyticsStatsTracker::FAnalyticsStatsTracker()
+{
+	FMemory::Memzero((void*)blocks, sizeof(blocks));
+	rate_time = FPlatformTime::Seconds();
+}
+
+FAnalyticsStatsTracker::~FAnalyticsStatsTracker()
+{
+	for (int32 block = 0; block < block_count; block++)
+	{
+		FMemory::Free(blocks[block]);
+	}
+}
+
+FAnalyticsStatsTracker::FTypeCounters* FAnalyticsStatsTracker::GetCounters(uint32 type)
+{
+	uint32 block = type / block_size;
+	if (block >= block_count) return nullptr;
+
+	// Blocks are only ever set once, a plain read is enough once one is there
+	FTypeCounters* counters = blocks[block];
+	if (counters == nullptr)
+	{
+		FTypeCounters* allocated = (FTypeCounters*)FMemory::Malloc(sizeof(FTypeCounters) * block_size);
+		FMemory::Memzero(allocated, sizeof(FTypeCounters) * block_size);
+
+		// Another thread may have allocated the block in the meantime
+		counters = (FTypeCounters*)FPlatformAtomics::InterlockedCompareExchangePointer((void**)&blocks[block], allocated, nullptr);
+		if (counters == nullptr)
+		{
+			counters = allocated;
+		}
+		else
+		{
+			FMemory::Free(allocated);
+		}
+	}
+
+	return &counters[type % block_size];
+}
+
+void FAnalyticsStatsTracker::RegisterType(uint32 type, const FString& name)
+{
+	FScopeLock lock(&mutex);
+	rates.FindOrAdd(type).Name = name;
+}
+
+void FAnalyticsStatsTracker::RecordEvent(uint32 type, int32 bytes, uint32 serialize_cycles)
+{
+	INC_DWORD_STAT(STAT_DataWiseEvents);
+	INC_DWORD_STAT_BY(STAT_DataWiseEventBytes, bytes);
+
+	FTypeCounters* counters = GetCounters(type);
+	if (counters == nullptr) return;
+
+	FPlatformAtomics::InterlockedIncrement(&counters->Events);
+	FPlatformAtomics::InterlockedAdd(&counters->Bytes, (int64)bytes);
+	FPlatformAtomics::InterlockedAdd(&counters->SerializeCycles, (int64)serialize_cycles);
+}
+
+void FAnalyticsStatsTracker::RecordSampledOut(uint32 type)
+{
+	INC_DWORD_STAT(STAT_DataWiseSampledOut);
+
+	FTypeCounters* counters = GetCounters(type);
+	if (counters == nullptr) return;
+
+	FPlatformAtomics::InterlockedIncrement(&counters->SampledOut);
+}
+
+void FAnalyticsStatsTracker::GetStats(FAnalyticsSessionStats& stats)
+{
+	FScopeLock lock(&mutex);
+
+	// Rates are only updated once per interval, so polling every frame does not make them jump
+	double now = FPlatformTime::Seconds();
+	double elapsed = now - rate_time;
+	bool update_rates = elapsed >= rate_interval;
+	if (update_rates) rate_time = now;
+
+	stats.Events = 0;
+	stats.SampledOut = 0;
+	stats.EventsPerSecond = 0.0f;
+	stats.BytesPerSecond = 0.0f;
+	stats.PacketTypes.Reset();
+
+	for (int32 block = 0; block < block_count; block++)
+	{
+		FTypeCounters* counters = (FTypeCounters*)FPlatformAtomics::InterlockedCompareExchangePointer((void**)&blocks[block], nullptr, nullptr);
+		if (counters == nullptr) continue;
+
+		for (int32 slot = 0; slot < block_size; slot++)
+		{
+			uint32 type = block * block_size + slot;
+
+			int64 events = LoadCounter(&counters[slot].Events);
+			int64 bytes = LoadCounter(&counters[slot].Bytes);
+			int64 sampled_out = LoadCounter(&counters[slot].SampledOut);
+			int64 serialize_cycles = LoadCounter(&counters[slot].SerializeCycles);
+
+			FTypeRates* type_rates = rates.Find(type);
+			if (type_rates == nullptr)
+			{
+				if (events == 0 && sampled_out == 0) continue;
+				type_rates = &rates.Add(type);
+			}
+
+			if (update_rates)
+			{
+				type_rates->EventsPerSecond = (float)((events - type_rates->RateEvents) / elapsed);
+				type_rates->BytesPerSecond = (float)((bytes - type_rates->RateBytes) / elapsed);
+				type_rates->RateEvents = events;
+				type_rates->RateBytes = bytes;
+			}
+
+			FAnalyticsPacketTypeStats type_stats;
+			type_stats.Name = type_rates->Name;
+			type_stats.Events = (int32)FMath::Min<int64>(events, MAX_int32);
+			type_stats.SampledOut = (int32)FMath::Min<int64>(sampled_out, MAX_int32);
+			type_stats.EventsPerSecond = type_rates->EventsPerSecond;
+			type_stats.BytesPerSecond = type_rates->BytesPerSecond;
+			type_stats.SerializeTime = events > 0 ? (float)(FPlatformTime::ToMilliseconds64(serialize_cycles) * 1000.0 / events) : 0.0f;
+			stats.PacketTypes.Add(type_stats);
+
+			stats.Events = (int32)FMath::Min<int64>((int64)stats.Events + events, MAX_int32);
+			stats.SampledOut = (int32)FMath::Min<int64>((int64)stats.SampledOut + sampled_out, MAX_int32);
+			stats.EventsPerSecond += type_rates->EventsPerSecond;
+			stats.BytesPerSecond += type_rates->BytesPerSecond;
+		}
+	}
+}
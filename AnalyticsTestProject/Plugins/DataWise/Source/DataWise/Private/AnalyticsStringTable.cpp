@@ -0,0 +1,86 @@
+#include "AnalyticsStringTable.h"
+#include "DataWise.h"
+#include "AnalyticsCaptureFormat.h"
+#include "Serialization/MemoryWriter.h"
+
+// Longer strings rarely repeat, and the table is kept in memory and in the chunk index for the whole capture
+#define max_interned_length 64
+#define max_interned_strings 16384
+
+uint32 FAnalyticsStringTable::Intern(const FString& value)
+{
+	if (value.Len() > max_interned_length) return 0;
+
+	{
+		FRWScopeLock read_lock(lock, SLT_ReadOnly);
+		const uint32* found = indices.Find(value);
+		if (found != nullptr) return *found;
+	}
+
+	FRWScopeLock write_lock(lock, SLT_Write);
+
+	const uint32* found = indices.Find(value);
+	if (found != nullptr) return *found;
+
+	if (indices.Num() >= max_interned_strings || !output) return 0;
+
+	uint32 index = indices.Num() + 1;
+
+	// Definitions are registrations of id 0, emitted while holding the lock so they are queued in index order
+	TArray<uint8> definition;
+	FMemoryWriter definition_archive(definition);
+	uint32 control_type = 0;
+	uint32 register_id = 0;
+	FString definition_value = value;
+	FAnalyticsCaptureFormat::SerializeVarInt(definition_archive, control_type);
+	FAnalyticsCaptureFormat::SerializeVarInt(definition_archive, register_id);
+	FAnalyticsCaptureFormat::SerializeVarInt(definition_archive, index);
+	FAnalyticsCaptureFormat::SerializeString(definition_archive, definition_value);
+	output(definition);
+
+	indices.Add(value, index);
+	return index;
+}
+
+void FAnalyticsStringTable::Serialize(FArchive& archive, FString& value)
+{
+	uint32 index = archive.IsLoading() ? 0 : Intern(value);
+	FAnalyticsCaptureFormat::SerializeVarInt(archive, index);
+
+	if (index == 0)
+	{
+		FAnalyticsCaptureFormat::SerializeString(archive, value);
+		return;
+	}
+
+	if (archive.IsSaving()) return;
+
+	if (!strings.IsValidIndex(index - 1))
+	{
+		UE_LOG(AnalyticsLog, Error, TEXT("String %u is used before it is defined"), index);
+		archive.SetError();
+		return;
+	}
+
+	// Packets decoded by a cursor are reused, and mostly get the same strings as the packet before them
+	const FString& defined = strings[index - 1];
+	if (!value.Equals(defined, ESearchCase::CaseSensitive)) value = defined;
+}
+
+void FAnalyticsStringTable::ReadDefinition(FArchive& archive)
+{
+	uint32 index;
+	FString value;
+	FAnalyticsCaptureFormat::SerializeVarInt(archive, index);
+	FAnalyticsCaptureFormat::SerializeString(archive, value);
+
+	if (archive.IsError() || index == 0 || index > max_interned_strings)
+	{
+		archive.SetError();
+		return;
+	}
+
+	// Chunked captures repeat their definitions in the index
+	if (strings.Num() < (int32)index) strings.SetNum(index);
+	strings[index - 1] = MoveTemp(value);
+}
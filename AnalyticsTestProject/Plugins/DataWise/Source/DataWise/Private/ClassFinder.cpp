@@ -3,10 +3,46 @@
 #include "AssetRegistryModule.h"
 #include "UObject/UObjectIterator.h"
 #include "Async/Async.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/ThreadSingleton.h"
 
 FThreadSafeBool UClassFinder::working = false;
 TArray<UClass*> UClassFinder::threaded_result;
 
+// Subclasses by name for each base class that has been searched, and the names that were not found by that search
+struct FSubclassCache
+{
+	TMap<FString, TWeakObjectPtr<UClass>> Classes;
+	TSet<FString> Missing;
+
+	// Set when assets changed since the search, the classes are then only used by lookups that can not search
+	bool bOutdated = false;
+};
+
+// Nesting depth of FCachedClassLookupScope on a thread
+class FCachedClassLookupDepth : public TThreadSingleton<FCachedClassLookupDepth>
+{
+public:
+	int32 Depth = 0;
+};
+
+static FCriticalSection cache_mutex;
+static FCriticalSection threaded_mutex;
+static TMap<UClass*, FSubclassCache> subclass_cache;
+static TSet<UClass*> queued_searches;
+static FThreadSafeCounter cache_generation;
+
+FCachedClassLookupScope::FCachedClassLookupScope()
+{
+	FCachedClassLookupDepth::Get().Depth++;
+}
+
+FCachedClassLookupScope::~FCachedClassLookupScope()
+{
+	FCachedClassLookupDepth::Get().Depth--;
+}
+
+
 
 TArray<UClass*> UClassFinder::FindSubclasses(UClass* base)
 {
@@ -29,6 +65,174 @@ TArray<UClass*> UClassFinder::FindSubclasses(UClass* base)
 	return classes;
 }
 
+UClass* UClassFinder::FindSubclassByName(UClass* base, const FString& name)
+{
+	bool cached_only = !IsInGameThread() && FCachedClassLookupDepth::Get().Depth > 0;
+
+	{
+		FScopeLock lock(&cache_mutex);
+
+		FSubclassCache* cache = subclass_cache.Find(base);
+		if (cache != nullptr && !cache->bOutdated)
+		{
+			if (cache->Missing.Contains(name)) return nullptr;
+
+			TWeakObjectPtr<UClass>* found = cache->Classes.Find(name);
+			UClass* found_class = found != nullptr ? found->Get() : nullptr;
+			if (found_class != nullptr && !found_class->HasAnyClassFlags(CLASS_NewerVersionExists)) return found_class;
+
+			// The cache holds every subclass until assets change, a search would only find the same ones
+			if (found == nullptr)
+			{
+				cache->Missing.Add(name);
+				return nullptr;
+			}
+		}
+
+		if (cached_only)
+		{
+			// A replaced class or an outdated cache is searched for on the game thread without waiting for it, the class found before is used until then
+			UClass* previous_class = nullptr;
+			if (cache != nullptr && !cache->Missing.Contains(name))
+			{
+				TWeakObjectPtr<UClass>* found = cache->Classes.Find(name);
+				if (found != nullptr) previous_class = found->Get();
+			}
+
+			if (!queued_searches.Contains(base))
+			{
+				queued_searches.Add(base);
+
+				AsyncTask(ENamedThreads::GameThread, [base]()
+				{
+					{
+						FScopeLock search_lock(&cache_mutex);
+						queued_searches.Remove(base);
+					}
+
+					SearchSubclasses(base, FString());
+				});
+			}
+
+			return previous_class;
+		}
+	}
+
+	return SearchSubclasses(base, name);
+}
+
+UClass* UClassFinder::SearchSubclasses(UClass* base, const FString& name)
+{
+	// Searched without holding the lock, the blueprint search waits for the game thread which may be looking up a class as well
+	int32 generation = cache_generation.GetValue();
+	TArray<UClass*> found_classes = FindSubclasses(base);
+
+	FSubclassCache cache;
+	for (UClass* found_class : found_classes)
+	{
+		cache.Classes.Add(found_class->GetName(), found_class);
+	}
+
+	TWeakObjectPtr<UClass>* found = cache.Classes.Find(name);
+	UClass* result = found != nullptr ? found->Get() : nullptr;
+	if (result == nullptr) cache.Missing.Add(name);
+
+	FScopeLock lock(&cache_mutex);
+
+	// The search may have missed assets that were added while it ran
+	if (cache_generation.GetValue() != generation) return result;
+
+	// Names that were missing stay missing until the cache is invalidated, a rebuild for a replaced class does not bring any of them back
+	FSubclassCache* previous = subclass_cache.Find(base);
+	if (previous != nullptr && !previous->bOutdated)
+	{
+		for (const FString& missing : previous->Missing)
+		{
+			if (!cache.Classes.Contains(missing)) cache.Missing.Add(missing);
+		}
+	}
+
+	subclass_cache.Add(base, MoveTemp(cache));
+	return result;
+}
+
+void UClassFinder::InvalidateCache()
+{
+	FScopeLock lock(&cache_mutex);
+
+	for (TPair<UClass*, FSubclassCache>& cache : subclass_cache)
+	{
+		cache.Value.bOutdated = true;
+	}
+	cache_generation.Increment();
+}
+
+void UClassFinder::PrepareCache(UClass* base)
+{
+	{
+		FScopeLock lock(&cache_mutex);
+
+		FSubclassCache* cache = subclass_cache.Find(base);
+		if (cache != nullptr && !cache->bOutdated)
+		{
+			bool replaced = false;
+			for (const TPair<FString, TWeakObjectPtr<UClass>>& cached_class : cache->Classes)
+			{
+				UClass* found_class = cached_class.Value.Get();
+				if (found_class == nullptr || found_class->HasAnyClassFlags(CLASS_NewerVersionExists)) replaced = true;
+			}
+
+			if (!replaced) return;
+		}
+	}
+
+	SearchSubclasses(base, FString());
+}
+
+int32 UClassFinder::GetCacheGeneration()
+{
+	return cache_generation.GetValue();
+}
+
+void UClassFinder::InvalidateCache(const FAssetData& asset)
+{
+	// Only blueprints have a native parent, other assets can not add or remove a subclass
+	const FString* native_parent_path = asset.TagsAndValues.Find(TEXT("NativeParentClass"));
+	if (native_parent_path == nullptr) return;
+
+	UClass* native_parent = FindObject<UClass>(nullptr, *FPackageName::ExportTextPathToObjectPath(*native_parent_path));
+
+	FScopeLock lock(&cache_mutex);
+
+	bool invalidated = false;
+	for (auto iterator = subclass_cache.CreateIterator(); iterator; ++iterator)
+	{
+		// Blueprint bases can not be told apart by the native parent alone
+		UClass* base = iterator.Key();
+		if (native_parent != nullptr && !native_parent->IsChildOf(base) && base->ClassGeneratedBy == nullptr) continue;
+
+		iterator.Value().bOutdated = true;
+		invalidated = true;
+	}
+
+	if (invalidated) cache_generation.Increment();
+}
+
+void UClassFinder::BindCacheInvalidation(IAssetRegistry& registry)
+{
+	static bool bound = false;
+	if (bound) return;
+	bound = true;
+
+	registry.OnAssetAdded().AddLambda([](const FAssetData& asset) { InvalidateCache(asset); });
+	registry.OnAssetRemoved().AddLambda([](const FAssetData& asset) { InvalidateCache(asset); });
+	registry.OnAssetRenamed().AddLambda([](const FAssetData& asset, const FString&) { InvalidateCache(asset); });
+
+#if WITH_HOT_RELOAD
+	FCoreUObjectDelegates::RegisterHotReloadAddedClassesDelegate.AddLambda([](const TArray<UClass*>&) { InvalidateCache(); });
+#endif
+}
+
 TArray<UClass*> UClassFinder::FindSubclassesCPP(UClass* base)
 {
 	TArray<UClass*> classes;
@@ -55,6 +259,8 @@ TArray<UClass*> UClassFinder::FindSubclassesBP(UClass* base)
 	}
 	else 
 	{
+		// Captures are loaded on several threads at once, which share the flag and the result
+		FScopeLock lock(&threaded_mutex);
 		working = true;
 
 		AsyncTask(ENamedThreads::GameThread, [base]()
@@ -80,6 +286,7 @@ void UClassFinder::FindSubclassesBP_internal(UClass* base)
 
 	FAssetRegistryModule& AssetRegistryModule = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(FName("AssetRegistry"));
 	IAssetRegistry& AssetRegistry = AssetRegistryModule.Get();
+	BindCacheInvalidation(AssetRegistry);
 
 	TArray<FString> ContentPaths;
 	ContentPaths.Add(TEXT("/Game"));
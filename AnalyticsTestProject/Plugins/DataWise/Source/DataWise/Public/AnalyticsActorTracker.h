@@ -0,0 +1,109 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Tickable.h"
+#include "AnalyticsActorTracker.generated.h"
+
+class AActor;
+class UWorld;
+class UAnalyticsSession;
+class UAnalyticsPacket;
+
+// Introduces a tracked actor to a session, batches refer to it by Id
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsTrackedActor
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Actor Tracking")
+	int32 Id = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Actor Tracking")
+	FString Name;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Actor Tracking")
+	FString ClassName;
+};
+
+// Locations of all tracked actors sampled in one pass. Positions are stored in steps of Precision, three values per actor.
+// Actors tracked with their view also have a yaw and pitch in tenths of a degree in Views, in the order of ViewActors.
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsActorBatch
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Actor Tracking")
+	float Precision = 1.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Actor Tracking")
+	TArray<int32> Actors;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Actor Tracking")
+	TArray<int32> Locations;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Actor Tracking")
+	TArray<int32> ViewActors;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Actor Tracking")
+	TArray<int32> Views;
+};
+
+// Samples the location and view of every registered actor of a world in one batched tick, instead of a tracker tick per actor.
+// A pass over all actors starts every ActorTrackingInterval and is spread over several frames when it exceeds ActorTrackingBudget.
+// Every finished pass is reported as a single FAnalyticsActorBatch to each active session of the world.
+UCLASS()
+class DATAWISE_API UAnalyticsActorTracker : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+public:
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Analytics Actor Tracking", meta = (WorldContext = WorldContextObject))
+	static UAnalyticsActorTracker* GetActorTracker(UObject* WorldContextObject);
+
+	// Actors only need to be registered once, they are tracked in every session of the world until they are destroyed or unregistered
+	UFUNCTION(BlueprintCallable, Category = "Analytics Actor Tracking")
+	void TrackActor(AActor* Actor, bool bTrackView = false);
+
+	UFUNCTION(BlueprintCallable, Category = "Analytics Actor Tracking")
+	void UntrackActor(AActor* Actor);
+
+	// Locations of a batch packet, false if the packet is not a batch
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Analytics Actor Tracking")
+	static bool GetBatchLocations(UAnalyticsPacket* Packet, TArray<int32>& Actors, TArray<FVector>& Locations);
+
+	// View directions of a batch packet, false if the packet is not a batch
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Analytics Actor Tracking")
+	static bool GetBatchViews(UAnalyticsPacket* Packet, TArray<int32>& Actors, TArray<FVector>& Directions);
+
+	void Tick(float delta_time) override;
+	bool IsTickable() const override;
+	TStatId GetStatId() const override;
+
+private:
+	static void OnWorldCleanup(UWorld* world, bool session_ended, bool cleanup_resources);
+
+	void Sample(int32 index);
+	void Report();
+	void Remove(int32 index);
+
+	TWeakObjectPtr<UWorld> world;
+
+	// Registered actors as parallel arrays, sampled in index order
+	TArray<TWeakObjectPtr<AActor>> actors;
+	TArray<int32> ids;
+	TArray<bool> track_view;
+	TArray<FVector> locations;
+	TArray<FRotator> views;
+
+	int32 next_id = 1;
+
+	// Index the current pass continues at, INDEX_NONE while waiting for the next pass
+	int32 cursor = INDEX_NONE;
+	double pass_time = 0.0;
+
+	// Highest actor id introduced to each session
+	TMap<TWeakObjectPtr<UAnalyticsSession>, int32> introduced;
+
+	double interval;
+	double budget;
+	float precision;
+};
@@ -0,0 +1,287 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "HAL/CriticalSection.h"
+#include "AnalyticsAggregators.generated.h"
+
+class UAnalyticsSession;
+class UAnalyticsPacket;
+
+// Summary packets, reported by aggregators once per interval instead of an event per value.
+// Interval is the number of seconds the summary covers, it ends at the time of the packet.
+
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsCounterSummary
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	FString Name;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Interval = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	int32 Count = 0;
+};
+
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsGaugeSummary
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	FString Name;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Interval = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	int32 Samples = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Min = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Max = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Mean = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Last = 0.0f;
+};
+
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsHistogramSummary
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	FString Name;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Interval = 0.0f;
+
+	// 0 for equally sized buckets between RangeMin and RangeMax, 1 for logarithmic buckets, see UAnalyticsHistogram
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	uint8 Layout = 0;
+
+	// Lower bound of the first bucket, the resolution of logarithmic buckets
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float RangeMin = 0.0f;
+
+	// Upper bound of the last bucket, the number of significant bits of logarithmic buckets
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float RangeMax = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	int32 Samples = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Sum = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Min = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Max = 0.0f;
+
+	// Samples per bucket, logarithmic summaries leave out trailing empty buckets
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	TArray<int32> Buckets;
+};
+
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsGridSummary
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	FString Name;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float Interval = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	float CellSize = 0.0f;
+
+	// Cells that received samples, a cell covers CellX * CellSize up to (CellX + 1) * CellSize
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	TArray<int32> CellX;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	TArray<int32> CellY;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	TArray<int32> Counts;
+
+	// Sum of the values added to each cell
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Summary")
+	TArray<float> Values;
+};
+
+// Accumulates values in memory and reports a summary packet to its session once per interval.
+// Values can be added from any thread, summaries are reported on the game thread and when the session ends.
+UCLASS(Abstract, BlueprintType)
+class DATAWISE_API UAnalyticsAggregator : public UObject
+{
+	GENERATED_BODY()
+public:
+	void Initialize(UAnalyticsSession* session, const FString& name, float interval);
+
+	// Reports the summary of the current interval if it is due, or right away when forced
+	void Emit(double now, bool force);
+
+	// Called by the session every frame before Emit, for aggregators that sample engine state themselves
+	virtual void Tick(float delta_time) {}
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Analytics Aggregator")
+	FString GetAggregatorName() const { return name; }
+
+protected:
+	// Called with the mutex held, returns false if nothing was accumulated. The accumulated values are reset afterwards.
+	virtual bool Report(UAnalyticsSession* target, float covered) { return false; }
+
+	FString name;
+	FCriticalSection mutex;
+	TWeakObjectPtr<UAnalyticsSession> session;
+
+private:
+	double interval = 1.0;
+	double interval_start = 0.0;
+};
+
+UCLASS()
+class DATAWISE_API UAnalyticsCounter : public UAnalyticsAggregator
+{
+	GENERATED_BODY()
+public:
+	UFUNCTION(BlueprintCallable, Category = "Analytics Aggregator")
+	void Add(int32 Amount = 1);
+
+protected:
+	bool Report(UAnalyticsSession* target, float covered) override;
+
+private:
+	int32 count = 0;
+};
+
+UCLASS()
+class DATAWISE_API UAnalyticsGauge : public UAnalyticsAggregator
+{
+	GENERATED_BODY()
+public:
+	UFUNCTION(BlueprintCallable, Category = "Analytics Aggregator")
+	void Set(float Value);
+
+protected:
+	bool Report(UAnalyticsSession* target, float covered) override;
+
+private:
+	int32 samples = 0;
+	float min = 0.0f;
+	float max = 0.0f;
+	double sum = 0.0;
+	float last = 0.0f;
+};
+
+// Linear layout: equally sized buckets between RangeMin and RangeMax, values outside the range count towards the first or last bucket.
+// Logarithmic layout: values are counted in steps of the resolution, with 2^bits exact buckets followed by buckets that double in size
+// every 2^(bits - 1) buckets. This keeps the relative error below 2^(1 - bits) across any range, like an HDR histogram.
+UCLASS()
+class DATAWISE_API UAnalyticsHistogram : public UAnalyticsAggregator
+{
+	GENERATED_BODY()
+public:
+	void SetLinear(float range_min, float range_max, int32 bucket_count);
+	void SetLogarithmic(float resolution, int32 bits);
+
+	UFUNCTION(BlueprintCallable, Category = "Analytics Aggregator")
+	void Add(float Value);
+
+	// Value range of a bucket of a summary
+	static void GetBucketRange(const FAnalyticsHistogramSummary& summary, int32 bucket, float& lower, float& upper);
+
+protected:
+	bool Report(UAnalyticsSession* target, float covered) override;
+
+private:
+	int32 GetBucket(float value) const;
+
+	uint8 layout = 0;
+	float range_min = 0.0f;
+	float range_max = 1.0f;
+	int32 bits = 4;
+
+	TArray<int32> buckets;
+	int32 samples = 0;
+	double sum = 0.0;
+	float min = 0.0f;
+	float max = 0.0f;
+};
+
+// Counts samples per cell of a square grid in the XY plane, only cells that received samples are stored
+UCLASS()
+class DATAWISE_API UAnalyticsGrid : public UAnalyticsAggregator
+{
+	GENERATED_BODY()
+public:
+	void SetCellSize(float size) { cell_size = FMath::Max(size, KINDA_SMALL_NUMBER); }
+
+	UFUNCTION(BlueprintCallable, Category = "Analytics Aggregator")
+	void Add(FVector Location, float Value = 1.0f);
+
+protected:
+	bool Report(UAnalyticsSession* target, float covered) override;
+
+private:
+	struct FCell
+	{
+		int32 Count = 0;
+		float Value = 0.0f;
+	};
+
+	float cell_size = 100.0f;
+	TMap<FIntPoint, FCell> cells;
+};
+
+UCLASS()
+class DATAWISE_API UAnalyticsAggregatorTools : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+public:
+	UFUNCTION(BlueprintCallable, Category = "Analytics Aggregator")
+	static UAnalyticsCounter* CreateCounter(UAnalyticsSession* Session, FString Name, float Interval = 1.0f);
+
+	UFUNCTION(BlueprintCallable, Category = "Analytics Aggregator")
+	static UAnalyticsGauge* CreateGauge(UAnalyticsSession* Session, FString Name, float Interval = 1.0f);
+
+	UFUNCTION(BlueprintCallable, Category = "Analytics Aggregator")
+	static UAnalyticsHistogram* CreateHistogram(UAnalyticsSession* Session, FString Name, float Min, float Max, int32 Buckets = 32, float Interval = 10.0f);
+
+	// Histogram for values that span several orders of magnitude, such as frame times. Bits sets the precision, 4 keeps values within 12.5%.
+	UFUNCTION(BlueprintCallable, Category = "Analytics Aggregator")
+	static UAnalyticsHistogram* CreateLogHistogram(UAnalyticsSession* Session, FString Name, float Resolution = 0.1f, int32 Bits = 4, float Interval = 10.0f);
+
+	UFUNCTION(BlueprintCallable, Category = "Analytics Aggregator")
+	static UAnalyticsGrid* CreateGrid(UAnalyticsSession* Session, FString Name, float CellSize = 100.0f, float Interval = 10.0f);
+
+	// Summary data of a loaded packet, false if the packet holds a different summary or a regular event
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Analytics Summary")
+	static bool GetCounterSummary(UAnalyticsPacket* Packet, FAnalyticsCounterSummary& Summary);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Analytics Summary")
+	static bool GetGaugeSummary(UAnalyticsPacket* Packet, FAnalyticsGaugeSummary& Summary);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Analytics Summary")
+	static bool GetHistogramSummary(UAnalyticsPacket* Packet, FAnalyticsHistogramSummary& Summary);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Analytics Summary")
+	static bool GetGridSummary(UAnalyticsPacket* Packet, FAnalyticsGridSummary& Summary);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Analytics Summary")
+	static void GetHistogramBucketRange(const FAnalyticsHistogramSummary& Summary, int32 Bucket, float& Lower, float& Upper);
+};
@@ -3,6 +3,7 @@
 #include "AnalyticsCapture.generated.h"
 
 class UAnalyticsCaptureManagerConnection;
+class FAnalyticsPacketTable;
 
 USTRUCT(BlueprintType)
 struct DATAWISE_API FAnalyticsCaptureInfo
@@ -13,6 +14,10 @@ struct DATAWISE_API FAnalyticsCaptureInfo
 	TWeakObjectPtr<UAnalyticsCaptureManagerConnection> Source;
 	TMap<FString, FString> Meta;
 
+	// Path of the multiplexed capture and id of the stream within it, empty for captures stored as files of their own
+	FString Container;
+	uint32 Stream = 0;
+
 	bool operator==(FAnalyticsCaptureInfo const& other) const
 	{
 		return Name.Equals(other.Name);
@@ -34,4 +39,21 @@ public:
 
 	UPROPERTY(BlueprintReadOnly)
 	TArray<UAnalyticsPacket*> packets;
+
+	// Columnar copy of the packets, one table per class or struct. Filled by UAnalyticsCaptureManager::DeserializeCaptureTables
+	// without creating packet objects, or from packets by BuildTables.
+	TMap<UStruct*, FAnalyticsPacketTable*> Tables;
+
+	// nullptr if the capture has no packets of the type
+	const FAnalyticsPacketTable* GetTable(UStruct* type) const;
+
+	template<typename T>
+	const FAnalyticsPacketTable* GetTable() const { return GetTable(T::StaticStruct()); }
+
+	FAnalyticsPacketTable& FindOrAddTable(UStruct* type);
+
+	// Adds every packet to the table of its type and sorts the tables by time
+	void BuildTables();
+
+	void BeginDestroy() override;
 };
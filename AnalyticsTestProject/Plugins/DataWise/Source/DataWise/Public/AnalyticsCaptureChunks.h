@@ -0,0 +1,130 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "Serialization/MemoryWriter.h"
+#include "AnalyticsSettings.h"
+#include "AnalyticsPacketPlan.h"
+
+#define capture_frame_magic 0x46435744 // "DWCF"
+#define capture_index_magic 0x49435744 // "DWCI"
+
+enum class EAnalyticsChunkCompression : uint8
+{
+	None,
+	Zlib
+};
+
+// Stored in front of every chunk of a capture
+struct DATAWISE_API FAnalyticsFrameHeader
+{
+	uint32 StoredSize = 0;
+	uint32 RawSize = 0;
+	EAnalyticsChunkCompression Compression = EAnalyticsChunkCompression::None;
+	uint32 RecordCount = 0;
+	int64 FirstTimestamp = 0;
+	int64 LastTimestamp = 0;
+	uint32 Crc = 0;
+
+	// Returns false when the archive is not positioned at a frame
+	bool Serialize(FArchive& archive);
+};
+
+struct DATAWISE_API FAnalyticsChunkInfo
+{
+	// Position of the frame header in the capture
+	int64 Offset = 0;
+	int64 FirstTimestamp = 0;
+	int64 LastTimestamp = 0;
+	uint32 RecordCount = 0;
+
+	// Records per packet type id
+	TMap<uint32, uint32> TypeCounts;
+
+	friend FArchive& operator<<(FArchive& archive, FAnalyticsChunkInfo& chunk);
+};
+
+// Groups records into compressed chunks and appends the chunk index when finished.
+// Each chunk is a self contained record stream of format 2 with time deltas starting at 0, every registration is also kept in the index so chunks can be read out of order.
+// Every lane collects its own chunk, so chunks of different lanes interleave in the capture and their time ranges may overlap.
+// Predicted vectors of a record are replaced by their residuals against the records before it in the same chunk, see FAnalyticsVectorPredictor.
+class DATAWISE_API FAnalyticsChunkWriter
+{
+public:
+	// Writes the capture header, the archive is not owned
+	FAnalyticsChunkWriter(FArchive* archive);
+
+	// Registrations are added to the pending chunk of every lane, so each lane can be recovered without the others
+	void WriteControl(const uint8* record, int32 size);
+
+	// The payload is encoded by FAnalyticsPacketPlan::SerializeCompact
+	void WriteRecord(uint32 type, int64 timestamp, const uint8* payload, int32 size, EAnalyticsLane lane = EAnalyticsLane::Bulk);
+
+	// Stores the pending chunks of all lanes
+	void FlushChunk();
+	void FlushChunk(EAnalyticsLane lane);
+
+	bool HasPendingRecords(EAnalyticsLane lane) const { return lanes[(int32)lane].Chunk.RecordCount != 0; }
+
+	// Stores the pending chunk followed by the index, nothing can be written afterwards
+	void Finish();
+
+	int64 GetWrittenSize() const { return written_size; }
+
+	// Every registration written so far, a new segment starts with these
+	const TArray<uint8>& GetRegistrations() const { return registrations; }
+
+private:
+	struct FLane
+	{
+		FLane() : Archive(Data) {}
+
+		TArray<uint8> Data;
+		FMemoryWriter Archive;
+		FAnalyticsChunkInfo Chunk;
+		int64 LastTimestamp = 0;
+		FAnalyticsVectorPredictor Predictor;
+	};
+
+	// Learns which types have predicted vectors from the schemas of the registrations in a control record
+	void ReadRegistrations(const uint8* record, int32 size);
+
+	static const int32 lane_count = 2;
+
+	FArchive* archive;
+
+	int32 chunk_size;
+	bool compress;
+	bool finished = false;
+
+	FLane lanes[lane_count];
+
+	TArray<FAnalyticsChunkInfo> chunks;
+	TArray<uint8> registrations;
+	TArray<uint8> compressed;
+
+	// Predicted coordinates of every record, per packet type id that has any
+	TMap<uint32, int32> predicted_types;
+
+	int64 written_size = 0;
+};
+
+class DATAWISE_API FAnalyticsChunkIndex
+{
+public:
+	// Reads the index from the end of the capture, fails for captures that were not finished
+	bool Load(FArchive& archive);
+
+	// Rebuilds the chunk list by walking the frames from the current position, used to recover captures that were not finished.
+	// Stops at the first torn frame, registrations are recovered from the chunks themselves.
+	void Scan(FArchive& archive);
+
+	// Reads the frame at the offset of chunk
+	static bool ReadChunk(FArchive& archive, const FAnalyticsChunkInfo& chunk, FAnalyticsFrameHeader& header, TArray<uint8>& stored);
+
+	// Verifies and decompresses a chunk, safe to call from any thread
+	static bool Decompress(const FAnalyticsFrameHeader& header, const TArray<uint8>& stored, TArray<uint8>& raw);
+
+	TArray<FAnalyticsChunkInfo> Chunks;
+
+	// Every class registration record of the capture
+	TArray<uint8> Registrations;
+};
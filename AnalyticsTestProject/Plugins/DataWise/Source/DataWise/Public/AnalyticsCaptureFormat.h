@@ -0,0 +1,43 @@
+#pragma once
+#include "CoreMinimal.h"
+
+// Captures from version 2 on start with the magic and version, version 1 captures start with a class registration (id 0)
+#define capture_format_magic 0x50435744 // "DWCP"
+// Version 2 is a plain record stream, version 3 groups the same records into compressed chunks followed by a chunk index.
+// Version 4 prefixes the schema of a registration with its hash and size.
+// Version 5 adds flags to every property of a schema, vectors flagged as predicted are stored as residuals against the records before them in the chunk.
+// Version 6 stores string properties by index into definitions, which are registrations of id 0 (see FAnalyticsStringTable).
+#define capture_format_version 6
+
+// Timestamps are stored as microseconds since the start of the session
+#define capture_time_resolution 1000000.0
+
+// Variable length primitives of the compact capture format, all of them read or write depending on the direction of the archive
+class DATAWISE_API FAnalyticsCaptureFormat
+{
+public:
+	static void WriteHeader(FArchive& archive);
+
+	// Returns the format version of the capture and positions the archive at the first record, 0 if the version is not supported
+	static uint32 ReadHeader(FArchive& archive);
+
+	// LEB128, 7 bits per byte
+	static void SerializeVarInt(FArchive& archive, uint64& value);
+	static void SerializeVarInt(FArchive& archive, uint32& value);
+
+	// Zigzag mapped to varint so small negative values stay small
+	static void SerializeZigZag(FArchive& archive, int64& value);
+	static void SerializeZigZag(FArchive& archive, int32& value);
+
+	// Varint length followed by UTF-8 characters
+	static void SerializeString(FArchive& archive, FString& value);
+
+	// Type id followed by the time since the previous record, for every record except class registrations
+	static void WriteRecordHeader(FArchive& archive, uint32 type, int64 time_delta);
+
+	// Captures continue in Name.cap.001, Name.cap.002, ... once a segment reaches its size limit
+	static FString GetSegmentPath(const FString& capture_path, int32 segment);
+
+	static int64 ToTimestamp(double seconds) { return (int64)(seconds * capture_time_resolution); }
+	static double ToSeconds(int64 timestamp) { return timestamp / capture_time_resolution; }
+};
@@ -7,6 +7,7 @@
 #include "AnalyticsCaptureManager.generated.h"
 
 class UAnalyticsCaptureManagerConnection;
+class FAnalyticsPacketCursor;
 
 UCLASS()
 class DATAWISE_API UAnalyticsCaptureManager : public UObject
@@ -19,11 +20,29 @@ public:
 	UFUNCTION(BLUEPRINTCALLABLE)
 	virtual UAnalyticsCapture* DeserializeCapture(FAnalyticsCaptureInfo info) { return nullptr; }
 
+	// Streams the packets of a capture without loading it, nullptr if the capture can not be opened or the manager does not support it
+	virtual FAnalyticsPacketCursor* OpenCursor(FAnalyticsCaptureInfo info, double start_time, double end_time) { return nullptr; }
+
+	// Loads the packets of a capture into its tables only, through a cursor so no packet objects are created.
+	// nullptr if the capture can not be streamed. root adds the capture to the root set as soon as it is created.
+	UAnalyticsCapture* DeserializeCaptureTables(FAnalyticsCaptureInfo info, double start_time = 0.0, double end_time = TNumericLimits<double>::Max(), bool root = false);
+
 	UFUNCTION(BLUEPRINTCALLABLE)
 	virtual TArray<FAnalyticsCaptureInfo> FindCaptures() { return TArray<FAnalyticsCaptureInfo>(); }
 
 	virtual void DeleteStoredCapture(FAnalyticsCaptureInfo info) { };
 
+	// Raw file access used by the uploader, files are named like local capture files (Name.cap, Name.cap.001, Name.meta)
+
+	// Size in bytes of a stored file, 0 if it does not exist and -1 if it could not be determined
+	virtual int64 GetStoredFileSize(const FString& file) { return -1; }
+
+	// Writes data at offset, 0 replaces the file and any other offset has to be the current size of the file
+	virtual bool WriteStoredFile(const FString& file, int64 offset, const uint8* data, int32 size) { return false; }
+
+	// Replaces new_file if it exists
+	virtual bool RenameStoredFile(const FString& file, const FString& new_file) { return false; }
+
 	TWeakObjectPtr<UAnalyticsCaptureManagerConnection> Connection;
 };
 
@@ -59,6 +78,16 @@ public:
 
 	static void CacheCapture(FAnalyticsCaptureInfo info, UAnalyticsCaptureManager* source);
 
+	// Uploads finished captures in the background, if enabled in the project settings
+	UFUNCTION(BlueprintCallable, Category = "Capture Upload")
+	static void StartCaptureUploads();
+
+	UFUNCTION(BlueprintCallable, Category = "Capture Upload")
+	static void SetCaptureUploadsPaused(bool Paused);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Capture Upload")
+	static int32 GetPendingCaptureUploads();
+
 	static void LoadCaptureManagerConnections();
 	static void SaveCaptureManagerConnections();
 	static TArray<UAnalyticsCaptureManagerConnection*> GetCaptureManagerConnections();
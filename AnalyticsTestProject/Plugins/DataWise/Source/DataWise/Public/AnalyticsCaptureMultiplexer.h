@@ -0,0 +1,136 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "Serialization/Archive.h"
+
+#define multiplex_magic 0x584D5744 // "DWMX"
+#define multiplex_version 1
+#define multiplex_block_magic 0x42535744 // "DWSB"
+#define multiplex_index_magic 0x49535744 // "DWSI"
+
+// Multiplexed captures are stored next to regular captures with this extension
+#define multiplex_extension ".mcap"
+
+enum class EAnalyticsStreamBlock : uint8
+{
+	// Name of the stream
+	Open,
+
+	// Next bytes of the capture of the stream
+	Data,
+
+	// Meta data of the stream, replaces earlier meta blocks
+	Meta,
+
+	Close
+};
+
+struct DATAWISE_API FAnalyticsStreamInfo
+{
+	uint32 Id = 0;
+	FString Name;
+	TMap<FString, FString> Meta;
+
+	// Offsets of the data blocks of this stream in order
+	TArray<int64> Blocks;
+
+	friend FArchive& operator<<(FArchive& archive, FAnalyticsStreamInfo& stream);
+};
+
+// Single file that interleaves the captures of many sessions, so a dedicated server does not keep a file open per player.
+// Every stream is a complete capture cut into blocks, joining the blocks of a stream gives the same bytes as a capture written to its own file.
+// The file ends with the block list of every stream, captures that were not closed are recovered by walking the blocks.
+class DATAWISE_API FAnalyticsCaptureMultiplexer
+{
+public:
+	// Archive for the capture of a new stream, the container is created with the first stream and finished when the last one is closed.
+	// The archive is owned by the caller, closing it closes the stream. Names of streams need not be unique, container and stream identify it.
+	static FArchive* CreateStreamWriter(const FString& name, FString& container, uint32& stream);
+
+	// Stored with the stream, readers expose it as the meta data of the capture
+	static void SetStreamMeta(const FString& container, uint32 stream, const TMap<FString, FString>& meta);
+
+	// Lists the streams of a container, false if it is not a multiplexed capture
+	static bool LoadStreams(FArchive& archive, TArray<FAnalyticsStreamInfo>& streams);
+
+	// True while sessions are written into the container at path
+	static bool IsWriting(const FString& path);
+
+	void WriteBlock(uint32 stream, EAnalyticsStreamBlock type, const uint8* data, int32 size);
+	void CloseStream(uint32 stream);
+
+private:
+	friend class FAnalyticsStreamReader;
+
+	FAnalyticsCaptureMultiplexer(FArchive* archive, const FString& path);
+
+	void Finish();
+
+	static bool ReadBlockHeader(FArchive& archive, uint32& stream, EAnalyticsStreamBlock& type, uint32& size);
+
+	FArchive* archive;
+	FString path;
+
+	TMap<uint32, FAnalyticsStreamInfo> streams;
+	uint32 next_stream_id = 1;
+	int32 open_streams = 0;
+};
+
+// Write end of a stream, buffers what the capture writer stores and hands it to the container in blocks
+class DATAWISE_API FAnalyticsStreamWriter : public FArchive
+{
+public:
+	FAnalyticsStreamWriter(FAnalyticsCaptureMultiplexer* multiplexer, uint32 stream);
+	~FAnalyticsStreamWriter();
+
+	void Serialize(void* data, int64 size) override;
+	int64 Tell() override { return position; }
+	int64 TotalSize() override { return position; }
+	void Seek(int64 new_position) override;
+	void Flush() override;
+	bool Close() override;
+
+	FString GetArchiveName() const override { return TEXT("FAnalyticsStreamWriter"); }
+
+private:
+	FAnalyticsCaptureMultiplexer* multiplexer;
+	uint32 stream;
+
+	TArray<uint8> buffer;
+	int64 position = 0;
+	bool closed = false;
+};
+
+// Read end of a stream, reads the capture of the stream from its blocks in the container as if it was a file of its own.
+// Only the block list is kept in memory, so a cursor over a stream holds no more than over a regular capture.
+class DATAWISE_API FAnalyticsStreamReader : public FArchive
+{
+public:
+	// Takes ownership of the container archive. A stream ends before its first corrupted block.
+	FAnalyticsStreamReader(FArchive* container, const FAnalyticsStreamInfo& stream);
+	~FAnalyticsStreamReader();
+
+	void Serialize(void* data, int64 size) override;
+	int64 Tell() override { return position; }
+	int64 TotalSize() override { return size; }
+	void Seek(int64 new_position) override { position = new_position; }
+
+	FString GetArchiveName() const override { return TEXT("FAnalyticsStreamReader"); }
+
+private:
+	struct FBlock
+	{
+		// Data of the block in the container
+		int64 Offset = 0;
+
+		// Position of the data in the stream
+		int64 Position = 0;
+		int64 Size = 0;
+	};
+
+	FArchive* container;
+	TArray<FBlock> blocks;
+	int32 current_block = 0;
+
+	int64 position = 0;
+	int64 size = 0;
+};
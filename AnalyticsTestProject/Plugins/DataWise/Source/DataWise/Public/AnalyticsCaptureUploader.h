@@ -0,0 +1,82 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter64.h"
+
+class UAnalyticsSettings;
+class UAnalyticsCaptureManager;
+class UAnalyticsCaptureManagerConnection;
+
+// Moves finished captures to the capture manager configured under Upload in the project settings.
+// Files are sent as stored on disk by a background thread, without loading the capture. An interrupted file continues
+// where the destination left off, and is only given its final name once it is complete.
+class DATAWISE_API FAnalyticsCaptureUploader : public FRunnable
+{
+public:
+	// Starts the uploader if uploads are enabled and queues every finished capture that is found on disk. Game thread only.
+	static void Start();
+
+	// Queues the files of a capture that has been closed (segments, then meta data). Starts the uploader if needed.
+	static void QueueCapture(const FString& name);
+
+	// Queues a single file, such as a multiplexed capture that has been finished
+	static void QueueFile(const FString& path);
+
+	// Holds uploads after the current block, for example while a match is played
+	static void SetPaused(bool paused);
+
+	// Number of files that have not been uploaded yet
+	static int32 GetPendingFiles();
+
+	// Bytes sent since the uploader was started
+	static int64 GetUploadedBytes();
+
+	uint32 Run() override;
+	void Stop() override;
+
+private:
+	struct FPendingFile
+	{
+		FString Path;
+		int32 Attempts = 0;
+		double RetryTime = 0.0;
+	};
+
+	enum class EUploadResult : uint8
+	{
+		Done,
+		Failed,
+		Interrupted
+	};
+
+	FAnalyticsCaptureUploader(const UAnalyticsSettings* settings, UAnalyticsCaptureManagerConnection* connection);
+	~FAnalyticsCaptureUploader();
+
+	static FAnalyticsCaptureUploader* GetInstance();
+	static void Shutdown();
+
+	void Queue(const FString& path);
+	bool IsHeld();
+	EUploadResult Upload(const FString& path);
+	void Throttle(int32 size, double start);
+	void Disconnect();
+
+	UAnalyticsCaptureManagerConnection* connection;
+	UAnalyticsCaptureManager* destination = nullptr;
+
+	TArray<FPendingFile> pending;
+	FCriticalSection pending_mutex;
+
+	int32 retries;
+	double retry_delay;
+	int64 bandwidth;
+	bool pause_during_sessions;
+	bool delete_uploaded;
+
+	FRunnableThread* thread = nullptr;
+	FEvent* wake_event = nullptr;
+	FThreadSafeBool should_stop;
+
+	FThreadSafeCounter64 uploaded_bytes;
+};
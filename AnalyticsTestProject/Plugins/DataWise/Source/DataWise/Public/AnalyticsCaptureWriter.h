@@ -0,0 +1,254 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "Containers/Queue.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/ThreadSingleton.h"
+#include "AnalyticsSettings.h"
+#include "AnalyticsStats.h"
+
+// Raw flight recorder state written by a crash handler, turned into a capture by the next run
+#define crash_dump_extension ".crashdump"
+
+class FAnalyticsChunkWriter;
+class IFileHandle;
+struct FLocalPacketType;
+struct FAnalyticsSamplingState;
+
+// Single producer, single consumer ring of length prefixed records.
+// The producer may also discard the oldest record to make room, which races with the consumer through a compare exchange on the read position.
+class DATAWISE_API FAnalyticsRecordBuffer
+{
+public:
+	FAnalyticsRecordBuffer(uint32 capacity);
+
+	// The producer claims the buffer around every push. The consumer can only retire it while it is not claimed, which frees the ring until Revive().
+	bool Claim();
+	void Release();
+	bool Retire();
+	bool Revive();
+	bool IsRetired() const;
+
+	// True once nothing was pushed or left to pop for duration seconds, only called by the consumer
+	bool IsIdleFor(double now, double duration);
+
+	bool Push(const uint8* header, uint32 header_size, const uint8* payload, uint32 payload_size);
+	bool Pop(TArray<uint8>& record);
+
+	// Copies the first size bytes of the oldest record without removing it
+	bool Peek(uint8* destination, uint32 size) const;
+	bool DiscardOldest();
+
+	// Visits every record from oldest to newest without removing them, only safe while nothing is popped or discarded
+	void ForEachRecord(TFunctionRef<void(const TArray<uint8>& record)> visitor) const;
+
+	// Bytes of all records from oldest to newest, in two parts when they wrap around the end of the ring
+	void GetBytes(const uint8*& first, uint64& first_size, const uint8*& second, uint64& second_size) const;
+
+	bool IsEmpty() const;
+	uint64 GetUsed() const;
+	uint64 GetCapacity() const { return capacity; }
+
+private:
+	void ReadBytes(int64 position, uint8* destination, uint32 size) const;
+	void WriteBytes(int64 position, const uint8* source, uint32 size);
+
+	TArray<uint8> data;
+	uint64 capacity;
+	uint64 mask;
+
+	volatile int64 read_position = 0;
+	volatile int64 write_position = 0;
+	volatile int32 state = 0;
+
+	int64 idle_position = -1;
+	double idle_since = 0.0;
+};
+
+// Per thread state of the reporting path
+class DATAWISE_API FAnalyticsThreadContext : public TThreadSingleton<FAnalyticsThreadContext>
+{
+public:
+	// Scratch space to encode events in
+	TArray<uint8> Payload;
+
+	// Buffer of the writer this thread reported to last
+	uint32 WriterId = 0;
+	FAnalyticsRecordBuffer* Buffer = nullptr;
+
+	struct FReportedType
+	{
+		const FLocalPacketType* Type = nullptr;
+
+		// nullptr when every event of the type is kept
+		FAnalyticsSamplingState* Sampling = nullptr;
+	};
+
+	struct FSessionTypes
+	{
+		int32 SamplingGeneration = -1;
+		TMap<UStruct*, FReportedType> Types;
+	};
+
+	// Packet types per session id, resolved once so reporting does not take a lock of the session
+	TMap<uint32, FSessionTypes> Sessions;
+
+	// Count of ended sessions when Sessions was last checked against the active ones
+	int32 EndedSessions = 0;
+};
+
+class DATAWISE_API FAnalyticsCaptureWriter : public FRunnable
+{
+public:
+	// Takes ownership of the archive, which is closed and deleted by Close(). Later segments are created next to path, an empty path keeps a single segment.
+	// Timestamps are relative to start_time, which is used to decide when records of all threads can be merged.
+	FAnalyticsCaptureWriter(FArchive* archive, const FString& path, double start_time, const UAnalyticsSettings* settings);
+
+	// Flight recorder, keeps the most recent records in memory within the configured duration and size and writes nothing until Dump() is called
+	FAnalyticsCaptureWriter(double start_time, const UAnalyticsSettings* settings);
+	~FAnalyticsCaptureWriter();
+
+	// Records that later records depend on, these are never dropped and stored as is
+	void WriteControl(const TArray<uint8>& record);
+
+	// Packet properties, the record header is added when the record is stored so time deltas stay valid when records are dropped.
+	// Can be called from any thread, every thread has its own buffer and the writer merges them in timestamp order.
+	void WriteRecord(uint32 type, int64 timestamp, const TArray<uint8>& payload, EAnalyticsLane lane = EAnalyticsLane::Bulk);
+
+	// Record reported after newer records, like a reservoir sample. Delayed records are merged with the records of all threads in timestamp order.
+	void WriteDelayedRecord(uint32 type, int64 timestamp, const TArray<uint8>& payload);
+
+	// Records at or after timestamp are not merged until the hold moves, as delayed records may still precede them
+	void SetMergeHold(int64 timestamp);
+
+	// Stores all pending records and the chunk index, then closes the archive
+	void Close();
+
+	// Writes the records a flight recorder holds to a new capture at path, records are kept so later dumps include them as well.
+	// Records that are still buffered are stored first, so the dump includes everything reported before the call.
+	bool Dump(const FString& path);
+
+	// Opens the file WriteCrashDump() writes to. It is opened up front so a crash does not need to create it, and removed again when the writer is destroyed without a crash.
+	void OpenCrashDump(const FString& path);
+
+	// Writes the records of a flight recorder as they are in memory, including those still buffered, to the file opened by OpenCrashDump().
+	// Nothing is allocated, compressed or waited on, state guarded by a lock that is held elsewhere is skipped. Meant to be called from a crash handler.
+	void WriteCrashDump();
+
+	// Turns a file written by WriteCrashDump() into a capture at capture_path
+	static bool RecoverCrashDump(const FString& dump_path, const FString& capture_path);
+
+	bool IsFlightRecorder() const { return recording != nullptr; }
+
+	// Size of all segments on disk, or of the records in memory for a flight recorder
+	int64 GetWrittenSize() const { return written_size.GetValue(); }
+	int32 GetDroppedCount() const { return dropped_count.GetValue(); }
+
+	// Bytes of records that are waiting to be stored
+	int64 GetQueueDepth();
+	const FAnalyticsLatencyHistogram& GetFlushLatency() const { return flush_latency; }
+
+	uint32 Run() override;
+	void Stop() override;
+
+private:
+	void Start(const UAnalyticsSettings* settings);
+
+	// Buffer of the calling thread, claimed until it is released again
+	FAnalyticsRecordBuffer* ClaimThreadBuffer();
+	void RetireIdleBuffers();
+
+	void Drain(bool all);
+	void DrainControl();
+	void Store(const TArray<uint8>& record);
+	void StoreRecord(uint32 type, int64 timestamp, const uint8* payload, int32 size, EAnalyticsLane lane);
+
+	void FlushIfDue();
+	void RotateSegment();
+	void UpdateWrittenSize();
+	void CountDropped();
+
+	void Record(const uint8* header, const uint8* payload, int32 size);
+
+	void WriteCrashSection(uint8 kind, uint64 size);
+	void WriteCrashBuffer(const FAnalyticsRecordBuffer& buffer);
+
+	FArchive* archive = nullptr;
+	FAnalyticsChunkWriter* chunk_writer = nullptr;
+
+	// Flight recorder state, registrations are kept apart so they are never discarded
+	FAnalyticsRecordBuffer* recording = nullptr;
+	TArray<uint8> recording_registrations;
+	int64 recording_duration = 0;
+	uint64 recording_size = 0;
+	FCriticalSection recording_mutex;
+
+	IFileHandle* crash_file = nullptr;
+	FString crash_path;
+	bool crash_dumped = false;
+
+	FString path;
+	int32 segment = 0;
+	int64 segment_size;
+	int64 finished_segments_size = 0;
+
+	double flush_interval;
+	double last_flush_time;
+
+	// Critical records are flushed within this many seconds of being stored
+	double critical_latency;
+	double critical_pending_time = 0.0;
+
+	uint32 id;
+	double start_time = 0.0;
+	int64 merge_window;
+	uint32 buffer_size;
+	bool threaded;
+
+	// Buffers of every reporting thread, the writer thread works on a copy of those that are not retired, refreshed when threads are added or retired
+	TMap<uint32, FAnalyticsRecordBuffer*> buffers;
+	FCriticalSection buffers_mutex;
+	FThreadSafeCounter buffers_version;
+	TArray<FAnalyticsRecordBuffer*> merge_buffers;
+	int32 merge_buffers_version = -1;
+
+	struct FDelayedRecord
+	{
+		uint32 Type = 0;
+		int64 Timestamp = 0;
+		TArray<uint8> Payload;
+
+		bool operator<(const FDelayedRecord& other) const { return Timestamp < other.Timestamp; }
+	};
+
+	// Heap ordered by timestamp
+	TArray<FDelayedRecord> delayed_records;
+	FCriticalSection delayed_mutex;
+	FThreadSafeCounter delayed_count;
+	FDelayedRecord drain_delayed;
+
+	volatile int64 merge_hold = MAX_int64;
+
+	TQueue<TArray<uint8>, EQueueMode::Mpsc> control_queue;
+	EAnalyticsBackpressurePolicy policy;
+
+	// Held while records are stored, by the writer thread or by the reporting threads when there is none
+	FCriticalSection store_mutex;
+
+	FRunnableThread* thread = nullptr;
+	FEvent* wake_event = nullptr;
+	FThreadSafeBool should_stop;
+
+	// Triggered after every drain, reporting threads wait on it while their buffer is full
+	FEvent* drain_event = nullptr;
+
+	FThreadSafeCounter64 written_size;
+	FThreadSafeCounter dropped_count;
+	FAnalyticsLatencyHistogram flush_latency;
+
+	TArray<uint8> drain_record;
+	TArray<uint8> drain_control;
+};
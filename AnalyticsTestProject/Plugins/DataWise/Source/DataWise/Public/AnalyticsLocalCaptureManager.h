@@ -2,11 +2,42 @@
 #include "DataWise.h"
 #include "AnalyticsCaptureManager.h"
 #include "AnalyticsPacket.h"
+#include "AnalyticsPacketPlan.h"
+#include "AnalyticsCaptureChunks.h"
+#include "AnalyticsStringTable.h"
+#include "AnalyticsStats.h"
+#include "AnalyticsCaptureMultiplexer.h"
 #include "AnalyticsLocalCaptureManager.generated.h"
 
 typedef uint32 PacketTypeIndex;
 typedef uint32 PacketPropertyCount;
 
+struct FLocalPacketType
+{
+	PacketTypeIndex Index = 0;
+	UClass* Class = nullptr;
+
+	// Set for packets reported as USTRUCT, these carry their time after the struct properties
+	UScriptStruct* Struct = nullptr;
+
+	const FAnalyticsPacketPlan* Plan = nullptr;
+
+	// Quantization step of each plan property, as registered in the capture
+	TArray<float> Quantization;
+
+	// Flags of each plan property from format 5 on, see property_flag_predicted
+	TArray<uint8> PropertyFlags;
+
+	// Lane the records of this type are stored in
+	EAnalyticsLane Lane = EAnalyticsLane::Bulk;
+
+	// CRC of the registered schema: name, property names, types, quantization and flags
+	uint32 SchemaHash = 0;
+
+	// Serialize time of this type under stat DataWise
+	TStatId StatId;
+};
+
 #define local_capture_path "\\.Analytics\\Captures\\"
 #define local_cache_path "\\.Analytics\\Cache\\"
 
@@ -26,6 +57,15 @@ public:
 
 	UAnalyticsCapture* DeserializeCapture(FAnalyticsCaptureInfo info) override;
 
+	// Loads only the packets reported between start_time and end_time, in seconds since the start of the session.
+	// root adds the capture to the root set as soon as it is created, for captures loaded off the game thread that outlive the load.
+	UAnalyticsCapture* DeserializeCaptureRange(FAnalyticsCaptureInfo info, double start_time, double end_time, bool root = false);
+
+	FAnalyticsPacketCursor* OpenCursor(FAnalyticsCaptureInfo info, double start_time, double end_time) override;
+
+	// Bytes the capture takes in storage or cache, the size of the container for streams of a multiplexed capture
+	int64 GetStoredCaptureSize(FAnalyticsCaptureInfo info);
+
 	TArray<FAnalyticsCaptureInfo> FindCaptures() override;
 	TArray<FAnalyticsCaptureInfo> FindCachedCaptures();
 
@@ -33,6 +73,12 @@ public:
 
 	private:
 	FAnalyticsCaptureInfo SerializeCaptureToDirectory(FString path, UAnalyticsCapture* capture);
+
+	// Path of the first segment in storage or cache, empty if the capture is not stored as a file
+	FString FindCapturePath(const FString& name);
+
+	// Reader over the blocks of a stream of a multiplexed capture in its container, nullptr if the stream is not found
+	FArchive* OpenMultiplexedStream(const FAnalyticsCaptureInfo& info);
 };
 
 UCLASS()
@@ -51,18 +97,43 @@ class DATAWISE_API LocalPacketSerializer
 {
 public:
 
-	LocalPacketSerializer(FArchive*);
+	// Writes a complete capture to the archive, which is finished when the serializer is destroyed.
+	// When registration_archive is provided the serializer only encodes: class registrations go to registration_archive and packets are framed by the caller.
+	LocalPacketSerializer(FArchive*, FArchive* registration_archive = nullptr);
+	~LocalPacketSerializer();
 	void AddPacket(UAnalyticsPacket*);
+	void AddPacket(UStruct* type, const void* container, double time);
+
+	// Registers the type on first use
+	const FLocalPacketType& GetPacketType(UStruct* type);
+
+	// Registers every packet class that is loaded, so their schemas are written up front instead of when they are first reported
+	void RegisterLoadedTypes(TArray<const FLocalPacketType*>& registered);
+
+	// Properties of a packet without the record header, for writers that frame records themselves
+	static void SerializePayload(FArchive& archive, const FLocalPacketType& type, const void* container, FAnalyticsStringTable* strings);
+
+	// Strings interned by this serializer. Definitions go to the capture, callers that frame records themselves set the output.
+	FAnalyticsStringTable& GetStrings() { return strings; }
 
 	static void StoreMetaData(FArchive* Archive, TMap<FString, FString> Meta);
 
 private:
 	FArchive* archive;
+	FArchive* registration_archive;
+
+	FAnalyticsChunkWriter* chunk_writer = nullptr;
+	TArray<uint8> registration_data;
+	TArray<uint8> payload_data;
+	TArray<uint8> schema_data;
 
-	TMap<UClass*, PacketTypeIndex> packet_types;
+	FAnalyticsStringTable strings;
+
+	// Allocated separately so references stay valid while other types are registered
+	TMap<UStruct*, FLocalPacketType*> packet_types;
 	PacketTypeIndex next_packet_id = 1; // 0 is reserved for packet class registration
 
-	PacketTypeIndex RegisterPacketType(TSubclassOf<UAnalyticsPacket> type);
+	const FLocalPacketType& RegisterPacketType(UStruct* type);
 };
 
 class DATAWISE_API LocalPacketDeserializer
@@ -72,13 +143,62 @@ public:
 	static TMap<FString, FString> LoadMetaData(FArchive* Archive);
 
 	LocalPacketDeserializer(FArchive*, UAnalyticsCapture*);
-	void Process();
+	~LocalPacketDeserializer();
+
+	// Only packets within the time range are loaded, chunks outside of it are skipped entirely
+	void Process(double start_time = 0.0, double end_time = TNumericLimits<double>::Max());
+
+	// Forward iteration over the records without creating a packet per record, see FAnalyticsPacketCursor.
+	// Reads the header and the registrations of the chunk index, false if the capture can not be read.
+	bool BeginStream(double start_time, double end_time);
+
+	// Positions the archive at the properties of the next packet record, false at the end of the capture
+	bool NextRecord(const FLocalPacketType*& type);
+
+	// Reads the properties and time of the current record into a packet of its type, false if the record is incomplete
+	bool ReadPacket(const FLocalPacketType& type, UAnalyticsPacket* packet);
 
 private:
 	FArchive* archive;
 	UAnalyticsCapture* output;
 
-	TMap<PacketTypeIndex, UClass*> packet_types;
+	// Streamed chunks are decompressed one at a time and read from stream_reader, the capture itself is stream_archive
+	FArchive* stream_archive = nullptr;
+	FArchive* stream_reader = nullptr;
+	FAnalyticsChunkIndex stream_index;
+	TArray<const FAnalyticsChunkInfo*> stream_chunks;
+	int32 stream_next_chunk = 0;
+	TArray<uint8> stream_stored;
+	TArray<uint8> stream_raw;
+
+	uint32 version = 1;
+	int64 last_timestamp = 0;
 
+	// Starts over with every chunk, like the time deltas
+	FAnalyticsVectorPredictor predictor;
+
+	double range_start = 0.0;
+	double range_end = 0.0;
+
+	TMap<PacketTypeIndex, FLocalPacketType> packet_types;
+	TArray<uint8> schema_data;
+
+	FAnalyticsStringTable strings;
+
+	void ProcessRecords();
+	void ProcessChunks();
 	void RegisterPacketType();
+
+	// Loads or rebuilds the chunk index, registers its types and selects the chunks within the time range
+	void LoadChunks(FAnalyticsChunkIndex& index, TArray<const FAnalyticsChunkInfo*>& chunks);
+
+	// Reads records until the next packet record, handling registrations on the way
+	bool ReadRecord(FLocalPacketType*& type);
+
+	// Reads name and properties of a registration, then looks up and validates the type when resolve is set
+	bool ReadSchema(FLocalPacketType& packet_type, bool resolve);
+	bool ValidateProperties(const FString& class_name, const FAnalyticsPacketPlan* plan, const TArray<FString>& property_names, const TArray<FString>& property_types);
+
+	void SerializeIndex(uint32& value);
+	void SerializeString(FString& value);
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include "UObject/Class.h"
+#include "AnalyticsSampling.h"
+#include "AnalyticsSettings.h"
 #include "AnalyticsPacket.generated.h"
 
 
@@ -13,4 +15,49 @@ public:
 
 	UFUNCTION(BlueprintCallable, BlueprintPure)
 	int32 GetTime() { return Time; }
-};
\ No newline at end of file
+
+	// Default sampling of this packet class, not part of the packet data
+	UPROPERTY(EditDefaultsOnly, Category = "Analytics")
+	FAnalyticsSamplingPolicy SamplingPolicy;
+
+	// How the records of this packet class are stored, not part of the packet data
+	UPROPERTY(EditDefaultsOnly, Category = "Analytics")
+	EAnalyticsLane Lane = EAnalyticsLane::Bulk;
+
+	// Seconds since the start of the session, whole seconds for captures of format version 1
+	double PreciseTime = 0.0;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	float GetPreciseTime() { return PreciseTime; }
+};
+
+// Packet loaded from a capture that was reported natively as a USTRUCT through UAnalyticsSession::Report
+UCLASS(NotBlueprintable)
+class DATAWISE_API UAnalyticsStructPacket : public UAnalyticsPacket
+{
+GENERATED_BODY()
+public:
+	UPROPERTY()
+	UScriptStruct* Struct = nullptr;
+
+	// Allocates and initializes the struct data, any previous data is released
+	void Initialize(UScriptStruct* type);
+
+	virtual void BeginDestroy() override;
+
+	void* GetData() const { return data; }
+
+	template<typename T>
+	const T* Get() const
+	{
+		return Struct == T::StaticStruct() ? static_cast<const T*>(data) : nullptr;
+	}
+
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	FString GetStructName() { return Struct != nullptr ? Struct->GetName() : FString(); }
+
+private:
+	void* data = nullptr;
+
+	void Release();
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/GCObject.h"
+#include "AnalyticsCapture.h"
+#include "AnalyticsPacketCursor.generated.h"
+
+class LocalPacketDeserializer;
+struct FLocalPacketType;
+
+// Forward iteration over the packets of a stored capture in constant memory. Packets are decoded one at a time into a packet object
+// that is reused for every packet of the same type, instead of creating an object per packet like DeserializeCapture does.
+// Packets come in the order they are stored: by time within a lane, but not across chunks of different lanes.
+class DATAWISE_API FAnalyticsPacketCursor : public FGCObject
+{
+public:
+	// Takes ownership of the archives, which are read one after the other like the segments of a capture
+	FAnalyticsPacketCursor(const FString& name, const TArray<FArchive*>& archives, double start_time = 0.0, double end_time = TNumericLimits<double>::Max());
+	~FAnalyticsPacketCursor();
+
+	// Advances to the next packet within the time range, false once every packet has been read
+	bool Next();
+
+	// The packet the cursor is at. It is overwritten by the next packet of its type, copy what needs to be kept.
+	UAnalyticsPacket* GetPacket() const { return packet; }
+
+	double GetTime() const { return packet != nullptr ? packet->PreciseTime : 0.0; }
+
+	// Data of a struct packet, nullptr if the cursor is at a packet of another type
+	template<typename T>
+	const T* Get() const
+	{
+		UAnalyticsStructPacket* struct_packet = Cast<UAnalyticsStructPacket>(packet);
+		return struct_packet != nullptr ? struct_packet->Get<T>() : nullptr;
+	}
+
+	void AddReferencedObjects(FReferenceCollector& collector) override;
+
+private:
+	UAnalyticsPacket* GetView(const FLocalPacketType& type);
+
+	FString name;
+	TArray<FArchive*> archives;
+	int32 archive_index = -1;
+	LocalPacketDeserializer* deserializer = nullptr;
+
+	double range_start;
+	double range_end;
+
+	// One packet object per class or struct
+	TMap<UStruct*, UAnalyticsPacket*> views;
+	UAnalyticsPacket* packet = nullptr;
+};
+
+UCLASS(BlueprintType)
+class DATAWISE_API UAnalyticsPacketCursor : public UObject
+{
+	GENERATED_BODY()
+public:
+	// Cursor over the packets of a capture of any connection that supports streaming, nullptr if the capture can not be opened
+	UFUNCTION(BlueprintCallable, Category = "Analytics Capture")
+	static UAnalyticsPacketCursor* OpenCapture(FAnalyticsCaptureInfo Capture);
+
+	UFUNCTION(BlueprintCallable, Category = "Analytics Capture")
+	static UAnalyticsPacketCursor* OpenCaptureRange(FAnalyticsCaptureInfo Capture, float StartTime, float EndTime);
+
+	// Packet is reused for the next packet of its type, false once every packet has been read
+	UFUNCTION(BlueprintCallable, Category = "Analytics Capture")
+	bool Next(UAnalyticsPacket*& Packet);
+
+	// Releases the capture before the cursor is collected
+	UFUNCTION(BlueprintCallable, Category = "Analytics Capture")
+	void Close();
+
+	void BeginDestroy() override;
+
+	FAnalyticsPacketCursor* GetCursor() const { return cursor; }
+
+private:
+	FAnalyticsPacketCursor* cursor = nullptr;
+};
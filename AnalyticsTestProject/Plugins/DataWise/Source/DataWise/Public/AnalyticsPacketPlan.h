@@ -0,0 +1,128 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/Class.h"
+#include "UObject/UnrealType.h"
+#include "UObject/WeakObjectPtr.h"
+
+class FAnalyticsStringTable;
+class FAnalyticsVectorPredictor;
+
+// Flags of a property in the schema of a registration, from capture format 5 on
+#define property_flag_predicted 0x01
+#define property_flag_prediction_key 0x02
+
+enum class EAnalyticsPropertyCodec : uint8
+{
+	Unsupported,
+	String,
+	Vector,
+	Int32,
+	UInt32,
+	UInt8,
+	Bool,
+	Float,
+	Vector2D,
+	Int32Array,
+	FloatArray,
+	VectorArray
+};
+
+struct FAnalyticsPropertyPlan
+{
+	UProperty* Property = nullptr;
+	FString Name;
+	FString Type;
+	int32 Offset = 0;
+	int32 Size = 0;
+	EAnalyticsPropertyCodec Codec = EAnalyticsPropertyCodec::Unsupported;
+
+	// Step size vectors are rounded to in the compact format, 0 stores them at full precision.
+	// Vector arrays with a step size are stored as a trajectory, see SerializeTrajectory.
+	float Quantization = 0.0f;
+
+	// UAnalyticsPacket::Time, which the compact format stores in the record header instead
+	bool bIsTime = false;
+
+	// Plain vector predicted from the records of the same packet type before it, see FAnalyticsVectorPredictor
+	bool bPredicted = false;
+
+	// Int32, UInt32 or string property whose value tells apart the packets that are predicted separately, like a player id
+	bool bIsPredictionKey = false;
+
+	uint8 GetFlags() const { return (bPredicted ? property_flag_predicted : 0) | (bIsPredictionKey ? property_flag_prediction_key : 0); }
+};
+
+// Contiguous block of memory that is stored as is, bool properties are widened to 32 bits like FArchive does
+struct FAnalyticsCopyRun
+{
+	int32 Offset = 0;
+	int32 Size = 0;
+	UBoolProperty* BoolProperty = nullptr;
+};
+
+// Serialization layout of a packet type, compiled once from reflection data and shared by all serializers
+class DATAWISE_API FAnalyticsPacketPlan
+{
+public:
+	static const FAnalyticsPacketPlan* Get(UStruct* type);
+
+	static EAnalyticsPropertyCodec GetCodec(UProperty* property, int32& size);
+
+	// Reads or writes the properties of container depending on the direction of the archive
+	void Serialize(FArchive& archive, void* container) const;
+
+	// Compact encoding of capture format 2, quantization holds the step size of each property as registered in the capture.
+	// Strings go through the string table of the capture from format 6 on, and are stored inline without one.
+	// Flags of format 5 move predicted vectors in front of the other properties. They are written as a fixed size key and absolute steps,
+	// which FAnalyticsChunkWriter replaces with residuals, and read back as residuals through the predictor of the chunk.
+	void SerializeCompact(FArchive& archive, void* container, const TArray<float>& quantization, FAnalyticsStringTable* strings = nullptr,
+		const TArray<uint8>* flags = nullptr, FAnalyticsVectorPredictor* predictor = nullptr, uint32 type = 0) const;
+
+	const FAnalyticsPropertyPlan* FindProperty(FName name) const;
+
+	TWeakObjectPtr<UStruct> Type;
+	FString Name;
+
+	// All reflected properties in field iteration order, including unsupported ones
+	TArray<FAnalyticsPropertyPlan> Properties;
+
+	// Set when every property has a fixed size, allowing the packet to be stored with a single archive call
+	bool bFixedSize = false;
+	int32 FixedSize = 0;
+	TArray<FAnalyticsCopyRun> Runs;
+
+private:
+	static FAnalyticsPacketPlan* Compile(UStruct* type);
+	static float GetQuantization(UStruct* type, UProperty* property, const TCHAR* meta_name);
+	static float GetMetaStep(UField* field, const TCHAR* meta_name);
+
+	void SerializeProperties(FArchive& archive, void* container) const;
+	void SerializeFixedSize(FArchive& archive, void* container) const;
+};
+
+// Plain vectors that are reported over and over, like the location of a player, are predicted linearly from the two records of the same
+// packet type and key before them. Only the residual is stored, which takes a byte per axis for anything moving at a steady velocity.
+// The history starts over with every chunk, so each chunk still decodes on its own.
+class DATAWISE_API FAnalyticsVectorPredictor
+{
+public:
+	// Replaces the quantized coordinates in values with their residuals against the prediction
+	void Encode(uint32 type, uint32 key, int64* values, int32 count) { Predict(type, key, values, count, true); }
+
+	// Replaces the residuals in values with the quantized coordinates
+	void Decode(uint32 type, uint32 key, int64* values, int32 count) { Predict(type, key, values, count, false); }
+
+	void Reset() { entities.Reset(); }
+
+private:
+	struct FEntity
+	{
+		int32 Records = 0;
+		TArray<int64, TInlineAllocator<6>> Previous;
+		TArray<int64, TInlineAllocator<6>> Before;
+	};
+
+	void Predict(uint32 type, uint32 key, int64* values, int32 count, bool encode);
+
+	TMap<TPair<uint32, uint32>, FEntity> entities;
+};
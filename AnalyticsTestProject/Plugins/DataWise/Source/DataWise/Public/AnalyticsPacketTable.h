@@ -0,0 +1,75 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "Containers/ArrayView.h"
+#include "AnalyticsPacketPlan.h"
+
+// Packets of one class or struct stored by column: the time of every packet in one array and every property in an array of its own,
+// so a scan over a property reads contiguous memory instead of visiting a packet object per row.
+class DATAWISE_API FAnalyticsPacketTable
+{
+public:
+	FAnalyticsPacketTable(UStruct* type);
+
+	// Appends a row from container, a packet object of the class or the data of a struct packet
+	void Add(double time, const void* container);
+
+	// Packets are stored by time within a chunk but not across lanes, rows are sorted once the table is complete
+	void SortByTime();
+
+	int32 Num() const { return times.Num(); }
+
+	const FAnalyticsPacketPlan* GetPlan() const { return plan; }
+
+	UStruct* GetType() const { return plan != nullptr ? plan->Type.Get() : nullptr; }
+
+	// Seconds since the start of the session of every row
+	const TArray<double>& GetTimes() const { return times; }
+
+	// First row at or after time, Num() if there is none. Only valid once the rows are sorted.
+	int32 FindFirstRow(double time) const;
+
+	// Values of a fixed size property, empty if the property is not stored or T does not have its size. Bools are stored as one uint8 per row.
+	template<typename T>
+	TArrayView<const T> GetColumn(FName property) const
+	{
+		const FColumn* column = FindColumn(property);
+		if (column == nullptr || column->Stride != sizeof(T) || column->Property->Size == 0) return TArrayView<const T>();
+		return TArrayView<const T>(reinterpret_cast<const T*>(column->Values.GetData()), Num());
+	}
+
+	// Elements of an array property of all rows after each other, the elements of a row end at its entry in GetArrayEnds
+	template<typename T>
+	TArrayView<const T> GetArrayColumn(FName property) const
+	{
+		const FColumn* column = FindColumn(property);
+		if (column == nullptr || column->Stride != sizeof(T) || column->Property->Size != 0) return TArrayView<const T>();
+		return TArrayView<const T>(reinterpret_cast<const T*>(column->Values.GetData()), column->Values.Num() / sizeof(T));
+	}
+
+	TArrayView<const int32> GetArrayEnds(FName property) const;
+
+	// nullptr if the property is not a string
+	const TArray<FString>* GetStringColumn(FName property) const;
+
+private:
+	struct FColumn
+	{
+		const FAnalyticsPropertyPlan* Property = nullptr;
+
+		// Size of a value, or of an element for array properties
+		int32 Stride = 0;
+		TArray<uint8> Values;
+
+		// Index of the element after the last one of each row, array properties only
+		TArray<int32> Ends;
+
+		TArray<FString> Strings;
+	};
+
+	const FColumn* FindColumn(FName property) const;
+
+	const FAnalyticsPacketPlan* plan = nullptr;
+
+	TArray<double> times;
+	TArray<FColumn> columns;
+};
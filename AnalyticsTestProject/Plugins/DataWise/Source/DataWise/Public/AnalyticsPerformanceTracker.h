@@ -0,0 +1,106 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "AnalyticsAggregators.h"
+#include "AnalyticsPerformanceTracker.generated.h"
+
+// Engine performance over one interval of the tracker, times in milliseconds
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsPerformanceSample
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	float Interval = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	int32 Frames = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	float FrameTime = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	float FrameTimeMax = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	float GameThreadTime = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	float RenderThreadTime = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	float GPUTime = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	int32 Hitches = 0;
+
+	// Megabytes in use at the end of the interval
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	int32 UsedPhysicalMemory = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	int32 UsedVirtualMemory = 0;
+};
+
+// Single frame around a hitch, reported in bursts instead of every frame. Times in milliseconds.
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsHitchFrame
+{
+	GENERATED_BODY()
+
+	// Number of the hitch within the session, shared by all frames of its burst
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	int32 Hitch = 0;
+
+	// Frames before (negative) or after the hitch frame
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	int32 Offset = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	float FrameTime = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	float GameThreadTime = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	float RenderThreadTime = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Performance")
+	float GPUTime = 0.0f;
+};
+
+// Samples frame, thread and GPU times and memory every frame without creating packets. Reports a FAnalyticsPerformanceSample per interval,
+// and when a frame exceeds the hitch threshold the frames leading up to it and following it as FAnalyticsHitchFrame.
+UCLASS()
+class DATAWISE_API UAnalyticsPerformanceTracker : public UAnalyticsAggregator
+{
+	GENERATED_BODY()
+public:
+	// Hitch threshold in milliseconds, burst frames are reported on both sides of a hitch
+	UFUNCTION(BlueprintCallable, Category = "Analytics Performance")
+	static UAnalyticsPerformanceTracker* StartPerformanceTracking(UAnalyticsSession* Session, float Interval = 1.0f, float HitchThreshold = 60.0f, int32 BurstFrames = 30);
+
+	void Tick(float delta_time) override;
+
+protected:
+	bool Report(UAnalyticsSession* target, float covered) override;
+
+private:
+	float hitch_threshold = 60.0f;
+	int32 burst_frames = 30;
+
+	// Most recent frames, reported when a hitch occurs
+	TArray<FAnalyticsHitchFrame> history;
+	int32 history_next = 0;
+	int32 history_count = 0;
+
+	int32 hitch_count = 0;
+	int32 burst_remaining = 0;
+
+	int32 frames = 0;
+	int32 hitches = 0;
+	double frame_time = 0.0;
+	float frame_time_max = 0.0f;
+	double game_thread_time = 0.0;
+	double render_thread_time = 0.0;
+	double gpu_time = 0.0;
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/Class.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "AnalyticsSampling.generated.h"
+
+class FAnalyticsPacketPlan;
+struct FAnalyticsPropertyPlan;
+
+// Limits how many events of a packet type are written. All enabled limits have to pass for an event to be kept.
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsSamplingPolicy
+{
+	GENERATED_BODY()
+
+	// Events per second that are kept at most, 0 keeps all
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sampling", meta = (ClampMin = "0"))
+	float MaxFrequency = 0.0f;
+
+	// Keeps only every Nth event
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sampling", meta = (ClampMin = "1"))
+	int32 EveryNth = 1;
+
+	// Keeps a uniform random sample of this many events per reservoir window, 0 disables reservoir sampling
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sampling", meta = (ClampMin = "0"))
+	int32 ReservoirSize = 0;
+
+	// Seconds after which the sampled events of a reservoir are written
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sampling", meta = (ClampMin = "0.01"))
+	float ReservoirWindow = 1.0f;
+
+	// Keeps an event only when one of its vector properties moved further than this since the last kept event, 0 disables
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sampling", meta = (ClampMin = "0"))
+	float MoveEpsilon = 0.0f;
+
+	// Property whose value separates independent sources, e.g. a player id, so each source is limited on its own
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sampling")
+	FName KeyProperty;
+
+	bool IsEnabled() const { return MaxFrequency > 0.0f || EveryNth > 1 || ReservoirSize > 0 || MoveEpsilon > 0.0f; }
+};
+
+enum class EAnalyticsSamplingResult : uint8
+{
+	Write,
+	Skip,
+
+	// The event replaces slot of the reservoir and is written when the window ends
+	Reservoir
+};
+
+struct FAnalyticsSampledRecord
+{
+	uint32 Type = 0;
+	int64 Timestamp = 0;
+	TArray<uint8> Payload;
+};
+
+// Sampling state of one packet type in a session, locked on its own so types sampled on different threads do not contend
+struct FAnalyticsSamplingState
+{
+	UStruct* Type = nullptr;
+	FAnalyticsSamplingPolicy Policy;
+	const FAnalyticsPropertyPlan* KeyProperty = nullptr;
+
+	FCriticalSection Mutex;
+
+	// Set when the policy of the type is replaced, reporting threads may still hold on to the state until they notice
+	bool bRetired = false;
+
+	struct FSource
+	{
+		double LastTime = -1.0;
+		int64 Count = 0;
+		TArray<float> LastVectors;
+
+		double WindowStart = 0.0;
+		int64 WindowCount = 0;
+		TArray<FAnalyticsSampledRecord> Reservoir;
+	};
+
+	TMap<uint32, FSource> Sources;
+	FRandomStream Random;
+	TArray<float> Vectors;
+};
+
+// Applies the sampling policies of a session before events are serialized, from any thread
+class DATAWISE_API FAnalyticsSampler
+{
+public:
+	~FAnalyticsSampler();
+
+	// Receives the start of the oldest open reservoir window whenever it changes, or the maximum double once no window is open.
+	// Reservoir records are written late, so records reported at or after it may still be preceded by them.
+	void SetHoldOutput(TFunction<void(double)> output) { hold_output = output; }
+
+	// Policy set at runtime, takes precedence over the project settings and the packet class defaults
+	void SetPolicy(UStruct* type, const FAnalyticsSamplingPolicy& policy);
+
+	// nullptr when the policy of the type keeps every event. The state stays valid while the generation is unchanged.
+	FAnalyticsSamplingState* GetState(UStruct* type, const FAnalyticsPacketPlan* plan);
+	int32 GetGeneration() const { return generation.GetValue(); }
+
+	// fill receives the reservoir slot the event replaces while the state is locked
+	EAnalyticsSamplingResult Sample(FAnalyticsSamplingState& state, const FAnalyticsPacketPlan* plan, const void* container, double time, TFunctionRef<void(FAnalyticsSampledRecord&)> fill);
+
+	// Hands the records of every reservoir whose window ended to write, or of all reservoirs when flushing.
+	// The windows are only closed once write returned, so the hold covers the records until they are written.
+	void CollectReservoirs(double time, bool flush, TFunctionRef<void(TArray<FAnalyticsSampledRecord>&)> write);
+
+private:
+	static uint32 GetSourceKey(const FAnalyticsPropertyPlan* key_property, const void* container);
+	static void GetVectors(const FAnalyticsPacketPlan* plan, const void* container, TArray<float>& result);
+	static bool HasMoved(const FAnalyticsPacketPlan* plan, const TArray<float>& previous, const TArray<float>& current, float epsilon);
+
+	void OpenWindow(UStruct* type, uint32 source, double start, double end);
+	void CloseWindows(const TArray<TPair<TPair<UStruct*, uint32>, double>>& windows);
+	void UpdateHold();
+
+	FCriticalSection types_mutex;
+	TMap<UStruct*, FAnalyticsSamplingPolicy> overrides;
+	TMap<UStruct*, FAnalyticsSamplingState*> types;
+	TArray<FAnalyticsSamplingState*> retired;
+	FThreadSafeCounter generation;
+
+	// Start of every open reservoir window by type and source
+	FCriticalSection windows_mutex;
+	TMap<TPair<UStruct*, uint32>, double> open_windows;
+	TFunction<void(double)> hold_output;
+
+	double hold = TNumericLimits<double>::Max();
+
+	// Earliest end of a reservoir window as a timestamp, reservoirs are only visited once it passed
+	volatile int64 next_window_end = MAX_int64;
+	FCriticalSection collect_mutex;
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "AnalyticsLocalCaptureManager.h"
+
+// Packet schemas that have been resolved to a loaded type, shared by all captures that are loaded in this process.
+// Schemas are keyed by their hash and compared byte for byte, so a hash collision can not resolve to the wrong type.
+class DATAWISE_API FAnalyticsSchemaCatalog
+{
+public:
+	// Fills packet_type with the resolved type and decode plan, false if the schema is unknown or its type changed since
+	static bool Find(uint32 hash, const TArray<uint8>& schema, FLocalPacketType& packet_type);
+
+	static void Add(uint32 hash, const TArray<uint8>& schema, const FLocalPacketType& packet_type);
+
+	// Schemas that did not resolve are skipped by later captures until the class finder cache changes, instead of searching for their type again.
+	// generation is UClassFinder::GetCacheGeneration from before the failed lookup.
+	static bool IsUnresolved(uint32 hash, const TArray<uint8>& schema);
+	static void AddUnresolved(uint32 hash, const TArray<uint8>& schema, int32 generation);
+
+	static void Reset();
+};
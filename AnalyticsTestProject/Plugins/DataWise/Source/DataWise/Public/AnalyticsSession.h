@@ -1,9 +1,19 @@
 #pragma once
 #include "UObject/Class.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/ThreadSafeCounter.h"
 #include "AnalyticsPacket.h"
+#include "AnalyticsSampling.h"
+#include "AnalyticsStats.h"
+#include "AnalyticsCaptureWriter.h"
 #include "AnalyticsSession.generated.h"
 
 class LocalPacketSerializer;
+class UAnalyticsAggregator;
+class FAnalyticsCaptureWriter;
+class FAnalyticsPacketPlan;
+struct FAnalyticsPropertyPlan;
+enum class EAnalyticsPropertyCodec : uint8;
 
 UCLASS()
 class DATAWISE_API UAnalyticsSession : public UObject
@@ -20,40 +30,167 @@ public:
 	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session", meta = (WorldContext = WorldContextObject))
 	static void BeginSession(UObject* WorldContextObject, FString name, UAnalyticsSession*& session, int32& index);
 
+	// Session that keeps the most recent events in memory instead of writing them to disk, see DumpFlightRecorder
+	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session", meta = (WorldContext = WorldContextObject))
+	static void BeginFlightRecorder(UObject* WorldContextObject, FString name, UAnalyticsSession*& session, int32& index);
+
 	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session")
 	void EndSession();
 
+	// Writes the events a flight recorder holds to a new capture with meta data, Capture is its name
+	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session")
+	bool DumpFlightRecorder(FString& Capture);
+
+	// Dumps every active flight recorder, for bug reports
+	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session")
+	static void DumpFlightRecorders();
+
+	// Number of active sessions that write a capture, flight recorders are not counted. Safe to call from any thread.
+	static int32 GetRecordingSessionCount() { return recording_sessions.GetValue(); }
+
+	// Turns flight recorders dumped by the crash handler of an earlier run into captures and queues them for upload
+	static void RecoverCrashDumps();
+
+	UFUNCTION(BLUEPRINTCALLABLE, BLUEPRINTPURE, Category = "Analytics Session")
+	bool IsFlightRecorder() const { return flight_recorder; }
+
 	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session")
 	void SetMetaData(TMap<FString, FString> Meta);
 
+	// Overrides the sampling of a packet class for this session
+	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session")
+	void SetSamplingPolicy(TSubclassOf<UAnalyticsPacket> Class, FAnalyticsSamplingPolicy Policy);
+
+	void SetStructSamplingPolicy(UScriptStruct* type, const FAnalyticsSamplingPolicy& policy);
+
+	// Game thread only, the packet object is destroyed after it has been written
 	UFUNCTION(BLUEPRINTCALLABLE, meta = (BlueprintInternalUseOnly = "true"))
 	void ReportEvent(UObject* packet);
 
+	// Native report of a USTRUCT packet, without creating any objects. Its time is stored alongside the struct.
+	// Can be called from any thread while the session is active.
+	template<typename T>
+	void Report(const T& packet)
+	{
+		ReportStruct(T::StaticStruct(), &packet);
+	}
+
+	void ReportStruct(UScriptStruct* type, const void* packet);
+
+	// Report without a packet object, used by the Report Event node: BeginReport, one write per property and EndReport.
+	// Game thread only, the report is built in a container shared by the session.
+	UFUNCTION(BLUEPRINTCALLABLE, meta = (BlueprintInternalUseOnly = "true"))
+	void BeginReport(TSubclassOf<UAnalyticsPacket> Class);
+
+	UFUNCTION(BLUEPRINTCALLABLE, meta = (BlueprintInternalUseOnly = "true"))
+	void WriteReportString(FName Property, const FString& Value);
+
+	UFUNCTION(BLUEPRINTCALLABLE, meta = (BlueprintInternalUseOnly = "true"))
+	void WriteReportVector(FName Property, FVector Value);
+
+	UFUNCTION(BLUEPRINTCALLABLE, meta = (BlueprintInternalUseOnly = "true"))
+	void WriteReportInt(FName Property, int32 Value);
+
+	UFUNCTION(BLUEPRINTCALLABLE, meta = (BlueprintInternalUseOnly = "true"))
+	void WriteReportBool(FName Property, bool Value);
+
+	UFUNCTION(BLUEPRINTCALLABLE, meta = (BlueprintInternalUseOnly = "true"))
+	void WriteReportFloat(FName Property, float Value);
+
+	UFUNCTION(BLUEPRINTCALLABLE, meta = (BlueprintInternalUseOnly = "true"))
+	void WriteReportVector2D(FName Property, FVector2D Value);
+
+	UFUNCTION(BLUEPRINTCALLABLE, meta = (BlueprintInternalUseOnly = "true"))
+	void EndReport();
+
 	virtual void BeginDestroy() override;
 
 	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session")
 	FString GetName() { return name; }
 
+	// Clamped to the int32 range, Blueprint has no 64 bit integers
 	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session")
 	int32 GetCaptureSize();
 
+	// Size in bytes of all segments of the capture
+	int64 GetCaptureSizeBytes() const;
+
 	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session")
 	FString GetFormattedCaptureSize();
 
+	// Event rates, serialize time and writer state of this session, also available through stat DataWise
+	UFUNCTION(BLUEPRINTCALLABLE, Category = "Analytics Session")
+	FAnalyticsSessionStats GetStats();
+
+	// Emits the summaries of the aggregator every interval until the session ends, see UAnalyticsAggregatorTools
+	void AddAggregator(UAnalyticsAggregator* aggregator);
+
 private:
+	// Unique for the lifetime of the process, identifies the session in the state reporting threads keep
+	uint32 id = 0;
+
 	double start_time;
 
 	FString name;
 
 	bool active = false;
 
-	FArchive* archive;
+	bool flight_recorder = false;
+
+	// Written as a stream of the multiplexed capture of the server
+	bool multiplexed = false;
+	FString multiplex_container;
+	uint32 multiplex_stream = 0;
+	FThreadSafeCounter dump_count;
+
+	FAnalyticsCaptureWriter* writer = nullptr;
+
+	LocalPacketSerializer* serializer = nullptr;
 
-	LocalPacketSerializer* serializer;
+	FAnalyticsSampler* sampler = nullptr;
+	FAnalyticsStatsTracker* stats = nullptr;
+
+	// Held for reading while reporting, EndSession takes it for writing before tearing down the writer
+	FRWLock lifetime_lock;
+
+	// Guards type registration, which every thread goes through once per packet type
+	FCriticalSection register_mutex;
+
+	TArray<uint8> registration_buffer;
+	FArchive* registration_archive = nullptr;
 
 	TMap<FString, FString> meta_data;
 
+	UPROPERTY()
+	TArray<UAnalyticsAggregator*> aggregators;
+	FDelegateHandle aggregator_ticker;
+
+	UClass* report_class = nullptr;
+	const FAnalyticsPacketPlan* report_plan = nullptr;
+	uint8* report_container = nullptr;
+	int32 report_container_size = 0;
+
 	static TArray<UAnalyticsSession*> active_sessions;
+	static FCriticalSection sessions_mutex;
+	static FThreadSafeCounter recording_sessions;
+
+	static void StartSession(UObject* WorldContextObject, const FString& name, bool flight_recorder, UAnalyticsSession*& session, int32& index);
+
+	// Bound to system errors, only writes the raw state of flight recorders and skips any that are in use by the crashed thread
+	static void DumpFlightRecordersOnError();
+
+	void StoreMetaData(const FString& capture_name);
+
+	bool TickAggregators(float delta_time);
+	void FlushAggregators();
+
+	const FAnalyticsThreadContext::FReportedType& GetReportedType(UStruct* type);
+
+	// Packet is the reported object, if any, which gets the time the event is recorded at
+	void WriteEvent(UStruct* type, const void* container, UAnalyticsPacket* packet = nullptr);
+
+	void WriteSampledRecords(double time, bool flush);
 
-	void StoreMetaData();
+	const FAnalyticsPropertyPlan* FindReportProperty(FName Property, EAnalyticsPropertyCodec Codec);
+	void ReleaseReport();
 };
\ No newline at end of file
@@ -0,0 +1,170 @@
+#pragma once
+#include "Engine/DeveloperSettings.h"
+#include "AnalyticsSampling.h"
+#include "AnalyticsSettings.generated.h"
+
+UENUM(BlueprintType)
+enum class EAnalyticsBackpressurePolicy : uint8
+{
+	Block,
+	DropOldest,
+	DropNewest
+};
+
+// Handling of the records of a packet type in the capture
+UENUM(BlueprintType)
+enum class EAnalyticsLane : uint8
+{
+	// Batched into large chunks that are compressed, for high volume events
+	Bulk,
+
+	// Stored in small uncompressed chunks that are flushed within CriticalFlushLatency
+	Critical
+};
+
+// Plain vector properties of a packet class that are predicted from the records before them, see FAnalyticsVectorPredictor
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsTrajectoryPacket
+{
+	GENERATED_BODY()
+
+	// Step size the vectors are rounded to
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory", meta = (ClampMin = "0.001"))
+	float Step = 1.0f;
+
+	// Int32, UInt32 or string property that tells apart the packets of different actors, each of which is predicted on its own. None predicts all packets of the class as one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trajectory")
+	FName KeyProperty;
+};
+
+UCLASS(config = Game, defaultconfig)
+class DATAWISE_API UAnalyticsSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+public:
+	UAnalyticsSettings();
+
+	static const UAnalyticsSettings* Get() { return GetDefault<UAnalyticsSettings>(); }
+
+	// Serialize events on a dedicated writer thread instead of the reporting thread
+	UPROPERTY(config, EditAnywhere, Category = "Capture Writer")
+	bool bAsyncWriter = true;
+
+	// Size in bytes of the event buffer of every reporting thread, drained by the writer thread
+	UPROPERTY(config, EditAnywhere, Category = "Capture Writer", meta = (EditCondition = "bAsyncWriter", ClampMin = "4096"))
+	int32 WriterBufferSize = 4 * 1024 * 1024;
+
+	// What to do when events are reported faster than the writer thread can store them
+	UPROPERTY(config, EditAnywhere, Category = "Capture Writer", meta = (EditCondition = "bAsyncWriter"))
+	EAnalyticsBackpressurePolicy BackpressurePolicy = EAnalyticsBackpressurePolicy::Block;
+
+	// Milliseconds records are held back so events reported on other threads at the same time can be stored in order
+	UPROPERTY(config, EditAnywhere, Category = "Capture Writer", meta = (EditCondition = "bAsyncWriter", ClampMin = "0"))
+	float MergeWindow = 20.0f;
+
+	// Seconds after which pending records are stored and flushed to disk, bounding what a crash can lose
+	UPROPERTY(config, EditAnywhere, Category = "Capture Writer", meta = (ClampMin = "0.1"))
+	float FlushInterval = 1.0f;
+
+	// Milliseconds after which records of critical packets are stored and flushed to disk
+	UPROPERTY(config, EditAnywhere, Category = "Capture Writer", meta = (ClampMin = "1"))
+	float CriticalFlushLatency = 100.0f;
+
+	// Size in megabytes after which a capture continues in a new segment file, 0 keeps a single file
+	UPROPERTY(config, EditAnywhere, Category = "Capture Writer", meta = (ClampMin = "0"))
+	int32 SegmentSize = 1024;
+
+	// On dedicated servers all sessions are written into one multiplexed capture instead of a file per session
+	UPROPERTY(config, EditAnywhere, Category = "Capture Writer")
+	bool bMultiplexServerSessions = false;
+
+	// Minutes of events a flight recorder session keeps in memory, 0 keeps events until the size limit is reached
+	UPROPERTY(config, EditAnywhere, Category = "Flight Recorder", meta = (ClampMin = "0"))
+	float FlightRecorderDuration = 5.0f;
+
+	// Megabytes of encoded events a flight recorder session keeps in memory
+	UPROPERTY(config, EditAnywhere, Category = "Flight Recorder", meta = (ClampMin = "1"))
+	int32 FlightRecorderSize = 64;
+
+	// Dump all flight recorders when the engine handles a crash or fatal error
+	UPROPERTY(config, EditAnywhere, Category = "Flight Recorder")
+	bool bDumpFlightRecorderOnError = true;
+
+	// Upload finished captures in the background to the capture manager selected by UploadConnection
+	UPROPERTY(config, EditAnywhere, Category = "Upload")
+	bool bUploadCaptures = false;
+
+	// Tag of the capture manager to upload to, such as FTP. An FTP server on localhost can be used to try uploads out.
+	UPROPERTY(config, EditAnywhere, Category = "Upload", meta = (EditCondition = "bUploadCaptures"))
+	FString UploadConnection = "FTP";
+
+	// Connection properties by name, for FTP these are Adress, Username, Password and Directory
+	UPROPERTY(config, EditAnywhere, Category = "Upload", meta = (EditCondition = "bUploadCaptures"))
+	TMap<FString, FString> UploadConnectionSettings;
+
+	// Kilobytes per second that are uploaded at most, 0 does not limit uploads
+	UPROPERTY(config, EditAnywhere, Category = "Upload", meta = (EditCondition = "bUploadCaptures", ClampMin = "0"))
+	int32 UploadBandwidth = 0;
+
+	// Attempts after the first failed one before a file is left for the next run
+	UPROPERTY(config, EditAnywhere, Category = "Upload", meta = (EditCondition = "bUploadCaptures", ClampMin = "0"))
+	int32 UploadRetries = 5;
+
+	// Seconds before the first retry, doubled for every following one
+	UPROPERTY(config, EditAnywhere, Category = "Upload", meta = (EditCondition = "bUploadCaptures", ClampMin = "0.1"))
+	float UploadRetryDelay = 5.0f;
+
+	// Hold uploads while a session other than a flight recorder is active, so they do not compete with the game
+	UPROPERTY(config, EditAnywhere, Category = "Upload", meta = (EditCondition = "bUploadCaptures"))
+	bool bPauseUploadDuringSessions = true;
+
+	// Delete the local files of a capture once they are uploaded
+	UPROPERTY(config, EditAnywhere, Category = "Upload", meta = (EditCondition = "bUploadCaptures"))
+	bool bDeleteUploadedCaptures = false;
+
+	// Uncompressed size in bytes at which a chunk of records is compressed and stored
+	UPROPERTY(config, EditAnywhere, Category = "Capture Format", meta = (ClampMin = "1024"))
+	int32 ChunkSize = 64 * 1024;
+
+	UPROPERTY(config, EditAnywhere, Category = "Capture Format")
+	bool bCompressChunks = true;
+
+	// Vector properties stored rounded to the given step size, keyed by "PacketClass.Property". Overrides the Quantize meta data, which packaged builds do not have.
+	// Vector array properties listed here are stored as trajectories, overriding their Trajectory meta data.
+	UPROPERTY(config, EditAnywhere, Category = "Capture Format")
+	TMap<FString, float> QuantizedProperties;
+
+	// Packet class or struct names (Blueprint classes end in _C) whose vector properties are predicted across records, like the Trajectory meta data of a class.
+	// For packets that report a single location over and over, such as BPEV_PlayerLocation_C.
+	UPROPERTY(config, EditAnywhere, Category = "Capture Format")
+	TMap<FString, FAnalyticsTrajectoryPacket> TrajectoryPackets;
+
+	// Packet class or struct names (Blueprint classes end in _C) that are stored in the critical lane, in addition to classes that select it in their defaults
+	UPROPERTY(config, EditAnywhere, Category = "Capture Format")
+	TArray<FString> CriticalPackets;
+
+	// Sampling per packet class or struct name (Blueprint classes end in _C), overrides the policy set in the class defaults
+	UPROPERTY(config, EditAnywhere, Category = "Sampling")
+	TMap<FString, FAnalyticsSamplingPolicy> SamplingPolicies;
+
+	// Seconds between two samples of every actor registered with the actor tracker
+	UPROPERTY(config, EditAnywhere, Category = "Actor Tracking", meta = (ClampMin = "0.01"))
+	float ActorTrackingInterval = 0.25f;
+
+	// Milliseconds per frame the actor tracker may spend sampling, passes that take longer continue in the next frame
+	UPROPERTY(config, EditAnywhere, Category = "Actor Tracking", meta = (ClampMin = "0.01"))
+	float ActorTrackingBudget = 0.5f;
+
+	// Step size in units that tracked locations are stored in
+	UPROPERTY(config, EditAnywhere, Category = "Actor Tracking", meta = (ClampMin = "0.01"))
+	float ActorTrackingPrecision = 1.0f;
+
+	// Captures decoded at the same time when compiling or visualizing, 0 uses every core
+	UPROPERTY(config, EditAnywhere, Category = "Compilation", meta = (ClampMin = "0"))
+	int32 CaptureLoadingThreads = 0;
+
+	// Megabytes of stored captures decoded at the same time, counted as they are stored and compressed. A capture larger than this is decoded on its own.
+	// Decoded packets take several times their stored size and are kept until compilation or visualization is done.
+	UPROPERTY(config, EditAnywhere, Category = "Compilation", meta = (ClampMin = "1"))
+	int32 CaptureLoadingStoredBudget = 1024;
+};
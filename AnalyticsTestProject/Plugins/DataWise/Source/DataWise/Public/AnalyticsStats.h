@@ -0,0 +1,139 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/Class.h"
+#include "Stats/Stats.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "AnalyticsStats.generated.h"
+
+// stat DataWise
+DECLARE_STATS_GROUP(TEXT("DataWise"), STATGROUP_DataWise, STATCAT_Advanced);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Events"), STAT_DataWiseEvents, STATGROUP_DataWise, DATAWISE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Event Bytes"), STAT_DataWiseEventBytes, STATGROUP_DataWise, DATAWISE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sampled Out"), STAT_DataWiseSampledOut, STATGROUP_DataWise, DATAWISE_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Dropped Events"), STAT_DataWiseDropped, STATGROUP_DataWise, DATAWISE_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Writer Queue"), STAT_DataWiseQueueDepth, STATGROUP_DataWise, DATAWISE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Serialize"), STAT_DataWiseSerialize, STATGROUP_DataWise, DATAWISE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Flush"), STAT_DataWiseFlush, STATGROUP_DataWise, DATAWISE_API);
+
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsPacketTypeStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	FString Name;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	int32 Events = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	int32 SampledOut = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	float EventsPerSecond = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	float BytesPerSecond = 0.0f;
+
+	// Average time in microseconds to encode one event
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	float SerializeTime = 0.0f;
+};
+
+USTRUCT(BlueprintType)
+struct DATAWISE_API FAnalyticsSessionStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	int32 Events = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	int32 SampledOut = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	float EventsPerSecond = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	float BytesPerSecond = 0.0f;
+
+	// Bytes waiting in the buffers of the writer thread
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	int32 QueueDepth = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	int32 DroppedEvents = 0;
+
+	// Number of flushes per latency bucket, FlushLatencyBuckets holds the upper bound of each bucket in milliseconds
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	TArray<int32> FlushLatency;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	TArray<float> FlushLatencyBuckets;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Analytics Stats")
+	TArray<FAnalyticsPacketTypeStats> PacketTypes;
+};
+
+// Counts flushes by duration, can be updated from any thread
+class DATAWISE_API FAnalyticsLatencyHistogram
+{
+public:
+	void Add(double seconds);
+	void Get(TArray<int32>& counts, TArray<float>& bounds) const;
+
+private:
+	static const int32 bucket_count = 8;
+	static const float bucket_bounds[bucket_count];
+
+	FThreadSafeCounter buckets[bucket_count];
+};
+
+// Event counters of a session per packet type, rates are measured over the last second.
+// Recording only updates atomic counters indexed by the packet type, which are merged when the stats are read.
+class DATAWISE_API FAnalyticsStatsTracker
+{
+public:
+	FAnalyticsStatsTracker();
+	~FAnalyticsStatsTracker();
+
+	void RegisterType(uint32 type, const FString& name);
+
+	void RecordEvent(uint32 type, int32 bytes, uint32 serialize_cycles);
+	void RecordSampledOut(uint32 type);
+
+	void GetStats(FAnalyticsSessionStats& stats);
+
+private:
+	struct FTypeCounters
+	{
+		volatile int64 Events;
+		volatile int64 Bytes;
+		volatile int64 SampledOut;
+		volatile int64 SerializeCycles;
+	};
+
+	struct FTypeRates
+	{
+		FString Name;
+		int64 RateEvents = 0;
+		int64 RateBytes = 0;
+		float EventsPerSecond = 0.0f;
+		float BytesPerSecond = 0.0f;
+	};
+
+	// Counters are allocated in blocks of types the first time one of them is recorded and never move, packet type indices are dense
+	static const int32 block_size = 64;
+	static const int32 block_count = 256;
+
+	FTypeCounters* GetCounters(uint32 type);
+
+	FTypeCounters* volatile blocks[block_count];
+
+	// Guards the names and rates, which are only touched by registration and GetStats
+	FCriticalSection mutex;
+	TMap<uint32, FTypeRates> rates;
+	double rate_time;
+};
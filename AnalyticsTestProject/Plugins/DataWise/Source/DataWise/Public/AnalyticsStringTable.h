@@ -0,0 +1,37 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "Misc/ScopeRWLock.h"
+
+// Strings that repeat across the records of a capture, such as actor, weapon and map names, are defined once and referred to by index.
+// Definitions are control records like class registrations: stored ahead of the records using them, repeated in the chunk index and
+// in every segment and flight recorder dump, so any part of a capture can still be read on its own.
+class DATAWISE_API FAnalyticsStringTable
+{
+public:
+	// Receives the definition record of every new string before the index is handed out, from any thread
+	void SetOutput(TFunction<void(const TArray<uint8>&)> output_) { output = output_; }
+
+	// Writes the index of the string, or 0 followed by the string itself when it is not interned. Reads either form, an interned string is only copied into value when it differs.
+	void Serialize(FArchive& archive, FString& value);
+
+	// Reads a definition, the control record header has been read already
+	void ReadDefinition(FArchive& archive);
+
+private:
+	// Returns 0 when the string is stored inline because it is too long or the table is full
+	uint32 Intern(const FString& value);
+
+	struct FCaseSensitiveKeyFuncs : TDefaultMapKeyFuncs<FString, uint32, false>
+	{
+		static bool Matches(const FString& a, const FString& b) { return a.Equals(b, ESearchCase::CaseSensitive); }
+		static uint32 GetKeyHash(const FString& key) { return FCrc::StrCrc32(*key); }
+	};
+
+	TFunction<void(const TArray<uint8>&)> output;
+
+	FRWLock lock;
+	TMap<FString, uint32, FDefaultSetAllocator, FCaseSensitiveKeyFuncs> indices;
+
+	// Reader side, index 1 is the first entry
+	TArray<FString> strings;
+};
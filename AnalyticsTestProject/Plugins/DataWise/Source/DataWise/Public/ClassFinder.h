@@ -3,6 +3,17 @@
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "ClassFinder.generated.h"
 
+class IAssetRegistry;
+struct FAssetData;
+
+// Class lookups of this thread only use the cache while the scope is alive. Meant for threads holding a FGCScopeGuard,
+// which must not wait for a search on the game thread as the game thread may be waiting for the guard to be released.
+class DATAWISE_API FCachedClassLookupScope
+{
+public:
+	FCachedClassLookupScope();
+	~FCachedClassLookupScope();
+};
 
 UCLASS()
 class DATAWISE_API UClassFinder : public UBlueprintFunctionLibrary
@@ -19,9 +30,31 @@ public:
 	UFUNCTION(BlueprintCallable)
 	static TArray<UClass*> FindSubclassesBP(UClass* base);
 
+	// Subclass of base by name, from a process wide cache of FindSubclasses instead of a new search on every call.
+	// The cache is rebuilt once after blueprints deriving from base are added, removed or renamed, classes are hot reloaded or a cached class is replaced.
+	// Names that were not found are remembered until the cache of base is invalidated. Within a FCachedClassLookupScope nothing is searched for,
+	// the last class found by that name is returned, even when it has been replaced, and the search is left to the game thread.
+	static UClass* FindSubclassByName(UClass* base, const FString& name);
+
+	static void InvalidateCache();
+
+	// Searches for the subclasses of base unless they are cached already and none of them has been replaced. The search waits for the game thread,
+	// so threads that look up classes within a FCachedClassLookupScope prepare the cache before.
+	static void PrepareCache(UClass* base);
+
+	// Changes whenever part of the cache is invalidated, so results derived from a lookup can be dropped with it
+	static int32 GetCacheGeneration();
+
 private:
 	static FThreadSafeBool working;
 	static TArray<UClass*> threaded_result;
 
 	static void FindSubclassesBP_internal(UClass* base);
+
+	// Replaces the cache of base with a new search and returns the subclass called name
+	static UClass* SearchSubclasses(UClass* base, const FString& name);
+	static void BindCacheInvalidation(IAssetRegistry& registry);
+
+	// Outdates the cache of every base the blueprint asset derives from
+	static void InvalidateCache(const FAssetData& asset);
 };
\ No newline at end of file
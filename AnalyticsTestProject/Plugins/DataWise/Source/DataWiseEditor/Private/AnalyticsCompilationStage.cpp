@@ -8,6 +8,7 @@
 #include "HAL/PlatformFilemanager.h"
 #include "Async/Async.h"
 #include "Engine/Texture2D.h"
+#include "AnalyticsPacketTable.h"
 
 void UAnalyticsCompilationStage::ExportData(FString name)
 {
@@ -112,6 +113,80 @@ TArray<UAnalyticsPacket*> UAnalyticsCompilerContext::GetPacketsOfType(TSubclassO
 	return result;
 }
 
+TArray<const FAnalyticsPacketTable*> UAnalyticsCompilerContext::GetTables(UStruct* type) const
+{
+	TArray<const FAnalyticsPacketTable*> result;
+	for (UAnalyticsCapture* capture : Captures)
+	{
+		const FAnalyticsPacketTable* table = capture != nullptr ? capture->GetTable(type) : nullptr;
+		if (table != nullptr) result.Add(table);
+	}
+	return result;
+}
+
+int32 UAnalyticsCompilerContext::GetTableRowCount(TSubclassOf<UAnalyticsPacket> Type) const
+{
+	int32 rows = 0;
+	for (const FAnalyticsPacketTable* table : GetTables(Type))
+	{
+		rows += table->Num();
+	}
+	return rows;
+}
+
+TArray<float> UAnalyticsCompilerContext::GetTableTimes(TSubclassOf<UAnalyticsPacket> Type) const
+{
+	TArray<float> result;
+	result.Reserve(GetTableRowCount(Type));
+	for (const FAnalyticsPacketTable* table : GetTables(Type))
+	{
+		for (double time : table->GetTimes()) result.Add(time);
+	}
+	return result;
+}
+
+template<typename T>
+TArray<T> UAnalyticsCompilerContext::GetTableColumn(UStruct* type, FName property, EAnalyticsPropertyCodec codec) const
+{
+	TArray<T> result;
+	for (const FAnalyticsPacketTable* table : GetTables(type))
+	{
+		// Columns are only checked for their size, so an int32 column would also pass as float
+		const FAnalyticsPropertyPlan* plan = table->GetPlan() != nullptr ? table->GetPlan()->FindProperty(property) : nullptr;
+		if (plan == nullptr || plan->Codec != codec) continue;
+
+		TArrayView<const T> column = table->GetColumn<T>(property);
+		result.Append(column.GetData(), column.Num());
+	}
+	return result;
+}
+
+TArray<int32> UAnalyticsCompilerContext::GetTableIntColumn(TSubclassOf<UAnalyticsPacket> Type, FName Property) const
+{
+	return GetTableColumn<int32>(Type, Property, EAnalyticsPropertyCodec::Int32);
+}
+
+TArray<float> UAnalyticsCompilerContext::GetTableFloatColumn(TSubclassOf<UAnalyticsPacket> Type, FName Property) const
+{
+	return GetTableColumn<float>(Type, Property, EAnalyticsPropertyCodec::Float);
+}
+
+TArray<FVector> UAnalyticsCompilerContext::GetTableVectorColumn(TSubclassOf<UAnalyticsPacket> Type, FName Property) const
+{
+	return GetTableColumn<FVector>(Type, Property, EAnalyticsPropertyCodec::Vector);
+}
+
+TArray<FString> UAnalyticsCompilerContext::GetTableStringColumn(TSubclassOf<UAnalyticsPacket> Type, FName Property) const
+{
+	TArray<FString> result;
+	for (const FAnalyticsPacketTable* table : GetTables(Type))
+	{
+		const TArray<FString>* strings = table->GetStringColumn(Property);
+		if (strings != nullptr) result.Append(*strings);
+	}
+	return result;
+}
+
 BitmapRenderer::BitmapRenderer(int w, int h)
 {
 	size = FIntPoint(w, h);
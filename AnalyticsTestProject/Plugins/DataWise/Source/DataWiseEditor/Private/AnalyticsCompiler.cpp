@@ -10,6 +10,115 @@
 #include "Framework/Commands/Commands.h"
 #include "Engine/Engine.h"
 #include "LevelEditor.h"
+#include "AnalyticsSettings.h"
+#include "Async/ParallelFor.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/Event.h"
+#include "UObject/GarbageCollection.h"
+
+// Decodes captures on several threads, while the stored size of the captures being decoded at the same time stays within the configured budget.
+// load has to return the capture rooted, captures are returned in the order of infos without the ones that could not be loaded. progress receives the number of captures done.
+static TArray<UAnalyticsCapture*> LoadCaptures(const TArray<FAnalyticsCaptureInfo>& infos, TFunction<UAnalyticsCapture*(const FAnalyticsCaptureInfo&)> load, TFunction<void(int32)> progress)
+{
+	UAnalyticsLocalCaptureManager* manager = UAnalyticsLocalCaptureManager::GetLocalCaptureManager();
+	const UAnalyticsSettings* settings = UAnalyticsSettings::Get();
+
+	int32 threads = settings->CaptureLoadingThreads > 0 ? settings->CaptureLoadingThreads : FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+	threads = FMath::Clamp(threads, 1, FMath::Max(infos.Num(), 1));
+	int64 budget = (int64)FMath::Max(settings->CaptureLoadingStoredBudget, 1) * 1024 * 1024;
+
+	TArray<int64> sizes;
+	for (const FAnalyticsCaptureInfo& info : infos)
+	{
+		sizes.Add(manager->GetStoredCaptureSize(info));
+	}
+
+	// Packet classes are resolved while the garbage collector is held off, when a search would wait for the game thread which may be waiting to collect.
+	// Every packet class is looked up before, and decoding threads only use what was found.
+	UClassFinder::PrepareCache(UAnalyticsPacket::StaticClass());
+
+	TArray<UAnalyticsCapture*> loaded;
+	loaded.SetNumZeroed(infos.Num());
+
+	FCriticalSection mutex;
+	FCriticalSection progress_mutex;
+	int32 reported = 0;
+	FEvent* capture_done = FPlatformProcess::GetSynchEventFromPool(false);
+	int32 next = 0;
+	int32 done = 0;
+	int64 in_flight = 0;
+
+	ParallelFor(threads, [&](int32)
+	{
+		while (true)
+		{
+			int32 index = INDEX_NONE;
+			while (index == INDEX_NONE)
+			{
+				{
+					FScopeLock lock(&mutex);
+
+					// Passed on so every waiting thread gets to return
+					if (next >= infos.Num())
+					{
+						capture_done->Trigger();
+						return;
+					}
+
+					// Captures are taken in order, one that does not fit waits until enough of the others are done
+					if (in_flight == 0 || in_flight + sizes[next] <= budget)
+					{
+						index = next++;
+						in_flight += sizes[index];
+
+						// Several captures may fit into what a large one left, the next waiting thread checks the one after
+						if (next < infos.Num() && in_flight + sizes[next] <= budget) capture_done->Trigger();
+					}
+				}
+
+				if (index == INDEX_NONE) capture_done->Wait();
+			}
+
+			UAnalyticsCapture* capture;
+			{
+				// Packets are created on this thread and only referenced by the capture once they are read, the collector must not run in between
+				FGCScopeGuard gc_guard;
+				FCachedClassLookupScope cached_lookups;
+				capture = load(infos[index]);
+			}
+
+			int32 loaded_count;
+			{
+				FScopeLock lock(&mutex);
+				loaded[index] = capture;
+				in_flight -= sizes[index];
+				loaded_count = ++done;
+				capture_done->Trigger();
+			}
+
+			// Progress waits for the game thread, a thread that is still reporting is not waited for as the next report covers this one
+			if (progress_mutex.TryLock())
+			{
+				if (loaded_count > reported)
+				{
+					reported = loaded_count;
+					progress(loaded_count);
+				}
+				progress_mutex.Unlock();
+			}
+		}
+	});
+
+	FPlatformProcess::ReturnSynchEventToPool(capture_done);
+	progress(done);
+
+	TArray<UAnalyticsCapture*> captures;
+	for (UAnalyticsCapture* capture : loaded)
+	{
+		if (capture != nullptr) captures.Add(capture);
+	}
+	return captures;
+}
 
 bool UAnalyticsCacheTask::Execute()
 {
@@ -70,23 +179,33 @@ bool UAnalyticsCompilationTask::Execute()
 	TArray<UAnalyticsCapture*> captures;
 	TArray<UAnalyticsCompilationStage*> stages;
 
-	uint32 captures_loaded = 1;
-	uint32 capture_count = captures_to_compile.Num();
-	for (FAnalyticsCaptureInfo capture_index : captures_to_compile)
-	{
-		UAnalyticsCapture* cap = UAnalyticsLocalCaptureManager::GetLocalCaptureManager()->DeserializeCapture(capture_index);
-		if (cap != nullptr) captures.Add(cap);
-		SetNotificationText("Preparing analytics data compilation " + FString::FromInt(captures_loaded) + " / " + FString::FromInt(capture_count));
-		captures_loaded++;
-	}
-
+	bool needs_packets = false;
+	bool needs_tables = false;
 	for (UClass* stage_type : stage_types)
 	{
 		UAnalyticsCompilationStage* stage = NewObject<UAnalyticsCompilationStage>(GetTransientPackage(), stage_type);
 		stage->AddToRoot();
 		stages.Add(stage);
+
+		if (stage->bUsesPacketTables) needs_tables = true;
+		else needs_packets = true;
 	}
 
+	UAnalyticsLocalCaptureManager* manager = UAnalyticsLocalCaptureManager::GetLocalCaptureManager();
+	int32 capture_count = captures_to_compile.Num();
+
+	captures = LoadCaptures(captures_to_compile, [manager, needs_packets, needs_tables](const FAnalyticsCaptureInfo& info)
+	{
+		// Tables are filled straight from the capture unless packet objects are created anyway. Rooted until the task is done, stages run long after the capture is loaded.
+		UAnalyticsCapture* capture = needs_packets ? manager->DeserializeCaptureRange(info, 0.0, TNumericLimits<double>::Max(), true) : manager->DeserializeCaptureTables(info, 0.0, TNumericLimits<double>::Max(), true);
+		if (capture != nullptr && needs_packets && needs_tables) capture->BuildTables();
+		return capture;
+	},
+	[this, capture_count](int32 captures_loaded)
+	{
+		SetNotificationText("Preparing analytics data compilation " + FString::FromInt(captures_loaded) + " / " + FString::FromInt(capture_count));
+	});
+
 	uint32 task_count = stages.Num() * captures.Num() + stages.Num();
 	uint32 task_index = 1;
 
@@ -107,6 +226,7 @@ bool UAnalyticsCompilationTask::Execute()
 
 			context->Name = capture->Name;
 			context->Packets = capture->packets;
+			context->Captures = { capture };
 			stage->PreProcessCapture();
 			stage->ProcessCapture(context);
 			stage->PostProcessCapture();
@@ -125,6 +245,7 @@ bool UAnalyticsCompilationTask::Execute()
 				context->Packets.Add(packet);
 			}
 		}
+		context->Captures = captures;
 		stage->PreProcessCaptureGroup();
 		stage->ProcessCaptureGroup(context);
 		stage->PostProcessCaptureGroup();
@@ -148,6 +269,7 @@ bool UAnalyticsCompilationTask::Execute()
 
 	for (UAnalyticsCapture* capture : captures)
 	{
+		capture->RemoveFromRoot();
 		capture->ConditionalBeginDestroy();
 	}
 
@@ -175,24 +297,22 @@ bool UAnalyticsVisualizationTask::Execute()
 	TArray<UAnalyticsCapture*> captures;
 	TArray<UAnalyticsVisualizationStage*> stages;
 
-	uint32 captures_loaded = 1;
-	uint32 capture_count = dataset.Sessions.Num();
-
-	uint32 index = 0;
+	int32 capture_count = dataset.Sessions.Num();
 
-	for (FAnalyticsCaptureInfo capture_index : dataset.Sessions)
+	UAnalyticsLocalCaptureManager* manager = UAnalyticsLocalCaptureManager::GetLocalCaptureManager();
+	captures = LoadCaptures(dataset.Sessions, [manager](const FAnalyticsCaptureInfo& info)
+	{
+		return manager->DeserializeCaptureRange(info, 0.0, TNumericLimits<double>::Max(), true);
+	},
+	[this, &dataset, capture_count](int32 captures_loaded)
 	{
-		UAnalyticsCapture* cap = UAnalyticsLocalCaptureManager::GetLocalCaptureManager()->DeserializeCapture(capture_index);
-		if (cap != nullptr) captures.Add(cap);
 		if (notify) SetNotificationText("Preparing analytics data visualization " + FString::FromInt(captures_loaded) + " / " + FString::FromInt(capture_count));
-		captures_loaded++;
 
-		dataset.Progress = (1.0f / 3) * index / (float)capture_count;
+		dataset.Progress = (1.0f / 3) * captures_loaded / (float)capture_count;
 		NotifyUpdate(dataset);
-		index++;
-	}
+	});
 
-	index = 0;
+	uint32 index = 0;
 	for (UClass* stage_type : dataset.Stages)
 	{
 		UAnalyticsVisualizationStage* stage = NewObject<UAnalyticsVisualizationStage>(GetTransientPackage(), stage_type);
@@ -264,6 +384,7 @@ bool UAnalyticsVisualizationTask::Execute()
 
 	for (UAnalyticsCapture* capture : captures)
 	{
+		capture->RemoveFromRoot();
 		capture->ConditionalBeginDestroy();
 	}
 
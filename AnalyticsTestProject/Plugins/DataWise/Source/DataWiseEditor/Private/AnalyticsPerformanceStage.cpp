@@ -0,0 +1,142 @@
+#include "AnalyticsPerformanceStage.h"
+#include "DataWiseEditor.h"
+#include "AnalyticsChartExport.h"
+#include "AnalyticsPerformanceTracker.h"
+#include "AnalyticsPacketTable.h"
+
+#define frame_time_bucket_size 4.0f
+#define frame_time_bucket_count 25
+
+#define sample_column(type, property) table->GetColumn<type>(GET_MEMBER_NAME_CHECKED(FAnalyticsPerformanceSample, property))
+#define hitch_column(type, property) table->GetColumn<type>(GET_MEMBER_NAME_CHECKED(FAnalyticsHitchFrame, property))
+
+UAnalyticsPerformanceStage::UAnalyticsPerformanceStage()
+{
+	bUsesPacketTables = true;
+}
+
+void UAnalyticsPerformanceStage::ProcessCapture_Implementation(UAnalyticsCompilerContext* Context)
+{
+	TMap<FString, ETableDataType> frame_columns;
+	frame_columns.Add("Time", ETableDataType::Number);
+	frame_columns.Add("Frame", ETableDataType::Milliseconds);
+	frame_columns.Add("Frame Max", ETableDataType::Milliseconds);
+	frame_columns.Add("Game Thread", ETableDataType::Milliseconds);
+	frame_columns.Add("Render Thread", ETableDataType::Milliseconds);
+	frame_columns.Add("GPU", ETableDataType::Milliseconds);
+	UAnalyticsTable* frame_table = CreateTable("Frame Time", { EChartType::Line }, frame_columns);
+
+	TMap<FString, ETableDataType> memory_columns;
+	memory_columns.Add("Time", ETableDataType::Number);
+	memory_columns.Add("Physical MB", ETableDataType::Number);
+	memory_columns.Add("Virtual MB", ETableDataType::Number);
+	UAnalyticsTable* memory_table = CreateTable("Memory", { EChartType::Line }, memory_columns);
+
+	for (const FAnalyticsPacketTable* table : Context->GetTables<FAnalyticsPerformanceSample>())
+	{
+		const TArray<double>& times = table->GetTimes();
+		TArrayView<const float> frame_times = sample_column(float, FrameTime);
+		TArrayView<const float> frame_times_max = sample_column(float, FrameTimeMax);
+		TArrayView<const float> game_thread_times = sample_column(float, GameThreadTime);
+		TArrayView<const float> render_thread_times = sample_column(float, RenderThreadTime);
+		TArrayView<const float> gpu_times = sample_column(float, GPUTime);
+		TArrayView<const int32> physical_memory = sample_column(int32, UsedPhysicalMemory);
+		TArrayView<const int32> virtual_memory = sample_column(int32, UsedVirtualMemory);
+
+		for (int32 row = 0; row < table->Num(); row++)
+		{
+			FString time = FString::SanitizeFloat(times[row]);
+			frame_table->AddRow({ time, FString::SanitizeFloat(frame_times[row]), FString::SanitizeFloat(frame_times_max[row]), FString::SanitizeFloat(game_thread_times[row]), FString::SanitizeFloat(render_thread_times[row]), FString::SanitizeFloat(gpu_times[row]) });
+			memory_table->AddRow({ time, FString::FromInt(physical_memory[row]), FString::FromInt(virtual_memory[row]) });
+		}
+	}
+
+	ExportHitches(Context->GetTables<FAnalyticsHitchFrame>());
+}
+
+void UAnalyticsPerformanceStage::ProcessCaptureGroup_Implementation(UAnalyticsCompilerContext* Context)
+{
+	// Share of frames per frame time range across all captures, from the interval averages weighted by their frame count
+	TArray<int64> frames;
+	frames.SetNumZeroed(frame_time_bucket_count);
+	int64 total_frames = 0;
+
+	for (const FAnalyticsPacketTable* table : Context->GetTables<FAnalyticsPerformanceSample>())
+	{
+		TArrayView<const float> frame_times = sample_column(float, FrameTime);
+		TArrayView<const int32> frame_counts = sample_column(int32, Frames);
+
+		for (int32 row = 0; row < table->Num(); row++)
+		{
+			int32 bucket = FMath::Clamp(FMath::FloorToInt(frame_times[row] / frame_time_bucket_size), 0, frame_time_bucket_count - 1);
+			frames[bucket] += frame_counts[row];
+			total_frames += frame_counts[row];
+		}
+	}
+
+	if (total_frames > 0)
+	{
+		TMap<FString, ETableDataType> columns;
+		columns.Add("Frame Time", ETableDataType::String);
+		columns.Add("Frames %", ETableDataType::Number);
+		UAnalyticsTable* table = CreateTable("Frame Time Distribution", { EChartType::Column }, columns);
+
+		for (int32 bucket = 0; bucket < frame_time_bucket_count; bucket++)
+		{
+			FString range = FString::FromInt(FMath::RoundToInt(bucket * frame_time_bucket_size)) + ((bucket == frame_time_bucket_count - 1) ? "+ ms" : "-" + FString::FromInt(FMath::RoundToInt((bucket + 1) * frame_time_bucket_size)) + " ms");
+			table->AddRow({ range, FString::SanitizeFloat(frames[bucket] * 100.0 / total_frames) });
+		}
+	}
+
+	ExportHitches(Context->GetTables<FAnalyticsHitchFrame>());
+}
+
+void UAnalyticsPerformanceStage::ExportHitches(const TArray<const FAnalyticsPacketTable*>& tables)
+{
+	// Average of every frame offset across all hitch bursts
+	struct FOffsetTotals
+	{
+		int32 Frames = 0;
+		double FrameTime = 0.0;
+		double GameThreadTime = 0.0;
+		double RenderThreadTime = 0.0;
+		double GPUTime = 0.0;
+	};
+
+	TMap<int32, FOffsetTotals> offsets;
+	for (const FAnalyticsPacketTable* table : tables)
+	{
+		TArrayView<const int32> frame_offsets = hitch_column(int32, Offset);
+		TArrayView<const float> frame_times = hitch_column(float, FrameTime);
+		TArrayView<const float> game_thread_times = hitch_column(float, GameThreadTime);
+		TArrayView<const float> render_thread_times = hitch_column(float, RenderThreadTime);
+		TArrayView<const float> gpu_times = hitch_column(float, GPUTime);
+
+		for (int32 row = 0; row < table->Num(); row++)
+		{
+			FOffsetTotals& totals = offsets.FindOrAdd(frame_offsets[row]);
+			totals.Frames++;
+			totals.FrameTime += frame_times[row];
+			totals.GameThreadTime += game_thread_times[row];
+			totals.RenderThreadTime += render_thread_times[row];
+			totals.GPUTime += gpu_times[row];
+		}
+	}
+
+	if (offsets.Num() == 0) return;
+	offsets.KeySort(TLess<int32>());
+
+	TMap<FString, ETableDataType> columns;
+	columns.Add("Frame", ETableDataType::Number);
+	columns.Add("Frame Time", ETableDataType::Milliseconds);
+	columns.Add("Game Thread", ETableDataType::Milliseconds);
+	columns.Add("Render Thread", ETableDataType::Milliseconds);
+	columns.Add("GPU", ETableDataType::Milliseconds);
+	UAnalyticsTable* table = CreateTable("Frames Around Hitches", { EChartType::Column }, columns);
+
+	for (const TPair<int32, FOffsetTotals>& offset : offsets)
+	{
+		const FOffsetTotals& totals = offset.Value;
+		table->AddRow({ FString::FromInt(offset.Key), FString::SanitizeFloat(totals.FrameTime / totals.Frames), FString::SanitizeFloat(totals.GameThreadTime / totals.Frames), FString::SanitizeFloat(totals.RenderThreadTime / totals.Frames), FString::SanitizeFloat(totals.GPUTime / totals.Frames) });
+	}
+}
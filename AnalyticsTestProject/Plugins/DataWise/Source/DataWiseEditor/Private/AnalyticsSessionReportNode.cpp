@@ -7,7 +7,6 @@
 #include "BlueprintActionDatabaseRegistrar.h"
 #include "Kismet2/BlueprintEditorUtils.h"
 #include "BlueprintCompilationManager.h"
-#include "Kismet/GameplayStatics.h"
 #include "BlueprintActionFilter.h"
 
 #define LOCTEXT_NAMESPACE "AnalyticsEditorModule"
@@ -272,6 +271,22 @@ bool UK2_AnalyticsSessionReportNode::ShowPaletteIconOnNode() const
 	return false;
 }
 
+FName UK2_AnalyticsSessionReportNode::GetWriteFunctionName(const FEdGraphPinType& type)
+{
+	if (type.PinCategory == UEdGraphSchema_K2::PC_String) return GET_FUNCTION_NAME_CHECKED(UAnalyticsSession, WriteReportString);
+	if (type.PinCategory == UEdGraphSchema_K2::PC_Int) return GET_FUNCTION_NAME_CHECKED(UAnalyticsSession, WriteReportInt);
+	if (type.PinCategory == UEdGraphSchema_K2::PC_Boolean) return GET_FUNCTION_NAME_CHECKED(UAnalyticsSession, WriteReportBool);
+	if (type.PinCategory == UEdGraphSchema_K2::PC_Float) return GET_FUNCTION_NAME_CHECKED(UAnalyticsSession, WriteReportFloat);
+
+	if (type.PinCategory == UEdGraphSchema_K2::PC_Struct)
+	{
+		if (type.PinSubCategoryObject == TBaseStructure<FVector>::Get()) return GET_FUNCTION_NAME_CHECKED(UAnalyticsSession, WriteReportVector);
+		if (type.PinSubCategoryObject == TBaseStructure<FVector2D>::Get()) return GET_FUNCTION_NAME_CHECKED(UAnalyticsSession, WriteReportVector2D);
+	}
+
+	return NAME_None;
+}
+
 
 void UK2_AnalyticsSessionReportNode::ExpandNode(class FKismetCompilerContext& CompilerContext, UEdGraph* SourceGraph) 
 {
@@ -284,70 +299,66 @@ void UK2_AnalyticsSessionReportNode::ExpandNode(class FKismetCompilerContext& Co
 
 	CheckPins(&CompilerContext, FindPacketClass(Pins));
 
-	// Create construction node
+	// Create begin node
 
-	UK2Node_CallFunction* ConstructNode = CompilerContext.SpawnIntermediateNode<UK2Node_CallFunction>(this, SourceGraph);
-	ConstructNode->FunctionReference.SetExternalMember(GET_FUNCTION_NAME_CHECKED(UGameplayStatics, SpawnObject), UGameplayStatics::StaticClass());
-	ConstructNode->AllocateDefaultPins();
+	UK2Node_CallFunction* BeginNode = CompilerContext.SpawnIntermediateNode<UK2Node_CallFunction>(this, SourceGraph);
+	BeginNode->FunctionReference.SetExternalMember(GET_FUNCTION_NAME_CHECKED(UAnalyticsSession, BeginReport), UAnalyticsSession::StaticClass());
+	BeginNode->AllocateDefaultPins();
 
-	UEdGraphPin* pin_exec_construct = ConstructNode->GetExecPin();
-	UEdGraphPin* pin_then_construct = ConstructNode->GetThenPin();
-	UEdGraphPin* pin_class_construct = ConstructNode->FindPin(TEXT("ObjectClass"));
-	UEdGraphPin* pin_target_construct = ConstructNode->FindPin(TEXT("Outer"));
-	UEdGraphPin* pin_result_construct = ConstructNode->GetReturnValuePin();
+	UEdGraphPin* pin_exec_begin = BeginNode->GetExecPin();
+	UEdGraphPin* pin_target_begin = BeginNode->FindPin(UEdGraphSchema_K2::PN_Self);
+	UEdGraphPin* pin_class_begin = BeginNode->FindPin(TEXT("Class"));
 
-	CompilerContext.MovePinLinksToIntermediate(*pin_exec, *pin_exec_construct);
-	CompilerContext.MovePinLinksToIntermediate(*pin_class, *pin_class_construct);
-	CompilerContext.CopyPinLinksToIntermediate(*pin_target, *pin_target_construct);
+	CompilerContext.MovePinLinksToIntermediate(*pin_exec, *pin_exec_begin);
+	CompilerContext.MovePinLinksToIntermediate(*pin_class, *pin_class_begin);
+	CompilerContext.CopyPinLinksToIntermediate(*pin_target, *pin_target_begin);
 
-	// Create assignment nodes
+	// Create write nodes
 
-	UEdGraphPin* pin_then_assignment = pin_then_construct;
+	UEdGraphPin* pin_then_write = BeginNode->GetThenPin();
 	TArray<UEdGraphPin*> class_pins = FindClassPins();
 	for (UEdGraphPin* class_pin : class_pins)
 	{
-		UK2Node_CallFunction* assignment_node = CompilerContext.SpawnIntermediateNode<UK2Node_CallFunction>(this, SourceGraph);
-		assignment_node->SetFromFunction(UEdGraphSchema_K2::FindSetVariableByNameFunction(class_pin->PinType));
-		assignment_node->AllocateDefaultPins();
+		FName write_function = GetWriteFunctionName(class_pin->PinType);
+		if (write_function.IsNone()) continue;
 
-		pin_then_assignment->MakeLinkTo(assignment_node->GetExecPin());
-		pin_then_assignment = assignment_node->GetThenPin();
+		UK2Node_CallFunction* write_node = CompilerContext.SpawnIntermediateNode<UK2Node_CallFunction>(this, SourceGraph);
+		write_node->FunctionReference.SetExternalMember(write_function, UAnalyticsSession::StaticClass());
+		write_node->AllocateDefaultPins();
 
-		UEdGraphPin* PropertyNamePin = assignment_node->FindPinChecked(TEXT("PropertyName"));
-		PropertyNamePin->DefaultValue = class_pin->PinName.ToString();
+		pin_then_write->MakeLinkTo(write_node->GetExecPin());
+		pin_then_write = write_node->GetThenPin();
 
-		UEdGraphPin* ObjectPin = assignment_node->FindPin(TEXT("Object"));
-		pin_result_construct->MakeLinkTo(ObjectPin);
+		UEdGraphPin* pin_property_write = write_node->FindPinChecked(TEXT("Property"));
+		pin_property_write->DefaultValue = class_pin->PinName.ToString();
 
-		UEdGraphPin* pin_value_assignment = assignment_node->FindPinChecked(TEXT("Value"));
-		if(class_pin->LinkedTo.Num()==0)
+		UEdGraphPin* pin_target_write = write_node->FindPinChecked(UEdGraphSchema_K2::PN_Self);
+		CompilerContext.CopyPinLinksToIntermediate(*pin_target, *pin_target_write);
+
+		UEdGraphPin* pin_value_write = write_node->FindPinChecked(TEXT("Value"));
+		if (class_pin->LinkedTo.Num() == 0)
 		{
-			pin_value_assignment->DefaultValue = class_pin->DefaultValue;
-		} 
+			pin_value_write->DefaultValue = class_pin->DefaultValue;
+		}
 		else
 		{
-			pin_value_assignment->PinType.PinCategory = class_pin->PinType.PinCategory;
-			pin_value_assignment->PinType.PinSubCategory = class_pin->PinType.PinSubCategory;
-			pin_value_assignment->PinType.PinSubCategoryObject = class_pin->PinType.PinSubCategoryObject;
-			CompilerContext.MovePinLinksToIntermediate(*class_pin, *pin_value_assignment);
+			CompilerContext.MovePinLinksToIntermediate(*class_pin, *pin_value_write);
 		}
 	}
 
-	// Create report node
+	// Create end node
 
-	UK2Node_CallFunction* ReportNode = CompilerContext.SpawnIntermediateNode<UK2Node_CallFunction>(this, SourceGraph);
-	ReportNode->FunctionReference.SetExternalMember(GET_FUNCTION_NAME_CHECKED(UAnalyticsSession, ReportEvent), UAnalyticsSession::StaticClass());
-	ReportNode->AllocateDefaultPins();
+	UK2Node_CallFunction* EndNode = CompilerContext.SpawnIntermediateNode<UK2Node_CallFunction>(this, SourceGraph);
+	EndNode->FunctionReference.SetExternalMember(GET_FUNCTION_NAME_CHECKED(UAnalyticsSession, EndReport), UAnalyticsSession::StaticClass());
+	EndNode->AllocateDefaultPins();
 
-	UEdGraphPin* pin_exec_report = ReportNode->GetExecPin();
-	UEdGraphPin* pin_then_report = ReportNode->GetThenPin();
-	UEdGraphPin* pin_target_report = ReportNode->FindPin(UEdGraphSchema_K2::PN_Self);
-	UEdGraphPin* pin_packet_report = ReportNode->FindPin(TEXT("packet"));
+	UEdGraphPin* pin_exec_end = EndNode->GetExecPin();
+	UEdGraphPin* pin_then_end = EndNode->GetThenPin();
+	UEdGraphPin* pin_target_end = EndNode->FindPin(UEdGraphSchema_K2::PN_Self);
 
-	pin_then_assignment->MakeLinkTo(pin_exec_report);
-	pin_result_construct->MakeLinkTo(pin_packet_report);
-	CompilerContext.MovePinLinksToIntermediate(*pin_target, *pin_target_report);
-	CompilerContext.MovePinLinksToIntermediate(*pin_then, *pin_then_report);
+	pin_then_write->MakeLinkTo(pin_exec_end);
+	CompilerContext.MovePinLinksToIntermediate(*pin_target, *pin_target_end);
+	CompilerContext.MovePinLinksToIntermediate(*pin_then, *pin_then_end);
 
 	BreakAllNodeLinks();
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "AnalyticsPacket.h"
+#include "AnalyticsCapture.h"
 #include "Templates/Casts.h"
 #include "AnalyticscompilationStage.generated.h"
 
@@ -8,6 +9,8 @@
 class UAnalyticsMap;
 class UAnalyticsTable;
 class UAnalyticsSheet;
+class FAnalyticsPacketTable;
+enum class EAnalyticsPropertyCodec : uint8;
 
 UENUM(BlueprintType) enum class EChartType : uint8 {
 	Table,
@@ -63,6 +66,40 @@ public:
 
 	UFUNCTION(BlueprintCallable)
 	TArray<UAnalyticsPacket*> GetPacketsOfType(TSubclassOf<UAnalyticsPacket> type);
+
+	// The capture being processed, or every capture for a capture group
+	UPROPERTY(BlueprintReadOnly)
+	TArray<UAnalyticsCapture*> Captures;
+
+	// Table of the type of every capture that has packets of it, see UAnalyticsCompilationStage::bUsesPacketTables
+	TArray<const FAnalyticsPacketTable*> GetTables(UStruct* type) const;
+
+	template<typename T>
+	TArray<const FAnalyticsPacketTable*> GetTables() const { return GetTables(T::StaticStruct()); }
+
+	// Columns of a packet class for Blueprint stages, with the rows of all captures after each other
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetTableRowCount(TSubclassOf<UAnalyticsPacket> Type) const;
+
+	UFUNCTION(BlueprintCallable)
+	TArray<float> GetTableTimes(TSubclassOf<UAnalyticsPacket> Type) const;
+
+	UFUNCTION(BlueprintCallable)
+	TArray<int32> GetTableIntColumn(TSubclassOf<UAnalyticsPacket> Type, FName Property) const;
+
+	UFUNCTION(BlueprintCallable)
+	TArray<float> GetTableFloatColumn(TSubclassOf<UAnalyticsPacket> Type, FName Property) const;
+
+	UFUNCTION(BlueprintCallable)
+	TArray<FVector> GetTableVectorColumn(TSubclassOf<UAnalyticsPacket> Type, FName Property) const;
+
+	UFUNCTION(BlueprintCallable)
+	TArray<FString> GetTableStringColumn(TSubclassOf<UAnalyticsPacket> Type, FName Property) const;
+
+private:
+	template<typename T>
+	TArray<T> GetTableColumn(UStruct* type, FName property, EAnalyticsPropertyCodec codec) const;
 };
 
 UCLASS(Blueprintable) 
@@ -70,24 +107,36 @@ class UAnalyticsCompilationStage : public UObject {
 GENERATED_BODY()
 public:
 
-	UFUNCTION(BlueprintImplementableEvent)
+	// Stages that read Context->GetTables instead of Context->Packets. Packet objects are only created when a selected stage does not.
+	UPROPERTY(EditDefaultsOnly, Category = "Analytics")
+	bool bUsesPacketTables = false;
+
+	// Native events so stages can be implemented in C++ as well as in Blueprint
+
+	UFUNCTION(BlueprintNativeEvent)
 	void PreProcessCapture();
+	virtual void PreProcessCapture_Implementation() {}
 
-	UFUNCTION(BlueprintImplementableEvent)
+	UFUNCTION(BlueprintNativeEvent)
 	void ProcessCapture(UAnalyticsCompilerContext* Context);
+	virtual void ProcessCapture_Implementation(UAnalyticsCompilerContext* Context) {}
 
-	UFUNCTION(BlueprintImplementableEvent)
+	UFUNCTION(BlueprintNativeEvent)
 	void PostProcessCapture();
+	virtual void PostProcessCapture_Implementation() {}
 
 
-	UFUNCTION(BlueprintImplementableEvent)
+	UFUNCTION(BlueprintNativeEvent)
 	void PreProcessCaptureGroup();
+	virtual void PreProcessCaptureGroup_Implementation() {}
 
-	UFUNCTION(BlueprintImplementableEvent)
+	UFUNCTION(BlueprintNativeEvent)
 	void ProcessCaptureGroup(UAnalyticsCompilerContext* Context);
+	virtual void ProcessCaptureGroup_Implementation(UAnalyticsCompilerContext* Context) {}
 
-	UFUNCTION(BlueprintImplementableEvent)
+	UFUNCTION(BlueprintNativeEvent)
 	void PostProcessCaptureGroup();
+	virtual void PostProcessCaptureGroup_Implementation() {}
 
 	void ExportData(FString Name);
 
@@ -0,0 +1,20 @@
+#pragma once
+#include "AnalyticsCompilationStage.h"
+#include "AnalyticsPerformanceStage.generated.h"
+
+class FAnalyticsPacketTable;
+
+// Built-in stage for captures recorded with UAnalyticsPerformanceTracker: frame and thread times, memory and the frames around hitches
+UCLASS()
+class UAnalyticsPerformanceStage : public UAnalyticsCompilationStage
+{
+	GENERATED_BODY()
+public:
+	UAnalyticsPerformanceStage();
+
+	void ProcessCapture_Implementation(UAnalyticsCompilerContext* Context) override;
+	void ProcessCaptureGroup_Implementation(UAnalyticsCompilerContext* Context) override;
+
+private:
+	void ExportHitches(const TArray<const FAnalyticsPacketTable*>& tables);
+};
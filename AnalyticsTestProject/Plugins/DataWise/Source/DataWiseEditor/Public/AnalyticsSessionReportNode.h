@@ -32,4 +32,6 @@ private:
 	void CreateClassPins(UClass* selected_class);
 	int CheckPins(FKismetCompilerContext* context, UClass* selected_class);
 	UClass* FindPacketClass(TArray<UEdGraphPin*>& pins);
+
+	static FName GetWriteFunctionName(const FEdGraphPinType& type);
 };
\ No newline at end of file
@@ -32,46 +32,7 @@ FAnalyticsCaptureInfo UAnalyticsFTPCaptureManager::SerializeCapture(UAnalyticsCa
 	uint8* data = buffer.GetData();
 	DWORD data_size = buffer.Num() * sizeof(uint8);
 
-	// Create directory tree if needed
-	if (!FtpSetCurrentDirectoryA(ftp_handle, TCHAR_TO_UTF8(*GetPath())))
-	{
-		TArray<FString> tree;
-		FString path = GetPath();
-		tree.Add(path);
-
-		int32 position;
-		while(path.FindLastChar(TCHAR('/'), position))
-		{
-			if (position > 0) {
-				path = path.Mid(0, position);
-				tree.Add(path);
-			}
-			else break;
-		}
-
-		Algo::Reverse(tree);
-
-		for(FString dir : tree)
-		{
-			if (!FtpSetCurrentDirectoryA(ftp_handle, TCHAR_TO_UTF8(*dir)))
-			{
-				UE_LOG(AnalyticsFTPLog, Warning, TEXT("Creating directory: %s"), *dir);
-				FtpCreateDirectoryA(ftp_handle, TCHAR_TO_UTF8(*dir));
-
-				if (!FtpSetCurrentDirectoryA(ftp_handle, TCHAR_TO_UTF8(*dir)))
-				{
-					UE_LOG(AnalyticsFTPLog, Error, TEXT("Could not create directory on FTP server: %s"), *dir);
-					return FAnalyticsCaptureInfo();
-				}
-			}
-		}
-
-		if (!FtpSetCurrentDirectoryA(ftp_handle, TCHAR_TO_UTF8(*GetPath())))
-		{
-			UE_LOG(AnalyticsFTPLog, Error, TEXT("Could not find directory on FTP server: %s"), *GetPath());
-			return FAnalyticsCaptureInfo();
-		}
-	}
+	if (!EnterDirectory(true)) return FAnalyticsCaptureInfo();
 
 	FString filename = capture->Name + ".cap";
 	HINTERNET file = FtpOpenFileA(ftp_handle, TCHAR_TO_UTF8(*filename), GENERIC_WRITE, FTP_TRANSFER_TYPE_BINARY, NULL);
@@ -233,6 +194,74 @@ void UAnalyticsFTPCaptureManager::DeleteStoredCapture(FAnalyticsCaptureInfo info
 	FtpDeleteFileA(ftp_handle, TCHAR_TO_UTF8(*filename));
 }
 
+int64 UAnalyticsFTPCaptureManager::GetStoredFileSize(const FString& file)
+{
+	if (!EnterDirectory(false)) return 0;
+
+	WIN32_FIND_DATAA find;
+	HINTERNET find_handle = FtpFindFirstFileA(ftp_handle, TCHAR_TO_UTF8(*file), &find, INTERNET_FLAG_RELOAD, NULL);
+	if (find_handle == NULL)
+	{
+		if (GetLastError() == ERROR_NO_MORE_FILES) return 0;
+
+		UE_LOG(AnalyticsFTPLog, Error, TEXT("Could not query %s"), *file);
+		return -1;
+	}
+
+	int64 size = ((int64)find.nFileSizeHigh << 32) | find.nFileSizeLow;
+	InternetCloseHandle(find_handle);
+
+	return size;
+}
+
+bool UAnalyticsFTPCaptureManager::WriteStoredFile(const FString& file, int64 offset, const uint8* data, int32 size)
+{
+	if (!EnterDirectory(true)) return false;
+
+	// Later blocks are appended, the server keeps what was sent before a connection was lost
+	HINTERNET handle = NULL;
+	if (offset == 0)
+	{
+		handle = FtpOpenFileA(ftp_handle, TCHAR_TO_UTF8(*file), GENERIC_WRITE, FTP_TRANSFER_TYPE_BINARY, NULL);
+	}
+	else
+	{
+		FString command = "APPE " + file;
+		FtpCommandA(ftp_handle, TRUE, FTP_TRANSFER_TYPE_BINARY, TCHAR_TO_UTF8(*command), NULL, &handle);
+	}
+
+	if (handle == NULL)
+	{
+		UE_LOG(AnalyticsFTPLog, Error, TEXT("Could not upload %s"), *file);
+		return false;
+	}
+
+	DWORD written = 0;
+	while (size > 0)
+	{
+		if (!InternetWriteFile(handle, data, size, &written) || written == 0) { InternetCloseHandle(handle); return false; }
+		data += written;
+		size -= written;
+	}
+
+	InternetCloseHandle(handle);
+	return true;
+}
+
+bool UAnalyticsFTPCaptureManager::RenameStoredFile(const FString& file, const FString& new_file)
+{
+	if (!EnterDirectory(false)) return false;
+
+	FtpDeleteFileA(ftp_handle, TCHAR_TO_UTF8(*new_file));
+	if (!FtpRenameFileA(ftp_handle, TCHAR_TO_UTF8(*file), TCHAR_TO_UTF8(*new_file)))
+	{
+		UE_LOG(AnalyticsFTPLog, Error, TEXT("Could not rename %s to %s"), *file, *new_file);
+		return false;
+	}
+
+	return true;
+}
+
 UAnalyticsFTPCaptureManager* UAnalyticsFTPCaptureManager::ConnectToFTP(FString Adress, FString Username, FString Password, FString Directory, FTPConnectionResult& ConnectionResult)
 {
 	UAnalyticsFTPCaptureManager* manager = NewObject<UAnalyticsFTPCaptureManager>();
@@ -320,6 +349,52 @@ void UAnalyticsFTPCaptureManager::Disconnect()
 	ConditionalBeginDestroy();
 }
 
+bool UAnalyticsFTPCaptureManager::EnterDirectory(bool create)
+{
+	if (FtpSetCurrentDirectoryA(ftp_handle, TCHAR_TO_UTF8(*GetPath()))) return true;
+	if (!create) return false;
+
+	// Create directory tree if needed
+	TArray<FString> tree;
+	FString path = GetPath();
+	tree.Add(path);
+
+	int32 position;
+	while(path.FindLastChar(TCHAR('/'), position))
+	{
+		if (position > 0) {
+			path = path.Mid(0, position);
+			tree.Add(path);
+		}
+		else break;
+	}
+
+	Algo::Reverse(tree);
+
+	for(FString dir : tree)
+	{
+		if (!FtpSetCurrentDirectoryA(ftp_handle, TCHAR_TO_UTF8(*dir)))
+		{
+			UE_LOG(AnalyticsFTPLog, Warning, TEXT("Creating directory: %s"), *dir);
+			FtpCreateDirectoryA(ftp_handle, TCHAR_TO_UTF8(*dir));
+
+			if (!FtpSetCurrentDirectoryA(ftp_handle, TCHAR_TO_UTF8(*dir)))
+			{
+				UE_LOG(AnalyticsFTPLog, Error, TEXT("Could not create directory on FTP server: %s"), *dir);
+				return false;
+			}
+		}
+	}
+
+	if (!FtpSetCurrentDirectoryA(ftp_handle, TCHAR_TO_UTF8(*GetPath())))
+	{
+		UE_LOG(AnalyticsFTPLog, Error, TEXT("Could not find directory on FTP server: %s"), *GetPath());
+		return false;
+	}
+
+	return true;
+}
+
 FString UAnalyticsFTPCaptureManager::GetPath()
 {
 	if (directory.IsEmpty()) return "/";
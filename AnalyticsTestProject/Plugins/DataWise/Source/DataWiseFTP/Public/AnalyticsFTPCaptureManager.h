@@ -34,6 +34,10 @@ public:
 
 	void DeleteStoredCapture(FAnalyticsCaptureInfo info) override;
 
+	int64 GetStoredFileSize(const FString& file) override;
+	bool WriteStoredFile(const FString& file, int64 offset, const uint8* data, int32 size) override;
+	bool RenameStoredFile(const FString& file, const FString& new_file) override;
+
 	static UAnalyticsFTPCaptureManager* ConnectToFTP(FString Adress, FString Username, FString Password, FString Directory, FTPConnectionResult& ConnectionResult);
 
 	UFUNCTION(BlueprintCallable, DisplayName = "Connect To FTP", Meta = (ExpandEnumAsExecs = "ConnectionResult", Latent, LatentInfo = "LatentInfo", HidePin = "WorldContextObject", WorldContext = "WorldContextObject"))
@@ -45,6 +49,9 @@ public:
 private:
 	FString GetPath();
 
+	// Makes the capture directory the current directory, creating it if needed
+	bool EnterDirectory(bool create);
+
 	HINTERNET connection;
 	HINTERNET ftp_handle;
 	FString directory;